@@ -0,0 +1,98 @@
+#ifndef ADS1115_EMULATOR_H
+#define ADS1115_EMULATOR_H
+
+#include "i2c_bus.h"
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * Emulated ADC settings, loaded from config/ads1115_emulator.json
+ */
+struct Ads1115EmulatorConfig {
+    int address = 0x48;
+
+    // pH at A0 over time, linear between points, seconds from start
+    struct Point {
+        double seconds;
+        double pH;
+    };
+    std::vector<Point> script = { { 0.0, 7.2 }, { 600.0, 6.8 }, { 1200.0, 7.2 } };
+    bool loop = true;         // Restart the script after its last point
+    double timeScale = 1.0;   // Script seconds per real second
+
+    // Probe response, pH = slope * volts + offset, the sensor's calibration by default
+    double probeSlope = -12.5;
+    double probeOffset = 12.5;
+
+    double channelVolts[3] = { 0.0, 0.0, 0.0 }; // Constant A1 to A3
+    double noiseUv = 15.0;   // RMS input noise at 8 SPS, grows with sqrt(rate)
+    double spikeRate = 0.0;  // Fraction of conversions hit by a spike
+    double spikeVolts = 0.1; // Spike size, either sign
+    unsigned seed = 1;
+
+    bool load(const std::string& path);
+};
+
+/**
+ * ADS1115 in userspace, attached to an I2cBus in place of the chip
+ *
+ * Models the pointer, config, threshold and conversion registers as the
+ * datasheet lays them out. A single-shot conversion takes one period at the
+ * configured data rate, the OS bit reads 0 until it is done and the
+ * conversion register keeps the previous result until then. In continuous
+ * mode results land on the data rate's period grid. Each result is the
+ * scripted input at that instant plus Gaussian noise and optional spikes,
+ * through the selected multiplexer input and gain, so the whole pH pipeline
+ * runs and can be benchmarked without hardware. ALERT/RDY is not driven,
+ * there is no GPIO line behind it.
+ */
+class Ads1115Emulator : public I2cDevice {
+public:
+    struct Stats {
+        uint64_t writes;
+        uint64_t reads;
+        uint64_t conversions;
+        uint64_t earlyReads; // Conversion register read while a single-shot was still running
+    };
+
+    explicit Ads1115Emulator(const Ads1115EmulatorConfig& config = Ads1115EmulatorConfig());
+
+    bool transfer(const uint8_t* out, size_t outLength, uint8_t* in, size_t inLength) override;
+
+    uint8_t address() const { return static_cast<uint8_t>(m_config.address); }
+
+    // Scripted pH, without noise, at seconds of real time since construction
+    double truePH(double seconds) const;
+    double elapsed() const;
+
+    Stats stats() const;
+
+private:
+    // Finish conversions due by nowNs, called with m_mutex held
+    void update(int64_t nowNs);
+    int16_t convert(int64_t atNs);
+    double inputVolts(uint16_t mux, double seconds) const;
+    int64_t periodNs() const;
+
+    Ads1115EmulatorConfig m_config;
+    int64_t m_startNs;
+
+    mutable std::mutex m_mutex;
+    std::mt19937 m_random;
+    uint8_t m_pointer;
+    uint16_t m_configRegister;
+    uint16_t m_loThresh;
+    uint16_t m_hiThresh;
+    int16_t m_conversion;
+    bool m_busy;           // Single-shot conversion running
+    int64_t m_readyNs;     // When it finishes
+    int64_t m_continuousNs; // Continuous mode start, results at every period after
+    int64_t m_converted;   // Continuous results taken so far
+    Stats m_stats;
+};
+
+#endif
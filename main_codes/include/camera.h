@@ -1,52 +1,101 @@
 #ifndef CAMERA_H
 #define CAMERA_H
 
+#include "event_bus.h"
 #include <atomic>
 #include <condition_variable>
+#include <cstdint>
 #include <mutex>
 #include <opencv2/opencv.hpp>
 #include <string>
-#include <thread>
-#include <vector>
-
 
+/**
+ * libcamera-still wrapper, one capture at a time
+ *
+ * Requests are queued and admitted by CaptureAdmission. Capturing to a file
+ * and decoding it are separate calls so the frame pipeline can run them as
+ * separate stages; decoded images are published on a topic.
+ *
+ * A low-resolution preview stream feeds video motion detection. libcamera
+ * serves one user at a time, so a still capture closes the stream and the
+ * next preview read reopens it.
+ */
 class Camera {
 public:
-    // Interface for image callbacks
-    struct ImageCallbackInterface {
-        virtual void imageReady(const cv::Mat& image) = 0;
+    struct ImageEvent {
+        cv::Mat image;
+    };
+    
+    struct Stats {
+        uint64_t captures; // libcamera-still runs
+        uint64_t failures; // Failed runs and unreadable files
     };
     
-    Camera(const std::string& outputPath = "fish_detection.jpg",
+    Camera(EventBus& bus,
+           const std::string& topic = "image",
+           const std::string& outputPath = "fish_detection.jpg",
            int width = 640, 
            int height = 480);
     ~Camera();
     
-    // Start cam thread
+    // Accept captures
     void start();
     
-    // Stop cam thread
+    // Refuse captures, waits for a running capture to finish
     void stop();
     
-    // Request an img capture
-    void captureImage();
+    bool isRunning() const { return m_running; }
+    
+    /**
+     * Run libcamera-still for one frame, blocks for the capture
+     * @return Path of the JPEG, empty on failure or when stopped
+     */
+    std::string captureFile(uint64_t frame);
+    
+    /**
+     * Load a captured JPEG, publish it and remove the file
+     * @return Empty image on failure
+     */
+    cv::Mat decode(const std::string& path);
     
-    // Register callback for img capture
-    void registerCallback(ImageCallbackInterface* callback);
+    /**
+     * Set the preview stream, takes effect when it is next opened
+     */
+    void setPreview(int width, int height, int fps);
+    
+    /**
+     * Next grey preview frame, blocks while a still capture holds the camera
+     * @param opened Set when the stream was (re)opened for this frame, the
+     *               sensor starts over and its first frames are still settling
+     * @return false when stopped or the stream can't be opened
+     */
+    bool readPreview(cv::Mat& frame, bool& opened);
+    
+    // Release the preview stream
+    void closePreview();
+    
+    Stats stats() const;
     
 private:
-    // Worker thread for camera
-    void worker();
+    std::string framePath(uint64_t frame) const;
     
     std::string m_outputPath;
     int m_width;
     int m_height;
     std::atomic<bool> m_running;
-    std::atomic<bool> m_captureRequested{false};
-    std::thread m_thread;
+    bool m_busy;
     std::mutex m_mutex;
     std::condition_variable m_captureCondition;
-    std::vector<ImageCallbackInterface*> m_callbacks;
+    std::atomic<uint64_t> m_captures;
+    std::atomic<uint64_t> m_failures;
+    Topic<ImageEvent>& m_imageTopic;
+    
+    // Held by whoever uses the camera, the preview stream or a still capture
+    std::mutex m_deviceMutex;
+    cv::VideoCapture m_preview;
+    int m_previewWidth;
+    int m_previewHeight;
+    int m_previewFps;
 };
 
 #endif 
@@ -0,0 +1,125 @@
+#ifndef CAPTURE_ADMISSION_H
+#define CAPTURE_ADMISSION_H
+
+#include "camera.h"
+#include "frame_pipeline.h"
+#include "worker_pool.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Capture admission settings, loaded from config/capture.json
+ */
+struct CaptureAdmissionConfig {
+    std::string policy = "latest_wins";
+    int queueDepth = 1;       // Captures waiting behind the running one
+    int minIntervalMs = 2000; // min_interval: between capture starts
+
+    bool load(const std::string& path);
+};
+
+/**
+ * Admission control in front of the camera
+ *
+ * Capture requests either start a capture of their own (captured), share a
+ * queued one (coalesced) or are refused at once (shed), depending on the
+ * policy. The queue is bounded, so under a storm of triggers a request waits
+ * for at most the running capture plus queueDepth more.
+ *
+ * - latest_wins:  a full queue adds requests to its newest capture
+ * - drop_if_busy: requests while a capture runs or waits are shed
+ * - min_interval: one capture per interval, requests while one waits share
+ *                 it, others within the interval are shed
+ */
+class CaptureAdmission {
+public:
+    enum class Policy {
+        LatestWins,
+        DropIfBusy,
+        MinInterval
+    };
+    static const size_t POLICIES = 3;
+
+    // Called once the frame is decoded, or at once if shed
+    using Callback = FramePipeline::CaptureCallback;
+
+    struct PolicyStats {
+        Policy policy;
+        uint64_t captured;
+        uint64_t coalesced;
+        uint64_t shed;
+    };
+
+    struct Stats {
+        Policy policy;
+        size_t queued;
+        uint64_t requests;
+        double avgWaitMs; // Oldest request of a capture until it starts
+        double maxWaitMs;
+        std::vector<PolicyStats> policies;
+    };
+
+    CaptureAdmission(Camera& camera, FramePipeline& pipeline, WorkerPool& pool,
+                     const CaptureAdmissionConfig& config = CaptureAdmissionConfig());
+    ~CaptureAdmission();
+    CaptureAdmission(const CaptureAdmission&) = delete;
+    CaptureAdmission& operator=(const CaptureAdmission&) = delete;
+
+    // Request a capture without waiting for its image
+    void captureImage();
+
+    // Request a capture, fails at once if the camera is stopped
+    void request(Callback done);
+
+    /**
+     * @param minIntervalMs New interval, negative keeps the current one
+     */
+    void setPolicy(Policy policy, int minIntervalMs = -1);
+
+    Camera& camera() { return m_camera; }
+    Stats stats() const;
+
+    static const char* policyName(Policy policy);
+    static bool parsePolicy(const std::string& name, Policy& policy);
+
+private:
+    // Requests served by one capture
+    struct Pending {
+        std::vector<Callback> waiters;
+        int64_t requestedNs;
+    };
+
+    struct PolicyCounters {
+        uint64_t captured = 0;
+        uint64_t coalesced = 0;
+        uint64_t shed = 0;
+    };
+
+    // Capture stage on the worker pool, runs until the queue is empty
+    void worker();
+
+    Camera& m_camera;
+    FramePipeline& m_pipeline;
+    WorkerPool& m_pool;
+    size_t m_queueDepth;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_idle;
+    Policy m_policy;
+    int64_t m_minIntervalNs;
+    std::deque<Pending> m_queue;
+    bool m_busy;
+    int64_t m_lastStartNs;
+    uint64_t m_requests;
+    uint64_t m_started;
+    int64_t m_totalWaitNs;
+    int64_t m_maxWaitNs;
+    PolicyCounters m_counters[POLICIES];
+};
+
+#endif
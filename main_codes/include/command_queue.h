@@ -0,0 +1,137 @@
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+#include "worker_pool.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * API commands run in the background
+ *
+ * A command is accepted with an id and run later, so the request that sent
+ * it is answered at once. Within a lane commands run one at a time in the
+ * order they came, the lanes run side by side: a feed that turns the motors
+ * for seconds doesn't hold up a mode change or a pH read. The motor lane has
+ * a thread of its own, so a feed never takes a pool worker away from the
+ * requests; quick control commands run on the worker pool.
+ * Each lane holds a bounded number of waiting commands, more are refused.
+ * Finished commands are kept for a while so their outcome can be looked up.
+ */
+class CommandQueue {
+public:
+    enum class Lane {
+        Motor,  // Turns the feeder motors, on its own thread
+        Control // Everything else, quick, on the pool
+    };
+    static const size_t LANES = 2;
+
+    enum class State {
+        Queued,
+        Running,
+        Done,
+        Failed
+    };
+
+    // Runs on its lane, false with a reason on failure. A job that reads
+    // something hands it back in result.
+    using Job = std::function<bool(std::string& error, std::string& result)>;
+
+    struct Command {
+        uint64_t id;
+        std::string name;
+        Lane lane;
+        State state;
+        std::string error;
+        std::string result; // Set by the job, empty if it has nothing to report
+        std::time_t submitted;
+        double waitMs; // Queued until started
+        double runMs;
+    };
+
+    // Every state change in order, called without the queue's lock
+    using Listener = std::function<void(const Command&)>;
+
+    struct Stats {
+        size_t queued;
+        size_t running;
+        uint64_t submitted;
+        uint64_t rejected; // Lane full
+        uint64_t done;
+        uint64_t failed;
+        double avgWaitMs;
+        double avgRunMs;
+    };
+
+    explicit CommandQueue(WorkerPool& pool, Listener listener = nullptr);
+    ~CommandQueue();
+    CommandQueue(const CommandQueue&) = delete;
+    CommandQueue& operator=(const CommandQueue&) = delete;
+
+    // Id of the new command, 0 if its lane is full
+    uint64_t submit(const std::string& name, Lane lane, Job job);
+
+    // Fail what is still queued, wait for the running commands, later ones fail at once
+    void stop();
+
+    // False once the command has been forgotten
+    bool find(uint64_t id, Command& command) const;
+    // Newest first
+    std::vector<Command> recent() const;
+    Stats stats() const;
+
+    static const char* laneName(Lane lane);
+    static const char* stateName(State state);
+
+private:
+    struct Entry {
+        Command command;
+        Job job;
+        int64_t queuedNs;
+        int64_t startedNs;
+    };
+
+    // Runs a lane's commands until it is empty
+    void worker(Lane lane);
+    // The motor lane's thread, drains the lane each time commands arrive
+    void motorThread();
+    // Called with m_mutex held
+    void finish(Entry& entry, bool ok, const std::string& error, const std::string& result = std::string());
+    void changed(const Command& command);
+    // Deliver the changes made so far, one thread at a time so they arrive in order
+    void notify(std::unique_lock<std::mutex>& lock);
+
+    WorkerPool& m_pool;
+    Listener m_listener;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_idle;
+    std::condition_variable m_motorWork;
+    std::map<uint64_t, Entry> m_commands; // Queued, running and the latest finished
+    std::deque<uint64_t> m_queues[LANES];
+    std::deque<uint64_t> m_finished;      // Oldest first, trimmed to a fixed count
+    std::deque<Command> m_changes;        // Not yet delivered to the listener
+    bool m_busy[LANES];
+    bool m_notifying;
+    bool m_stopped;
+    uint64_t m_nextId;
+    size_t m_running;
+    uint64_t m_submitted;
+    uint64_t m_rejected;
+    uint64_t m_done;
+    uint64_t m_failed;
+    uint64_t m_started;
+    int64_t m_totalWaitNs;
+    int64_t m_totalRunNs;
+    std::thread m_motor; // Last, started once the rest is set up
+};
+
+#endif
@@ -0,0 +1,500 @@
+#ifndef EVENT_BUS_H
+#define EVENT_BUS_H
+
+#include "worker_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * How a subscriber receives events
+ */
+enum class Delivery {
+    Inline,    // On the publisher's thread, for handlers that only store or forward
+    Dedicated, // On the subscriber's own thread, for slow consumers like archiving
+    Pool       // As jobs on the worker pool in the subscription's lane
+};
+
+const char* deliveryName(Delivery delivery);
+
+/**
+ * Lock-free multi-producer single-consumer queue (Vyukov, intrusive stub node)
+ *
+ * push() is wait-free apart from the allocation. pop() may briefly miss an
+ * element whose producer is between linking steps, size() already counts it
+ * so consumers retry instead of sleeping.
+ */
+template <typename T>
+class MpscQueue {
+public:
+    MpscQueue() : m_head(new Node), m_tail(m_head.load()), m_size(0) {}
+
+    ~MpscQueue() {
+        T value;
+        while (pop(value)) {
+        }
+        delete m_tail;
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    // Any thread
+    size_t push(T value) {
+        Node* node = new Node(std::move(value));
+        size_t size = m_size.fetch_add(1) + 1;
+        Node* previous = m_head.exchange(node, std::memory_order_acq_rel);
+        previous->next.store(node, std::memory_order_release);
+        return size;
+    }
+
+    // Consumer thread only
+    bool pop(T& value) {
+        Node* tail = m_tail;
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (!next) {
+            return false;
+        }
+        value = std::move(next->value);
+        m_tail = next;
+        delete tail;
+        m_size.fetch_sub(1);
+        return true;
+    }
+
+    size_t size() const { return m_size.load(); }
+
+private:
+    struct Node {
+        Node() : next(nullptr) {}
+        explicit Node(T v) : next(nullptr), value(std::move(v)) {}
+        std::atomic<Node*> next;
+        T value;
+    };
+
+    std::atomic<Node*> m_head; // Producers append here
+    Node* m_tail;              // Consumer reads after this
+    std::atomic<size_t> m_size;
+};
+
+struct SubscriberStats {
+    std::string name;
+    Delivery delivery;
+    WorkerPool::Lane lane;
+    uint64_t delivered;
+    size_t depth;
+    size_t maxDepth;
+    double avgLatencyUs; // Publish to handler start
+    double maxLatencyUs;
+};
+
+struct TopicStats {
+    std::string name;
+    uint64_t published;
+    uint64_t dropped; // Published after the bus stopped
+    size_t depth;     // Queued over all subscribers
+    double avgLatencyUs;
+    double maxLatencyUs;
+    std::vector<SubscriberStats> subscribers;
+};
+
+/**
+ * Delivery counters of one subscription, updated from any thread
+ */
+struct DeliveryCounters {
+    std::atomic<uint64_t> delivered{0};
+    std::atomic<size_t> maxDepth{0};
+    std::atomic<int64_t> totalLatencyNs{0};
+    std::atomic<int64_t> maxLatencyNs{0};
+
+    void queued(size_t depth);
+    void record(int64_t latencyNs);
+};
+
+class EventBus;
+
+class TopicBase {
+public:
+    TopicBase(EventBus& bus, const std::string& name);
+    virtual ~TopicBase() = default;
+
+    const std::string& name() const { return m_name; }
+    virtual TopicStats stats() const = 0;
+
+    // Drain and join dedicated subscriber threads
+    virtual void stop() = 0;
+
+protected:
+    static int64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Subscription whose handler the calling thread is in, so it can unsubscribe itself
+    static inline thread_local const void* s_delivering = nullptr;
+
+    EventBus& m_bus;
+    std::string m_name;
+    std::atomic<uint64_t> m_published;
+    std::atomic<uint64_t> m_dropped;
+};
+
+/**
+ * Typed publish/subscribe channel. Every non-inline subscriber has its own
+ * queue, so a slow one never holds up the others.
+ */
+template <typename Event>
+class Topic : public TopicBase {
+public:
+    using Handler = std::function<void(const Event&)>;
+
+    Topic(EventBus& bus, const std::string& name) : TopicBase(bus, name), m_nextId(1) {
+        std::atomic_store(&m_subscriptions, std::make_shared<const SubscriptionList>());
+    }
+
+    ~Topic() override { stop(); }
+
+    /**
+     * @param subscriber Name shown in the stats
+     * @param lane Worker pool lane for Pool delivery
+     * @return Subscription id for unsubscribe()
+     */
+    int subscribe(const std::string& subscriber, Delivery delivery, Handler handler,
+                  WorkerPool::Lane lane = WorkerPool::Lane::Feeding);
+    // Returns once no handler call for it is running, later events are dropped
+    void unsubscribe(int id);
+
+    // Any thread, never blocks on a subscriber unless it is Inline
+    void publish(const Event& event);
+
+    TopicStats stats() const override;
+    void stop() override;
+
+private:
+    struct Envelope {
+        Event event;
+        int64_t publishedNs;
+    };
+
+    struct Subscription {
+        int id;
+        std::string name;
+        Delivery delivery;
+        WorkerPool::Lane lane;
+        Handler handler;
+        MpscQueue<Envelope> queue;
+        DeliveryCounters counters;
+        std::atomic<bool> scheduled{false}; // Pool: a drain job is queued or running
+        std::atomic<bool> active{true};     // Cleared by unsubscribe, no handler calls after
+        std::atomic<int> inFlight{0};       // Handler calls started and not yet returned
+        std::atomic<bool> running{true};    // Dedicated: thread keeps waiting
+        std::atomic<bool> sleeping{false};
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::thread thread;
+    };
+
+    using SubscriptionList = std::vector<std::shared_ptr<Subscription>>;
+
+    // Events handed to one pool job before it yields the thread
+    static const int POOL_BATCH = 16;
+
+    static void deliver(Subscription& subscription, const Envelope& envelope);
+    // Clear active and wait for the handler calls already started
+    static void deactivate(Subscription& subscription);
+    static void dedicatedWorker(std::shared_ptr<Subscription> subscription);
+    void schedule(const std::shared_ptr<Subscription>& subscription);
+    void drain(std::shared_ptr<Subscription> subscription);
+    static void stopThread(Subscription& subscription);
+
+    // Copy-on-write so publish() never takes a lock
+    std::shared_ptr<const SubscriptionList> m_subscriptions;
+    std::mutex m_subscribeMutex;
+    int m_nextId;
+};
+
+/**
+ * Subscriptions of one object, cancelled when it is destroyed
+ */
+class Subscriptions {
+public:
+    Subscriptions() = default;
+    ~Subscriptions() { clear(); }
+    Subscriptions(const Subscriptions&) = delete;
+    Subscriptions& operator=(const Subscriptions&) = delete;
+
+    template <typename Event>
+    void add(Topic<Event>& topic, const std::string& subscriber, Delivery delivery,
+             typename Topic<Event>::Handler handler, WorkerPool::Lane lane = WorkerPool::Lane::Feeding) {
+        int id = topic.subscribe(subscriber, delivery, std::move(handler), lane);
+        m_cancel.push_back([&topic, id]() { topic.unsubscribe(id); });
+    }
+
+    void clear() {
+        for (auto& cancel : m_cancel) {
+            cancel();
+        }
+        m_cancel.clear();
+    }
+
+private:
+    std::vector<std::function<void()>> m_cancel;
+};
+
+/**
+ * Registry of named topics shared by all components
+ */
+class EventBus {
+public:
+    explicit EventBus(WorkerPool& pool);
+    ~EventBus();
+
+    /**
+     * Topic by name, created on first use
+     * @throws std::logic_error if the name is already used with another event type
+     */
+    template <typename Event>
+    Topic<Event>& topic(const std::string& name);
+
+    /**
+     * Drain and join dedicated threads, later publishes are dropped. Stop the
+     * worker pool first so pool subscribers can still publish while it drains.
+     */
+    void stop();
+
+    bool isRunning() const { return m_running; }
+    WorkerPool& pool() { return m_pool; }
+    std::vector<TopicStats> stats() const;
+
+private:
+    WorkerPool& m_pool;
+    std::atomic<bool> m_running;
+    mutable std::mutex m_mutex;
+    std::map<std::string, std::unique_ptr<TopicBase>> m_topics;
+};
+
+template <typename Event>
+Topic<Event>& EventBus::topic(const std::string& name) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_topics.find(name);
+    if (it == m_topics.end()) {
+        it = m_topics.emplace(name, std::make_unique<Topic<Event>>(*this, name)).first;
+    }
+    Topic<Event>* topic = dynamic_cast<Topic<Event>*>(it->second.get());
+    if (!topic) {
+        throw std::logic_error("Event bus topic " + name + " used with another event type");
+    }
+    return *topic;
+}
+
+template <typename Event>
+int Topic<Event>::subscribe(const std::string& subscriber, Delivery delivery, Handler handler,
+                            WorkerPool::Lane lane) {
+    auto subscription = std::make_shared<Subscription>();
+    subscription->name = subscriber;
+    subscription->delivery = delivery;
+    subscription->lane = lane;
+    subscription->handler = std::move(handler);
+
+    std::lock_guard<std::mutex> lock(m_subscribeMutex);
+    subscription->id = m_nextId++;
+    if (delivery == Delivery::Dedicated) {
+        subscription->thread = std::thread(&Topic::dedicatedWorker, subscription);
+    }
+    auto list = std::make_shared<SubscriptionList>(*std::atomic_load(&m_subscriptions));
+    list->push_back(subscription);
+    std::atomic_store(&m_subscriptions, std::shared_ptr<const SubscriptionList>(list));
+    return subscription->id;
+}
+
+template <typename Event>
+void Topic<Event>::unsubscribe(int id) {
+    std::shared_ptr<Subscription> removed;
+    {
+        std::lock_guard<std::mutex> lock(m_subscribeMutex);
+        auto list = std::make_shared<SubscriptionList>(*std::atomic_load(&m_subscriptions));
+        for (auto it = list->begin(); it != list->end(); ++it) {
+            if ((*it)->id == id) {
+                removed = *it;
+                list->erase(it);
+                break;
+            }
+        }
+        std::atomic_store(&m_subscriptions, std::shared_ptr<const SubscriptionList>(list));
+    }
+    if (removed) {
+        // A queued drain job or a publisher holding the old list may still reach it
+        stopThread(*removed);
+        deactivate(*removed);
+    }
+}
+
+template <typename Event>
+void Topic<Event>::publish(const Event& event) {
+    if (!m_bus.isRunning()) {
+        m_dropped++;
+        return;
+    }
+    m_published++;
+
+    auto list = std::atomic_load(&m_subscriptions);
+    const int64_t publishedNs = nowNs();
+    for (const auto& subscription : *list) {
+        switch (subscription->delivery) {
+        case Delivery::Inline:
+            deliver(*subscription, {event, publishedNs});
+            break;
+        case Delivery::Dedicated:
+            subscription->counters.queued(subscription->queue.push({event, publishedNs}));
+            if (subscription->sleeping) {
+                std::lock_guard<std::mutex> lock(subscription->mutex);
+                subscription->condition.notify_one();
+            }
+            break;
+        case Delivery::Pool:
+            subscription->counters.queued(subscription->queue.push({event, publishedNs}));
+            schedule(subscription);
+            break;
+        }
+    }
+}
+
+template <typename Event>
+TopicStats Topic<Event>::stats() const {
+    TopicStats stats = { m_name, m_published, m_dropped, 0, 0.0, 0.0, {} };
+    uint64_t delivered = 0;
+    double totalLatencyUs = 0.0;
+    for (const auto& subscription : *std::atomic_load(&m_subscriptions)) {
+        const DeliveryCounters& counters = subscription->counters;
+        SubscriberStats subscriber;
+        subscriber.name = subscription->name;
+        subscriber.delivery = subscription->delivery;
+        subscriber.lane = subscription->lane;
+        subscriber.delivered = counters.delivered;
+        subscriber.depth = subscription->queue.size();
+        subscriber.maxDepth = counters.maxDepth;
+        subscriber.avgLatencyUs = subscriber.delivered ?
+            counters.totalLatencyNs / 1000.0 / subscriber.delivered : 0.0;
+        subscriber.maxLatencyUs = counters.maxLatencyNs / 1000.0;
+
+        stats.depth += subscriber.depth;
+        stats.maxLatencyUs = std::max(stats.maxLatencyUs, subscriber.maxLatencyUs);
+        delivered += subscriber.delivered;
+        totalLatencyUs += counters.totalLatencyNs / 1000.0;
+        stats.subscribers.push_back(subscriber);
+    }
+    stats.avgLatencyUs = delivered ? totalLatencyUs / delivered : 0.0;
+    return stats;
+}
+
+template <typename Event>
+void Topic<Event>::stop() {
+    for (const auto& subscription : *std::atomic_load(&m_subscriptions)) {
+        stopThread(*subscription);
+    }
+}
+
+template <typename Event>
+void Topic<Event>::deliver(Subscription& subscription, const Envelope& envelope) {
+    // Counted before active is checked, so deactivate() either waits for this call or it never starts
+    subscription.inFlight++;
+    if (subscription.active) {
+        subscription.counters.record(nowNs() - envelope.publishedNs);
+        const void* outer = s_delivering;
+        s_delivering = &subscription;
+        try {
+            subscription.handler(envelope.event);
+        } catch (const std::exception& e) {
+            std::cerr << "Exception in event subscriber " << subscription.name << ": " << e.what() << std::endl;
+        }
+        s_delivering = outer;
+    }
+    if (--subscription.inFlight == 0 && !subscription.active) {
+        std::lock_guard<std::mutex> lock(subscription.mutex);
+        subscription.condition.notify_all();
+    }
+}
+
+template <typename Event>
+void Topic<Event>::deactivate(Subscription& subscription) {
+    subscription.active = false;
+    // A handler unsubscribing itself can't wait for its own call
+    int own = s_delivering == &subscription ? 1 : 0;
+    std::unique_lock<std::mutex> lock(subscription.mutex);
+    subscription.condition.wait(lock, [&]() { return subscription.inFlight <= own; });
+}
+
+template <typename Event>
+void Topic<Event>::dedicatedWorker(std::shared_ptr<Subscription> subscription) {
+    realtime::applyThreadPolicy(realtime::ThreadRole::Detection);
+    Envelope envelope;
+    while (true) {
+        if (subscription->queue.pop(envelope)) {
+            deliver(*subscription, envelope);
+            continue;
+        }
+        if (!subscription->running && subscription->queue.size() == 0) {
+            break; // Stopped and drained
+        }
+        std::unique_lock<std::mutex> lock(subscription->mutex);
+        subscription->sleeping = true;
+        subscription->condition.wait(lock, [&]() {
+            return subscription->queue.size() > 0 || !subscription->running;
+        });
+        subscription->sleeping = false;
+    }
+}
+
+template <typename Event>
+void Topic<Event>::schedule(const std::shared_ptr<Subscription>& subscription) {
+    if (!subscription->scheduled.exchange(true)) {
+        if (!m_bus.pool().submit([this, subscription]() { drain(subscription); }, subscription->lane)) {
+            subscription->scheduled = false;
+        }
+    }
+}
+
+template <typename Event>
+void Topic<Event>::drain(std::shared_ptr<Subscription> subscription) {
+    // Only one drain job per subscription at a time, so this is the single consumer
+    Envelope envelope;
+    while (true) {
+        for (int i = 0; i < POOL_BATCH && subscription->queue.pop(envelope); ++i) {
+            deliver(*subscription, envelope);
+        }
+        subscription->scheduled = false;
+        if (subscription->queue.size() == 0 || subscription->scheduled.exchange(true)) {
+            return; // Empty, or a publisher already queued the next drain
+        }
+        if (m_bus.pool().submit([this, subscription]() { drain(subscription); }, subscription->lane)) {
+            return; // Yield the pool thread, then continue
+        }
+        // Pool is stopping and takes no new jobs, finish the queue here
+    }
+}
+
+template <typename Event>
+void Topic<Event>::stopThread(Subscription& subscription) {
+    if (!subscription.thread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(subscription.mutex);
+        subscription.running = false;
+        subscription.condition.notify_one();
+    }
+    subscription.thread.join();
+}
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * Single-threaded epoll reactor
+ *
+ * Multiplexes GPIO event fds, timerfds, a signalfd and sockets on the thread
+ * that calls run(). Handlers must return quickly, blocking work belongs on a
+ * WorkerPool. Registration is thread-safe.
+ */
+class EventLoop {
+public:
+    // Called with the epoll event mask
+    using Handler = std::function<void(uint32_t events)>;
+
+    EventLoop();
+    ~EventLoop();
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    /**
+     * Watch a file descriptor
+     * @param events epoll events, EPOLLONESHOT to disarm after each event until rearm()
+     */
+    bool add(int fd, uint32_t events, Handler handler);
+    bool rearm(int fd, uint32_t events);
+    void remove(int fd);
+
+    /**
+     * Create a disarmed CLOCK_MONOTONIC timerfd
+     * @return Timer id (its fd), -1 on failure
+     */
+    int addTimer(std::function<void()> callback);
+
+    /**
+     * @param delayNs First expiry, 0 disarms the timer
+     * @param intervalNs Period after the first expiry, 0 for one-shot
+     */
+    bool armTimer(int timer, int64_t delayNs, int64_t intervalNs = 0);
+    void removeTimer(int timer);
+
+    /**
+     * Deliver signals through a signalfd, they must be blocked with blockSignals() first
+     */
+    bool addSignals(const std::vector<int>& signals, std::function<void(int)> callback);
+
+    /**
+     * Block signals in the calling thread, call before any thread is started so all inherit it
+     */
+    static void blockSignals(const std::vector<int>& signals);
+
+    // Run a job on the loop thread
+    void post(std::function<void()> job);
+
+    // Dispatch events until stop()
+    void run();
+    void stop();
+
+    uint64_t wakeups() const { return m_wakeups; }
+    size_t watchCount() const;
+
+private:
+    void drainPosted();
+
+    int m_epollFd;
+    int m_wakeupFd;
+    int m_signalFd;
+    std::atomic<bool> m_running;
+    std::atomic<uint64_t> m_wakeups;
+
+    // Shared so a handler removed while it runs stays alive until it returns
+    mutable std::mutex m_mutex;
+    std::map<int, std::shared_ptr<Handler>> m_handlers;
+    std::vector<std::function<void()>> m_posted;
+};
+
+#endif
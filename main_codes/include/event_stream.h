@@ -0,0 +1,108 @@
+#ifndef EVENT_STREAM_H
+#define EVENT_STREAM_H
+
+#include "event_loop.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+
+/**
+ * Push endpoint settings, loaded from config/events.json
+ */
+struct EventStreamConfig {
+    std::string socketPath = "/tmp/fish_events.socket";
+    int maxClients = 32;
+    int bufferBytes = 256 * 1024; // Unsent bytes a client may fall behind before it is dropped
+    int keepaliveMs = 15000;      // Comment line to idle clients, also finds dead ones and silent new ones
+
+    bool load(const std::string& path);
+};
+
+/**
+ * Server-Sent Events on a Unix socket, proxied by the web server
+ *
+ * Clients are non-blocking sockets watched by the event loop, so each one
+ * costs a buffer and no thread. An event is formatted once and written to
+ * every client straight away. Whatever a socket won't take is kept in that
+ * client's buffer and flushed when the loop reports it writable. A client
+ * that falls more than bufferBytes behind is dropped, so a slow reader
+ * never holds up the publisher or grows without bound. A connection that
+ * hasn't sent its request within keepaliveMs is closed, so silent ones
+ * can't hold the maxClients slots. Browsers reconnect on their own, and every new client starts with the greeting, the full
+ * status, before any event.
+ */
+class EventStream {
+public:
+    struct Stats {
+        uint64_t clients;  // Streaming now
+        uint64_t accepted;
+        uint64_t rejected; // Over maxClients, a bad request or none in time
+        uint64_t dropped;  // Fell too far behind
+        uint64_t events;
+        uint64_t bytes;    // Written to sockets
+    };
+
+    // Events a new client receives first, already formatted with format()
+    using Greeting = std::function<std::string()>;
+
+    EventStream(EventLoop& loop, const EventStreamConfig& config = EventStreamConfig());
+    ~EventStream();
+    EventStream(const EventStream&) = delete;
+    EventStream& operator=(const EventStream&) = delete;
+
+    bool start(Greeting greeting);
+    void stop();
+
+    // Send to every client, any thread
+    void publish(const std::string& event, const std::string& data);
+
+    // One SSE message, each line of data on its own data: field, id 0 for none
+    static std::string format(const std::string& event, uint64_t id, const std::string& data);
+
+    // Cheap check before building an event nobody would receive
+    bool hasClients() const { return m_streaming > 0; }
+    Stats stats() const;
+
+private:
+    struct Client {
+        int fd;
+        bool streaming;      // Request read and response started
+        bool watchingOutput; // EPOLLOUT armed for a backlog
+        std::string request;
+        std::string backlog;
+        size_t sent;         // Bytes of backlog already written
+        int64_t acceptedNs;  // Steady clock, the request has to follow within keepaliveMs
+    };
+    using Clients = std::map<uint64_t, Client>;
+
+    void accept();
+    void handle(uint64_t id, uint32_t events);
+    // Keepalive comment to streaming clients, closes the ones without a request yet
+    void keepalive();
+
+    // Called with m_mutex held
+    void broadcast(const std::string& message);
+    // Queue and write what the socket takes, false if the client has to go
+    bool queue(Client& client, const std::string& message);
+    bool flush(Client& client);
+    void drop(Clients::iterator client);
+
+    EventLoop& m_loop;
+    EventStreamConfig m_config;
+    Greeting m_greeting;
+    int m_socket;
+    int m_timer;
+
+    mutable std::mutex m_mutex;
+    Clients m_clients;
+    uint64_t m_nextClient;
+    uint64_t m_nextEvent;
+    std::atomic<size_t> m_streaming;
+    Stats m_stats;
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef FASTCGI_SERVER_H
+#define FASTCGI_SERVER_H
+
+#include "event_loop.h"
+#include "worker_pool.h"
+#include <fcgiapp.h>
+#include <string>
+
+/**
+ * JSON FastCGI endpoint served from the event loop
+ *
+ * GET returns the JSON from the GET callback. POST passes the body to the POST
+ * callback and returns its reply, or the GET JSON if the reply is empty.
+ * The listening socket is watched by the loop, each request is handled on the
+ * worker pool.
+ */
+class FastCgiServer {
+public:
+    struct GETCallback {
+        virtual std::string getJSONString() = 0;
+
+        // GET with a query string, the plain status unless overridden
+        virtual std::string queryJSONString(const std::string& /*query*/) { return getJSONString(); }
+    };
+
+    struct POSTCallback {
+        virtual std::string postString(std::string postArg) = 0;
+    };
+
+    FastCgiServer(EventLoop& loop, WorkerPool& pool);
+    ~FastCgiServer();
+
+    bool start(GETCallback* getCallback, POSTCallback* postCallback,
+               const std::string& socketPath = "/tmp/fastcgisocket");
+    void stop();
+
+    uint64_t requests() const { return m_requests; }
+
+private:
+    // Accept one connection on the pool, then rearm the listening socket
+    void accept();
+    void handle(FCGX_Request* request);
+
+    EventLoop& m_loop;
+    WorkerPool& m_pool;
+    GETCallback* m_getCallback;
+    POSTCallback* m_postCallback;
+    std::string m_socketPath;
+    int m_socket;
+    std::atomic<uint64_t> m_requests;
+};
+
+#endif
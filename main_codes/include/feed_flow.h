@@ -0,0 +1,133 @@
+#ifndef FEED_FLOW_H
+#define FEED_FLOW_H
+
+#include "capture_admission.h"
+#include "event_loop.h"
+#include "feed_scheduler.h"
+#include "feeder.h"
+#include "flow.h"
+#include "frame_pipeline.h"
+#include "image_processor.h"
+#include "worker_pool.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * Trigger flow deadlines, loaded from config/feed_flow.json
+ */
+struct FeedFlowConfig {
+    int captureTimeoutMs = 15000; // libcamera-still includes sensor start-up
+    int detectTimeoutMs = 5000;
+    int feedTimeoutMs = 60000;    // Longest feed profile plus stagger
+    int maxInFlight = 4;          // Further triggers are rejected
+
+    bool load(const std::string& path);
+};
+
+/**
+ * Trigger-to-feed sequence as a coroutine: capture, detect, then feed if
+ * fish were found
+ *
+ * While a scheduled feed window is open the detection goes to the scheduler
+ * instead, which feeds the window once with its own profile and feeders, so
+ * one detection never feeds twice.
+ *
+ * A flow suspends between steps, so overlapping triggers cost a coroutine
+ * frame each instead of a thread. Every step has a deadline; stop() cancels
+ * all flows in flight (a feed that is playing stops its motors) and waits for
+ * them to unwind.
+ */
+class FeedFlow {
+public:
+    struct StepStats {
+        const char* name;
+        uint64_t ok;
+        uint64_t failed;
+        uint64_t timedOut;
+        uint64_t cancelled;
+    };
+
+    struct Stats {
+        uint64_t triggered;
+        uint64_t rejected;  // Stopped or too many in flight
+        uint64_t fed;
+        uint64_t noFish;
+        uint64_t windowed; // Fish found while a feed window was open, fed by the window
+        std::time_t lastFedTime; // 0 if never
+        size_t inFlight;
+        std::vector<StepStats> steps;
+    };
+
+    FeedFlow(EventLoop& loop, WorkerPool& pool, CaptureAdmission& capture, FramePipeline& pipeline,
+             Feeder& feeder, FeedScheduler* scheduler, const FeedFlowConfig& config = FeedFlowConfig());
+    ~FeedFlow();
+    FeedFlow(const FeedFlow&) = delete;
+    FeedFlow& operator=(const FeedFlow&) = delete;
+
+    /**
+     * Start a flow, any thread
+     * @return false if stopped or maxInFlight flows are running
+     */
+    bool trigger();
+
+    // Cancel every flow in flight and wait for them, later triggers are rejected
+    void stop();
+
+    Stats stats() const;
+
+private:
+    enum Stage {
+        CAPTURE,
+        DETECT,
+        FEED,
+        STAGES
+    };
+
+    struct StepCounters {
+        std::atomic<uint64_t> ok{0};
+        std::atomic<uint64_t> failed{0};
+        std::atomic<uint64_t> timedOut{0};
+        std::atomic<uint64_t> cancelled{0};
+    };
+
+    Flow run(std::shared_ptr<Cancellation> cancellation);
+
+    // co_await-able steps, capture yields the pipeline's frame id
+    Step<uint64_t> capture(const FlowContext& context);
+    Step<ImageProcessor::DetectionEvent> detect(const FlowContext& context, uint64_t frame);
+    Step<bool> feed(const FlowContext& context);
+
+    // Count a step result, true if the flow goes on
+    bool record(Stage stage, StepStatus status);
+    void finished(const std::shared_ptr<Cancellation>& cancellation);
+
+    EventLoop& m_loop;
+    WorkerPool& m_pool;
+    CaptureAdmission& m_capture;
+    FramePipeline& m_pipeline;
+    Feeder& m_feeder;
+    FeedScheduler* m_scheduler; // Optional, owns feed windows
+    FeedFlowConfig m_config;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_idle;
+    bool m_running;
+    std::set<std::shared_ptr<Cancellation>> m_inFlight;
+
+    std::atomic<uint64_t> m_triggered;
+    std::atomic<uint64_t> m_rejected;
+    std::atomic<uint64_t> m_fed;
+    std::atomic<uint64_t> m_noFish;
+    std::atomic<uint64_t> m_windowed;
+    std::atomic<std::time_t> m_lastFedTime;
+    StepCounters m_steps[STAGES];
+};
+
+#endif
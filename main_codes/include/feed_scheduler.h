@@ -0,0 +1,138 @@
+#ifndef FEED_SCHEDULER_H
+#define FEED_SCHEDULER_H
+
+#include "event_bus.h"
+#include "event_loop.h"
+#include <atomic>
+#include <bitset>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Cron expression subset: "minute hour day-of-month month day-of-week"
+ * with *, lists, ranges and steps (e.g. "0 8,18 * * 1-5", "*\/30 * * * *")
+ */
+class CronExpression {
+public:
+    bool parse(const std::string& expression);
+
+    /**
+     * Next matching minute strictly after t (local time), 0 if none within a year
+     */
+    std::time_t nextAfter(std::time_t t) const;
+
+private:
+    std::bitset<60> m_minutes;
+    std::bitset<24> m_hours;
+    std::bitset<32> m_daysOfMonth;
+    std::bitset<13> m_months;
+    std::bitset<7> m_daysOfWeek;
+    bool m_anyDayOfMonth = true;
+    bool m_anyDayOfWeek = true;
+};
+
+/**
+ * Feeding scheduler on a hierarchical timing wheel
+ *
+ * An event loop timer ticks once a second, each tick touches a single slot
+ * (plus a cascade every 64 ticks), so the cost per tick does not depend on how
+ * many feeds are scheduled. Due feeds are published on the "scheduled_feed"
+ * topic. Entries are persisted as JSON and reloaded on start.
+ */
+class FeedScheduler {
+public:
+    enum class Kind {
+        OneShot,   // Feed once after a delay
+        Recurring, // Feed on a cron schedule
+        Window     // Open on a cron schedule, feed on the first detection before it closes
+    };
+
+    struct Entry {
+        int id;
+        Kind kind;
+        std::string cron;
+        std::time_t fireAt;  // Next open/fire time, close time while a window is open
+        int windowMinutes;
+        bool windowOpen;
+        std::string profile;
+        std::vector<std::string> feeders;
+    };
+
+    FeedScheduler(EventLoop& loop, EventBus& bus,
+                  const std::string& persistPath = "../data/feed_schedule.json");
+    ~FeedScheduler();
+
+    // Load persisted entries and start the tick timer
+    void start();
+
+    // Stop the tick timer
+    void stop();
+
+    /**
+     * Add entries, all return the entry id or -1 if the cron expression is invalid
+     */
+    int addOneShot(int delaySeconds, const std::string& profile, const std::vector<std::string>& feeders);
+    int addRecurring(const std::string& cron, const std::string& profile, const std::vector<std::string>& feeders);
+    int addWindow(const std::string& cron, int windowMinutes, const std::string& profile,
+                  const std::vector<std::string>& feeders);
+
+    bool cancel(int id);
+    std::vector<Entry> entries() const;
+
+    /**
+     * Fish were detected, feeds every open window that hasn't fed yet
+     * @return true while a window is open, its feed replaces the automatic one
+     */
+    bool fishDetected();
+
+    static const char* kindName(Kind kind);
+
+private:
+    static const int LEVELS = 5;
+    static const int SLOT_BITS = 6;
+    static const int SLOTS = 1 << SLOT_BITS;
+
+    // Wheel slots hold references, cancelled or rescheduled entries are skipped lazily
+    struct TimerRef {
+        int id;
+        uint32_t generation;
+    };
+
+    struct Timer {
+        Entry entry;
+        CronExpression cron;
+        uint32_t generation;
+        bool fed;
+    };
+
+    // Tick timer expired, advance the wheel to the current time
+    void onTimer();
+    int add(const Entry& entry, const CronExpression& cron);
+    void schedule(Timer& timer);
+    void insert(const TimerRef& ref, int64_t due);
+    void tick(std::vector<Entry>& due);
+    void fire(Timer& timer, std::vector<Entry>& due);
+    void rebuild(int64_t now);
+    bool catchUp(Timer& timer, int64_t now);
+    void notify(const std::vector<Entry>& due);
+    void load();
+    void save() const;
+
+    EventLoop& m_loop;
+    Topic<Entry>& m_feedTopic;
+    std::string m_persistPath;
+    std::atomic<bool> m_running;
+    int m_timer;
+    mutable std::mutex m_mutex;
+
+    std::vector<TimerRef> m_wheel[LEVELS][SLOTS];
+    int64_t m_currentTick;
+    std::map<int, Timer> m_timers;
+    int m_nextId;
+};
+
+#endif
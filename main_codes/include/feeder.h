@@ -1,34 +1,39 @@
 #ifndef FEEDER_H
 #define FEEDER_H
 
+#include "feeder_bank.h"
 #include "image_processor.h"
-#include "motor.h"
+#include "motor_profile.h"
 #include <opencv2/opencv.hpp>
 #include <memory>
 
 /**
  *  class that controls the feeding 
+ *
+ *  Feeding is the last step of the trigger flow, detections are archived by
+ *  the frame pipeline's own stage so slow SD card writes never hold up a feed.
  */
-class Feeder : public ImageProcessor::FishDetectionCallbackInterface {
+class Feeder {
 public:
     
-    Feeder(int motorPin = 4);
-    void fishDetected(const cv::Mat& image) override;
-    void noFishDetected(const cv::Mat& image) override;
-    Motor* getMotor() {return m_motor.get();}
-private:
+    Feeder(EventBus& bus, const FeederBankConfig& config, const MotorProfileLibrary* profiles);
+    
     /**
-     * Activate the feeding mechanism
+     * Activate the feeding mechanism, blocks for the length of the profiles
+     * @param abort Set to stop the motors early
      */
-    void activateFeeder();
+    bool feed(const std::atomic<bool>* abort = nullptr);
     
     /**
-     * Save the captured image
+     * Save the captured image to the archive
      */
-    void saveImage(const cv::Mat& image, bool fishDetected);
+    bool saveImage(const cv::Mat& image, bool fishDetected);
+    
+    FeederBank* getBank() {return m_bank.get();}
+private:
     
-    // Motor control
-    std::unique_ptr<Motor> m_motor;
+    // Motor control for every feeder
+    std::unique_ptr<FeederBank> m_bank;
 };
 
 #endif 
@@ -0,0 +1,130 @@
+#ifndef FEEDER_BANK_H
+#define FEEDER_BANK_H
+
+#include "event_bus.h"
+#include "gpio_request.h"
+#include "motor_profile.h"
+#include <gpiod.h>
+#include <atomic>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Feeder bank configuration, loaded from config/feeders.json
+ */
+struct FeederBankConfig {
+    struct Feeder {
+        std::string name;
+        int pin;
+        bool autoFeed;       // Fed when fish are detected
+        std::string profile; // Empty for the library default
+    };
+
+    std::vector<Feeder> feeders = {{"main", 4, true, ""}};
+    std::string chipPath = "/dev/gpiochip0"; // Empty for simulated lines
+    bool staggered = true; // Offset feeder starts to limit inrush current
+    int staggerMs = 250;
+
+    bool load(const std::string& path);
+};
+
+/**
+ * Several feeder motors driven through a single GPIO line request.
+ * Timelines of all feeders in one feed are merged so edges falling on the
+ * same instant are written with one syscall. Every feed is published on
+ * the "feed" topic when its motors start and again when they stop.
+ */
+class FeederBank {
+public:
+    struct FeederStats {
+        std::string name;
+        int pin;
+        int feedCount;
+        std::time_t lastFeedTime;
+        int64_t runTimeMs;
+        bool running;
+    };
+
+    struct FeedEvent {
+        uint64_t timestampNs; // CLOCK_MONOTONIC
+        uint64_t feeders;     // One bit per feeder index
+        bool running;         // Motors starting, false once they stopped
+        bool completed;       // Stopped at the end of the profile, not aborted or cut short
+    };
+
+    // One bit per feeder in the merged edge masks
+    static const size_t MAX_FEEDERS = 64;
+
+    FeederBank(EventBus& bus, const FeederBankConfig& config, const MotorProfileLibrary* profiles);
+    ~FeederBank();
+
+    /**
+     * Run a profile on several feeders at once, blocks until all are done
+     * @param indices Feeders to run, each at most once
+     * @param profile Profile name, empty for each feeder's configured profile
+     * @param staggered Offset the starts by the configured stagger
+     * @param abort Polled while playing, set to stop every motor early
+     * @return false if GPIO is not initialized, a feeder is unknown or repeated, the profile is
+     *         unknown or it was aborted
+     */
+    bool feed(const std::vector<int>& indices, const std::string& profile, bool staggered,
+              const std::atomic<bool>* abort = nullptr);
+
+    /**
+     * Run the feeders marked for automatic feeding
+     */
+    bool feedAuto(const std::atomic<bool>* abort = nullptr);
+
+    /**
+     * Play a timeline on a single feeder
+     */
+    bool play(int index, const EdgeTimeline& timeline);
+
+    /**
+     * Drive every motor line low
+     */
+    void stop();
+
+    int indexOf(const std::string& name) const;
+    std::vector<int> autoFeeders() const;
+    std::vector<FeederStats> stats() const;
+    size_t size() const { return m_config.feeders.size(); }
+    bool isStaggered() const { return m_config.staggered; }
+    bool isInitialized() const { return m_gpioInitialized; }
+
+private:
+    // Level changes of all lines at one instant
+    struct BankEdge {
+        int64_t atNs;
+        uint64_t mask;
+        uint64_t values;
+    };
+
+    struct Playback {
+        int index;
+        const EdgeTimeline* timeline;
+        int64_t offsetNs;
+    };
+
+    bool playMerged(const std::vector<Playback>& playbacks, const std::atomic<bool>* abort = nullptr);
+    static std::vector<BankEdge> merge(const std::vector<Playback>& playbacks);
+    void writeLevels(uint64_t levels);
+
+    Topic<FeedEvent>& m_feedTopic;
+    FeederBankConfig m_config;
+    const MotorProfileLibrary* m_profiles;
+    gpiod_line_request* m_request;
+    bool m_gpioInitialized;
+    bool m_simulated;
+    uint64_t m_levels;
+    std::vector<gpiod_line_value> m_values; // In request order
+
+    // One playback at a time, the bulk write covers every line
+    std::mutex m_playMutex;
+    mutable std::mutex m_statsMutex;
+    std::vector<FeederStats> m_stats;
+};
+
+#endif
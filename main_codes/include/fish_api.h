@@ -1,77 +1,180 @@
 #ifndef FISH_API_H
 #define FISH_API_H
 
-#include "json_fastcgi_web_api.h"
-#include "motor.h"
+#include "event_bus.h"
+#include "event_loop.h"
+#include "event_stream.h"
+#include "fastcgi_server.h"
+#include "feed_flow.h"
+#include "feed_scheduler.h"
+#include "feeder_bank.h"
+#include "frame_pipeline.h"
+#include "motion_trigger.h"
+#include "motor_profile.h"
+#include "ph_history.h"
+#include "ph_sampler.h"
 #include "ph_sensor.h"
 #include "pir_sensor.h"
 #include "image_processor.h"
-#include "camera.h"
-#include <thread>
+#include "capture_admission.h"
+#include "command_queue.h"
+#include "worker_pool.h"
+#include <jsoncpp/json/json.h>
 #include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
-class FishAPI : public PHSensor::PHSensorCallbackInterface, 
-               public PirSensor::MotionCallbackInterface,
-               public ImageProcessor::FishDetectionCallbackInterface {
+class FishAPI {
 public:
-    FishAPI(Motor* motor, PHSensor* phSensor, PirSensor* pirSensor); 
+    /**
+     * Serves the shared capture graph, it owns no camera or detector of its own.
+     * Auto mode starts and stops the PIR sensor, the motion trigger and the camera, captures go
+     * through the same admission controller as the feed flow. pH comes from the sampler's cached
+     * reading, requests never wait for I2C.
+     *
+     * POST commands are queued and answered at once with a command id, feeds on the motor lane
+     * and everything else on the control lane. ?command=<id> and the "command" event report
+     * each one as queued, running, done or failed.
+     *
+     * GET serves a status snapshot that is already serialised. It is rebuilt on the pool when
+     * the state it shows changes, after every command, and once a second for the counters, then
+     * swapped in whole. Each build gets a new version, and ?since=<version> returns a short
+     * "unchanged" reply while it is still current.
+     *
+     * The event stream pushes the same status to dashboards: the full snapshot on connect, then
+     * the top-level sections that changed with each build, plus pH, alarm, feed and detection
+     * events as they are published.
+     */
+    FishAPI(FeederBank* feeders, PHSensor* phSensor, PHSampler* phSampler, const PHHistory* phHistory,
+            PirSensor* pirSensor, MotionTrigger* trigger, CaptureAdmission* capture,
+            const MotorProfileLibrary* profiles, FeedScheduler* scheduler,
+            const FeedFlow* flow, const FramePipeline* pipeline, EventLoop& loop, EventBus& bus,
+            const EventStreamConfig& eventsConfig = EventStreamConfig());
     ~FishAPI();
 
     void start();
     void stop();
     void setFishDetected(bool detected);
     void setLastImagePath(const std::string& path);
+    // Latest filtered pH, refreshed in the background if stale, -1 before the first reading
     float requestPHReading();
-    void feedFish(bool override);
+    // False if the feeders failed, aren't initialized or the feed was ignored
+    bool feedFish(bool override, const std::string& profile = "",
+                  const std::vector<int>& feeders = {}, bool staggered = true);
+    bool runProfile(const std::string& profile, int feeder = 0);
 
-    void onPHSample(float pH, float voltage, int16_t adcValue) override;
-    void motionDetected(gpiod_line_event event) override; // Pass-by-value  PirSensor
-    void fishDetected(const cv::Mat& image) override;
-    void noFishDetected(const cv::Mat& image) override;
+    // Event bus subscribers
+    void fishDetected(const cv::Mat& image);
+    void noFishDetected(const cv::Mat& image);
+    void scheduledFeed(const FeedScheduler::Entry& entry);
 
 private:
-    class GETHandler : public JSONCGIHandler::GETCallback {
+    // Immutable once published, readers keep it alive while they copy it
+    struct StatusSnapshot {
+        uint64_t version;
+        int64_t builtNs;
+        std::string json;
+    };
+
+    class GETHandler : public FastCgiServer::GETCallback {
     public:
         GETHandler(FishAPI* api);
         std::string getJSONString() override;
+        // ?ph_history&from=&to=&points=&resolution=, ?command=<id>, ?commands, anything else gets the status
+        std::string queryJSONString(const std::string& query) override;
     private:
+        std::string phHistoryJSONString(const std::map<std::string, std::string>& params);
+        std::string commandsJSONString(const std::map<std::string, std::string>& params);
+
         FishAPI* m_api;
     };
 
-    class POSTHandler : public JSONCGIHandler::POSTCallback {
+    class POSTHandler : public FastCgiServer::POSTCallback {
     public:
         POSTHandler(FishAPI* api);
-        void postString(std::string postArg) override;
+        // Queues the command, the reply carries its id
+        std::string postString(std::string postArg) override;
     private:
         FishAPI* m_api;
     };
 
-    void threadFunction();
+    // Feeder indices from a "feeder" POST field (name, index or array of them),
+    // false naming the first unknown one
+    bool parseFeeders(const Json::Value& value, std::vector<int>& indices, std::string& error) const;
+    
+    // Handle schedule_feed and cancel_schedule POST commands
+    bool scheduleCommand(const std::string& command, const Json::Value& root, std::string& error);
 
-    Motor* m_motor;
+    // Run a queued POST command on its lane, false with a reason on failure. A reading
+    // such as read_ph's goes in result.
+    bool runCommand(const std::string& command, const Json::Value& root, std::string& error,
+                    std::string& result);
+    // Stream and status updates for a command's state change
+    void commandChanged(const CommandQueue::Command& command);
+
+    // Rebuild the snapshot on the pool, changes before it runs share the build
+    void invalidate();
+    // Build and swap in a new snapshot now
+    void publishSnapshot();
+    Json::Value statusJSON();
+    // Sections that changed since the last build to stream clients, none if only volatile
+    // fields moved. Called with m_snapshotMutex held.
+    void pushStatusDelta(const Json::Value& root, const Json::Value& stable);
+    // Full status for a new stream client
+    std::string greeting() const;
+    // One event to stream clients, skipped if there are none
+    void push(const char* event, const Json::Value& data);
+
+    FeederBank* m_feeders;
+    const MotorProfileLibrary* m_profiles;
+    FeedScheduler* m_scheduler;
+    const FeedFlow* m_flow;
+    const FramePipeline* m_pipeline;
     PHSensor* m_phSensor;
+    PHSampler* m_phSampler;
+    const PHHistory* m_phHistory;
     PirSensor* m_pirSensor; // Changed to pointer, not owned by FishAPI
-    Camera m_camera;
-    ImageProcessor m_imageProcessor;
+    MotionTrigger* m_trigger;
+    CaptureAdmission* m_capture; // Shared with the feed flow
+    EventLoop& m_loop;
+    EventBus& m_bus;
+    WorkerPool& m_pool;
     std::atomic<bool> m_running;
-    std::thread m_thread;
-    JSONCGIHandler m_handler;
+    FastCgiServer m_server;
+    EventStream m_events;
     GETHandler m_getHandler;
     POSTHandler m_postHandler;
+    CommandQueue m_commands;
     
     std::atomic<bool> m_fishDetected;
+    // Guards the plain fields below, written by feeds and detections while the status reads them
+    std::mutex m_stateMutex;
     std::string m_lastImagePath;
     std::atomic<int> m_feedCount;
     std::atomic<int> m_autoFeedCount;
+    std::atomic<int> m_scheduledFeedCount;
     std::time_t m_lastFeedTime;
     std::time_t m_AutolastFeedTime;
     std::atomic<bool> m_autoModeEnabled;
 
-    std::atomic<float> m_currentPH;
-    std::atomic<float> m_currentPHVoltage;
-    std::atomic<int16_t> m_currentPHAdcValue;
-    std::time_t m_lastPHReadTime;
+    std::mutex m_snapshotMutex; // One build at a time, so versions go out in order
+    uint64_t m_snapshotVersion;   // Moves when the state does, not with every build
+    std::string m_snapshotState;  // Compact JSON of the last build without volatile fields
+    std::atomic<std::shared_ptr<const StatusSnapshot>> m_snapshot;
+    std::atomic<bool> m_snapshotPending;
+    int m_snapshotTimer;
+    std::atomic<uint64_t> m_snapshotBuilds;
+    std::atomic<int64_t> m_snapshotBuildNs;
+    std::atomic<uint64_t> m_snapshotServes;
+    std::atomic<int64_t> m_snapshotServeNs;
+    std::map<std::string, std::string> m_statusSections; // Compact JSON per section as last streamed
+
+    // Last member, cancelled before anything a handler touches is destroyed
+    Subscriptions m_subscriptions;
 };
 
 #endif 
@@ -1,19 +1,31 @@
 #ifndef FISH_MONITORING_SYSTEM_H
 #define FISH_MONITORING_SYSTEM_H
 
+#include "ads1115_emulator.h"
 #include "camera.h"
+#include "capture_admission.h"
+#include "event_bus.h"
+#include "event_loop.h"
+#include "feed_flow.h"
+#include "feed_scheduler.h"
 #include "feeder.h"
+#include "frame_pipeline.h"
 #include "image_processor.h"
+#include "motion_trigger.h"
 #include "pir_sensor.h"
 #include "fish_api.h"
+#include "i2c_bus.h"
+#include "motor_profile.h"
+#include "ph_history.h"
+#include "ph_sampler.h"
 #include "ph_sensor.h"
+#include "worker_pool.h"
 #include <memory>
 
 /**
  * Main system class that connects all components
  */
-class FishMonitoringSystem : public PirSensor::MotionCallbackInterface,
-                             public PHSensor::PHSensorCallbackInterface {
+class FishMonitoringSystem {
 public:
     FishMonitoringSystem();
     ~FishMonitoringSystem();
@@ -21,24 +33,46 @@ public:
     // Start the system
     void start();
     
+    // Run the event loop until SIGINT/SIGTERM or Enter on stdin
+    void run();
+    
     // Stop the system
     void stop();
     
-    // Motion detected callback ( MotionCallbackInterface)
-    void motionDetected(gpiod_line_event e) override;
-    // pH sample callback ( PHSensorCallbackInterface)
-    void onPHSample(float pH, float voltage, int16_t adcValue) override;
+    // Trigger event (PIR, camera motion or both), starts a capture-detect-feed flow
+    void motionDetected(const MotionTrigger::TriggerEvent& event);
+    // pH sample event
+    void onPHSample(float pH, float voltage, int16_t adcValue);
+    // pH left or re-entered the safe band
+    void onPHAlarm(const PHSensor::AlarmEvent& event);
     
 private:
     void clearArchive();
     
+    // Declared first so they outlive every component registered with them
+    std::unique_ptr<EventLoop> m_loop;
+    std::unique_ptr<WorkerPool> m_pool;
+    std::unique_ptr<EventBus> m_bus;
+    
+    std::unique_ptr<MotorProfileLibrary> m_profiles;
     std::unique_ptr<PirSensor> m_pirSensor;
     std::unique_ptr<Camera> m_camera;
+    std::unique_ptr<VideoMotionDetector> m_videoMotion;
+    std::unique_ptr<MotionTrigger> m_trigger;
     std::unique_ptr<ImageProcessor> m_imageProcessor;
     std::unique_ptr<Feeder> m_feeder;
-    std::unique_ptr<FishAPI> m_api;
+    std::unique_ptr<FramePipeline> m_pipeline;
+    std::unique_ptr<CaptureAdmission> m_capture;
+    std::unique_ptr<FeedScheduler> m_scheduler; // Before the flow, which hands it detections
+    std::unique_ptr<FeedFlow> m_flow;
+    std::unique_ptr<Ads1115Emulator> m_phEmulator; // Outlives the bus it is attached to
+    std::unique_ptr<I2cBus> m_i2cBus;
     std::unique_ptr<PHSensor> m_phSensor;
+    std::unique_ptr<PHHistory> m_phHistory;
+    std::unique_ptr<PHSampler> m_phSampler;
+    std::unique_ptr<FishAPI> m_api;
 
+    Subscriptions m_subscriptions;
 };
 
 #endif 
@@ -0,0 +1,219 @@
+#ifndef FLOW_H
+#define FLOW_H
+
+#include "event_loop.h"
+#include "worker_pool.h"
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+
+/**
+ * Cancellation shared by every step of one flow
+ */
+class Cancellation {
+public:
+    Cancellation() : m_cancelled(false), m_nextId(0) {}
+
+    // Runs the registered callbacks once, on the calling thread
+    void cancel();
+    bool isCancelled() const { return m_cancelled; }
+
+    /**
+     * @return Id for remove(), -1 if already cancelled (the callback ran)
+     */
+    int onCancel(std::function<void()> callback);
+    void remove(int id);
+
+private:
+    std::atomic<bool> m_cancelled;
+    std::mutex m_mutex;
+    std::map<int, std::function<void()>> m_callbacks;
+    int m_nextId;
+};
+
+enum class StepStatus {
+    Ok,
+    Failed,
+    TimedOut,
+    Cancelled
+};
+
+const char* stepStatusName(StepStatus status);
+
+template <typename T>
+struct StepResult {
+    StepStatus status;
+    T value;
+
+    bool ok() const { return status == StepStatus::Ok; }
+};
+
+/**
+ * Where a flow's steps run: timers on the loop, resumption on the pool
+ */
+struct FlowContext {
+    EventLoop& loop;
+    WorkerPool& pool;
+    WorkerPool::Lane lane;
+    std::shared_ptr<Cancellation> cancellation;
+};
+
+/**
+ * Detached coroutine, created suspended and resumed on the worker pool by
+ * start(). Its frame is freed when it returns, so it holds no thread while it
+ * waits on a step.
+ */
+class Flow {
+public:
+    struct promise_type {
+        Flow get_return_object() { return Flow(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::cerr << "Unhandled exception in flow" << std::endl; }
+    };
+
+    Flow(Flow&& other) noexcept : m_handle(other.m_handle) { other.m_handle = nullptr; }
+    Flow(const Flow&) = delete;
+    Flow& operator=(const Flow&) = delete;
+
+    ~Flow() {
+        if (m_handle) {
+            m_handle.destroy(); // Never started
+        }
+    }
+
+    /**
+     * Run the body on the pool, inline if the pool is stopping
+     */
+    void start(WorkerPool& pool, WorkerPool::Lane lane) {
+        std::coroutine_handle<promise_type> handle = m_handle;
+        m_handle = nullptr;
+        if (!pool.submit([handle]() { handle.resume(); }, lane)) {
+            handle.resume();
+        }
+    }
+
+private:
+    explicit Flow(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+/**
+ * Awaitable asynchronous step with a deadline
+ *
+ * Races the operation against a loop timer and the flow's cancellation, the
+ * first to finish wins and the coroutine resumes on the pool. A step that
+ * lost keeps running until it notices `abandoned` (or finishes anyway), its
+ * result is discarded.
+ */
+template <typename T>
+class Step {
+public:
+    // Call once from any thread
+    using Complete = std::function<void(bool ok, T value)>;
+    using Start = std::function<void(Complete complete, const std::atomic<bool>& abandoned)>;
+
+    /**
+     * @param deadlineNs Time allowed for the step, 0 for none
+     */
+    Step(const FlowContext& context, int64_t deadlineNs, Start start)
+        : m_state(std::make_shared<State>(context)),
+          m_deadlineNs(deadlineNs),
+          m_start(std::move(start)) {}
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> handle);
+    StepResult<T> await_resume() { return {m_state->status, std::move(m_state->value)}; }
+
+private:
+    struct State {
+        explicit State(const FlowContext& context) : context(context) {}
+
+        FlowContext context;
+        std::coroutine_handle<> handle;
+        std::atomic<bool> finished{false};
+        std::atomic<bool> abandoned{false};
+        // Setup and the finish both count down, the last one resumes, so
+        // the coroutine never runs while await_suspend is still registering
+        std::atomic<int> gate{2};
+        StepStatus status = StepStatus::Ok;
+        T value{};
+        int timer = -1;
+        int cancelId = -1;
+    };
+
+    static void finish(const std::shared_ptr<State>& state, StepStatus status, T value);
+    static void cleanup(State& state);
+    static void resume(const std::shared_ptr<State>& state);
+
+    std::shared_ptr<State> m_state;
+    int64_t m_deadlineNs;
+    Start m_start;
+};
+
+template <typename T>
+bool Step<T>::await_suspend(std::coroutine_handle<> handle) {
+    // Once started the coroutine may resume and free this awaiter at any time,
+    // only the locals are used from there on
+    std::shared_ptr<State> state = m_state;
+    Start start = std::move(m_start);
+    state->handle = handle;
+
+    if (m_deadlineNs > 0) {
+        state->timer = state->context.loop.addTimer([state]() { finish(state, StepStatus::TimedOut, T{}); });
+        if (state->timer >= 0) {
+            state->context.loop.armTimer(state->timer, m_deadlineNs);
+        }
+    }
+    state->cancelId = state->context.cancellation->onCancel([state]() {
+        finish(state, StepStatus::Cancelled, T{});
+    });
+    if (!state->finished) {
+        start([state](bool ok, T value) { finish(state, ok ? StepStatus::Ok : StepStatus::Failed, std::move(value)); },
+              state->abandoned);
+    }
+
+    if (--state->gate == 0) {
+        cleanup(*state);
+        return false; // Already finished, carry on inline
+    }
+    return true;
+}
+
+template <typename T>
+void Step<T>::finish(const std::shared_ptr<State>& state, StepStatus status, T value) {
+    if (state->finished.exchange(true)) {
+        return;
+    }
+    state->status = status;
+    state->value = std::move(value);
+    state->abandoned = (status == StepStatus::TimedOut || status == StepStatus::Cancelled);
+    if (--state->gate == 0) {
+        resume(state);
+    }
+}
+
+template <typename T>
+void Step<T>::cleanup(State& state) {
+    state.context.loop.removeTimer(state.timer);
+    state.timer = -1;
+    state.context.cancellation->remove(state.cancelId);
+}
+
+template <typename T>
+void Step<T>::resume(const std::shared_ptr<State>& state) {
+    cleanup(*state);
+    std::coroutine_handle<> handle = state->handle;
+    if (!state->context.pool.submit([handle]() { handle.resume(); }, state->context.lane)) {
+        handle.resume();
+    }
+}
+
+#endif
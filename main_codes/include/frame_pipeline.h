@@ -0,0 +1,145 @@
+#ifndef FRAME_PIPELINE_H
+#define FRAME_PIPELINE_H
+
+#include "camera.h"
+#include "feeder.h"
+#include "image_processor.h"
+#include "spsc_ring.h"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Ring sizes between the pipeline stages, loaded from config/pipeline.json
+ */
+struct FramePipelineConfig {
+    int decodeQueue = 2;  // Captured files waiting for imread
+    int detectQueue = 2;  // Decoded images waiting for detection
+    int archiveQueue = 8; // Detections waiting to be written
+
+    bool load(const std::string& path);
+};
+
+/**
+ * Capture, decode, detect and archive as separate stages
+ *
+ * Capture runs on the caller (the admission controller's pool job), the other
+ * stages on a thread each, joined by SpscRing. Capture of frame N+1 overlaps
+ * detection of frame N and archiving of frame N-1. A full ring drops its
+ * oldest frame, whose waiters fail, so a slow stage sheds stale frames
+ * instead of holding up the camera.
+ */
+class FramePipeline {
+public:
+    // Called on the decode thread once the frame's image is ready
+    using CaptureCallback = std::function<void(bool ok, uint64_t frame)>;
+    // Called on the detect thread, or at once if the frame is already done
+    using DetectCallback = std::function<void(bool ok, const ImageProcessor::DetectionEvent& event)>;
+
+    struct StageStats {
+        const char* name;
+        size_t queued;   // Waiting in the ring in front of the stage
+        size_t capacity;
+        size_t peak;     // Highest queued since start
+        uint64_t processed;
+        uint64_t dropped; // Pushed out of a full ring
+        uint64_t failed;
+        double utilisation; // Share of the stage's time spent working
+        double avgMs;
+    };
+
+    FramePipeline(Camera& camera, ImageProcessor& processor, Feeder& feeder,
+                  const FramePipelineConfig& config = FramePipelineConfig());
+    ~FramePipeline();
+    FramePipeline(const FramePipeline&) = delete;
+    FramePipeline& operator=(const FramePipeline&) = delete;
+
+    /**
+     * Capture stage: take one image and hand it to decode, blocks for
+     * libcamera-still. One caller at a time.
+     */
+    void capture(std::vector<CaptureCallback> waiters);
+
+    // Result of a frame's detection, any thread
+    void awaitDetection(uint64_t frame, DetectCallback done);
+
+    // Drain the rings and join the stage threads
+    void stop();
+
+    std::vector<StageStats> stats() const;
+
+private:
+    enum Stage {
+        CAPTURE,
+        DECODE,
+        DETECT,
+        ARCHIVE,
+        STAGES
+    };
+
+    struct Frame {
+        uint64_t id = 0;
+        std::string path;
+        cv::Mat image;
+        std::vector<CaptureCallback> waiters;
+    };
+
+    struct Detected {
+        uint64_t id = 0;
+        ImageProcessor::DetectionEvent event;
+    };
+
+    struct Result {
+        uint64_t id;
+        bool ok;
+        ImageProcessor::DetectionEvent event;
+    };
+
+    struct StageCounters {
+        std::atomic<uint64_t> processed{0};
+        std::atomic<uint64_t> dropped{0};
+        std::atomic<uint64_t> failed{0};
+        std::atomic<int64_t> busyNs{0};
+        std::atomic<size_t> peak{0};
+    };
+
+    void decodeStage();
+    void detectStage();
+    void archiveStage();
+
+    void failCapture(Frame& frame);
+    // Hand a frame's detection to its waiters
+    void resolve(uint64_t frame, bool ok, const ImageProcessor::DetectionEvent& event);
+    void record(Stage stage, int64_t startNs, bool ok);
+    void updatePeak(Stage stage, size_t queued);
+
+    Camera& m_camera;
+    ImageProcessor& m_processor;
+    Feeder& m_feeder;
+    int64_t m_startNs;
+    std::atomic<uint64_t> m_nextFrame;
+
+    SpscRing<Frame> m_decodeRing;
+    SpscRing<Frame> m_detectRing;
+    SpscRing<Detected> m_archiveRing;
+    StageCounters m_stages[STAGES];
+
+    // Frames between capture and detection with their waiters, and recent
+    // results for waiters that come late
+    mutable std::mutex m_mutex;
+    std::map<uint64_t, std::vector<DetectCallback>> m_inFlight;
+    std::deque<Result> m_recent;
+
+    std::thread m_decodeThread;
+    std::thread m_detectThread;
+    std::thread m_archiveThread;
+    std::once_flag m_stopped;
+};
+
+#endif
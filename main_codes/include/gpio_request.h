@@ -0,0 +1,63 @@
+#ifndef GPIO_REQUEST_H
+#define GPIO_REQUEST_H
+
+#include <gpiod.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Helpers around libgpiod v2 line requests
+ */
+namespace gpio {
+
+struct LineSettings {
+    bool output = false;
+    int initialValue = 0;                 // Outputs only
+    bool bothEdges = false;               // Inputs only, report rising and falling edges
+    bool fallingEdge = false;             // Inputs only, report falling edges
+    unsigned long debounceUs = 0;         // Kernel debounce period, 0 for none
+    gpiod_line_clock eventClock = GPIOD_LINE_CLOCK_MONOTONIC;
+    size_t eventBufferSize = 0;           // Kernel event queue size, 0 for the default
+};
+
+/**
+ * Path of a chip by number, e.g. 0 -> /dev/gpiochip0
+ */
+std::string chipPath(int chipNumber);
+
+/**
+ * Request lines with the same settings, in the order given
+ * @return The request (the chip is closed again), nullptr on failure
+ */
+gpiod_line_request* requestLines(const std::string& chipPath, const std::vector<unsigned int>& offsets,
+                                 const LineSettings& settings, const char* consumer);
+
+/**
+ * eventfd used to wake a thread blocked on a line request
+ */
+class Wakeup {
+public:
+    Wakeup();
+    ~Wakeup();
+    Wakeup(const Wakeup&) = delete;
+    Wakeup& operator=(const Wakeup&) = delete;
+
+    void signal();
+    void clear();
+    int fd() const { return m_fd; }
+
+private:
+    int m_fd;
+};
+
+/**
+ * Wait for edge events or a wakeup
+ * @param timeoutNs Negative to wait without timeout
+ * @return 1 if events are ready, 0 on timeout or wakeup, -1 on error
+ */
+int waitEdgeEvents(gpiod_line_request* request, const Wakeup& wakeup, int64_t timeoutNs);
+
+} // namespace gpio
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * I2C bus settings, loaded from config/i2c.json
+ */
+struct I2cBusConfig {
+    std::string device = "/dev/i2c-1"; // "emulated" for no adapter, only attached devices answer
+    int retries = 3;       // Further attempts after a NAK or timeout
+    int backoffUs = 200;   // Before the first retry, doubled for each one after
+
+    bool load(const std::string& path);
+};
+
+/**
+ * A device that answers on the bus in userspace rather than on the wire
+ */
+class I2cDevice {
+public:
+    virtual ~I2cDevice() = default;
+
+    // One combined transaction: write out, then read in after a repeated start.
+    // False is a NAK, with errno set as the adapter would.
+    virtual bool transfer(const uint8_t* out, size_t outLength, uint8_t* in, size_t inLength) = 0;
+};
+
+/**
+ * One I2C bus shared by every device on it
+ *
+ * Transactions from all callers are serialised, and each is a single
+ * I2C_RDWR ioctl, so a register pointer write and the read that follows go
+ * out with a repeated start and can't be split by another caller. NAKs and
+ * timeouts are retried with exponential backoff. Latency and failures are
+ * kept per device address. An attached I2cDevice takes the place of the
+ * hardware at its address, with the same locking, retries and stats.
+ */
+class I2cBus {
+public:
+    struct DeviceStats {
+        uint8_t address;
+        uint64_t transactions;
+        uint64_t retries;
+        uint64_t failures;    // Still failing after the last retry
+        double avgUs;
+        double maxUs;
+    };
+
+    explicit I2cBus(const I2cBusConfig& config = I2cBusConfig());
+    ~I2cBus();
+    I2cBus(const I2cBus&) = delete;
+    I2cBus& operator=(const I2cBus&) = delete;
+
+    // Open the adapter if it isn't already
+    bool open();
+    void close();
+    bool isOpen() const;
+
+    // Answer transfers to address from device, nullptr detaches. Not owned.
+    void attach(uint8_t address, I2cDevice* device);
+
+    // 16-bit big-endian register access, the layout of ADS1x15-style devices
+    bool writeRegister(uint8_t address, uint8_t reg, uint16_t value);
+    bool readRegister(uint8_t address, uint8_t reg, uint16_t& value);
+
+    // Raw transfers: write, read, or write then read with a repeated start
+    bool write(uint8_t address, const uint8_t* data, size_t length);
+    bool read(uint8_t address, uint8_t* data, size_t length);
+    bool writeRead(uint8_t address, const uint8_t* out, size_t outLength, uint8_t* in, size_t inLength);
+
+    const std::string& device() const { return m_config.device; }
+    std::vector<DeviceStats> stats() const;
+
+private:
+    struct Counters {
+        uint64_t transactions = 0;
+        uint64_t retries = 0;
+        uint64_t failures = 0;
+        int64_t totalNs = 0;
+        int64_t maxNs = 0;
+    };
+
+    // One ioctl, or one call to an attached device, per attempt. Called with m_mutex held.
+    bool transfer(uint8_t address, const uint8_t* out, size_t outLength, uint8_t* in, size_t inLength);
+
+    I2cBusConfig m_config;
+    mutable std::mutex m_mutex;
+    int m_fd;
+    bool m_emulated; // Opened without an adapter
+    std::map<uint8_t, I2cDevice*> m_devices;
+    std::map<uint8_t, Counters> m_counters;
+};
+
+#endif
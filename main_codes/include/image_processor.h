@@ -2,33 +2,41 @@
 #define IMAGE_PROCESSOR_H
 
 #include "camera.h"
+#include "event_bus.h"
 #include <opencv2/opencv.hpp>
-#include <vector>
+#include <string>
 
 /**
  * Image processor class that detects fish in images
+ *
+ * Takes images from a camera topic on the worker pool, or directly through
+ * process(), and publishes the result on a detection topic.
  */
-class ImageProcessor : public Camera::ImageCallbackInterface {
+class ImageProcessor {
 public:
-    // Interface for fish detection callbacks
-    struct FishDetectionCallbackInterface {
-        virtual void fishDetected(const cv::Mat& image) = 0;
-        virtual void noFishDetected(const cv::Mat& image) = 0;
+    struct DetectionEvent {
+        bool fishDetected;
+        cv::Mat image; // Annotated
     };
     
-    ImageProcessor();
+    /**
+     * @param imageTopic Camera topic to subscribe to, empty when driven by process()
+     */
+    ImageProcessor(EventBus& bus, const std::string& imageTopic = "image",
+                   const std::string& detectionTopic = "detection");
     
-    // Register callback for fish detection 
-    void registerCallback(FishDetectionCallbackInterface* callback);
+    // Run detection on one image, publish and return the result
+    DetectionEvent process(const cv::Mat& image);
     
-    // Implementation of Camera callback
-    void imageReady(const cv::Mat& image) override;
+    // Camera topic subscriber
+    void imageReady(const cv::Mat& image);
     
 private:
     // Fish detection algorithm
     bool detectFish(cv::Mat& image);
     
-    std::vector<FishDetectionCallbackInterface*> m_callbacks;
+    Topic<DetectionEvent>& m_detectionTopic;
+    Subscriptions m_subscriptions;
 };
 
 #endif 
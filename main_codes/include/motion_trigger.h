@@ -0,0 +1,101 @@
+#ifndef MOTION_TRIGGER_H
+#define MOTION_TRIGGER_H
+
+#include "event_bus.h"
+#include "pir_sensor.h"
+#include "video_motion.h"
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+/**
+ * Trigger source settings, loaded from config/trigger.json
+ */
+struct MotionTriggerConfig {
+    std::string mode = "pir";
+    int fuseWindowMs = 2000; // fused: how far apart the two reports may be
+
+    bool load(const std::string& path);
+};
+
+/**
+ * Picks what starts a capture: the PIR sensor, camera motion or both
+ *
+ * Listens to "motion" and "video_motion" and publishes on "trigger". In
+ * fused mode a report only triggers if the other source reported within the
+ * window, so warm-tank misses and room movement seen through the glass
+ * need the camera to agree. The video detector runs only while its mode
+ * needs it.
+ */
+class MotionTrigger {
+public:
+    enum class Mode {
+        Pir,
+        Camera,
+        Fused
+    };
+
+    enum class Source {
+        Pir,
+        Camera,
+        Fused
+    };
+
+    struct TriggerEvent {
+        uint64_t timestampNs; // CLOCK_MONOTONIC
+        Source source;
+    };
+
+    struct Stats {
+        Mode mode;
+        uint64_t pirReports;
+        uint64_t videoReports;
+        uint64_t triggers;
+        uint64_t unconfirmed; // fused: reports the other source didn't back
+        uint64_t ignored;     // Reports from a source the mode doesn't use
+    };
+
+    MotionTrigger(EventBus& bus, VideoMotionDetector& video,
+                  const MotionTriggerConfig& config = MotionTriggerConfig());
+    ~MotionTrigger();
+    MotionTrigger(const MotionTrigger&) = delete;
+    MotionTrigger& operator=(const MotionTrigger&) = delete;
+
+    // Start the video detector if the mode uses it
+    void start();
+    void stop();
+
+    void setMode(Mode mode);
+    Mode mode() const;
+
+    VideoMotionDetector& video() { return m_video; }
+    Stats stats() const;
+
+    static const char* modeName(Mode mode);
+    static const char* sourceName(Source source);
+    static bool parseMode(const std::string& name, Mode& mode);
+
+private:
+    // Event bus subscribers, inline on the PIR loop and the video thread
+    void pirMotion();
+    void videoMotion();
+
+    // Called with m_mutex held, the event is published after unlocking
+    bool report(Source source, TriggerEvent& event);
+
+    VideoMotionDetector& m_video;
+    Topic<TriggerEvent>& m_triggerTopic;
+    int64_t m_fuseWindowNs;
+
+    mutable std::mutex m_mutex;
+    Mode m_mode;
+    bool m_running;
+    int64_t m_lastPirNs;   // Unmatched report awaiting the other source, 0 if none
+    int64_t m_lastVideoNs;
+    Stats m_stats;
+
+    // Last member, cancelled before anything a handler touches is destroyed
+    Subscriptions m_subscriptions;
+};
+
+#endif
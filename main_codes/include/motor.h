@@ -1,16 +1,25 @@
 #ifndef MOTOR_H
 #define MOTOR_H
 
+#include "gpio_request.h"
+#include "motor_profile.h"
+#include <chrono>
 #include <gpiod.h>
+#include <vector>
 
 /**
  * Motor control class using software PWM on GPIO
  */
 class Motor {
 public:
+    // Interface for observing the output waveform (every line write)
+    struct EdgeCallbackInterface {
+        virtual void motorEdge(int value, std::chrono::steady_clock::time_point t) = 0;
+    };
+
     /**
      * @param motorPin The GPIO pin number connected to the motor controller
-     * @param  Path to the GPIO chip 
+     * @param chipPath Path to the GPIO chip, nullptr for a simulated line
      */
     Motor(int motorPin = 4, const char* chipPath = "/dev/gpiochip0");
     
@@ -25,6 +34,13 @@ public:
      */
     bool run(int dutyCycle, int periodMs, int durationMs);
     
+    /**
+     * Play a precomputed edge timeline using absolute deadline sleeps
+     * @param timeline Compiled profile from MotorProfileLibrary
+     * @return true if successful, false if GPIO not initialized
+     */
+    bool play(const EdgeTimeline& timeline);
+    
     /**
      * Stop the motor immediately
      */
@@ -36,11 +52,23 @@ public:
      */
     bool isInitialized() const { return m_gpioInitialized; }
 
+    /**
+     * True if the motor drives a simulated line instead of real GPIO
+     */
+    bool isSimulated() const { return m_simulated; }
+
+    // Register callback for line writes
+    void registerCallback(EdgeCallbackInterface* callback);
+
 private:
+    // Write the motor line and notify edge callbacks
+    void setLine(int value);
+
     int m_motorPin;
-    gpiod_chip* m_chip;
-    gpiod_line* m_motorLine;
+    gpiod_line_request* m_request;
     bool m_gpioInitialized;
+    bool m_simulated;
+    std::vector<EdgeCallbackInterface*> m_callbacks;
 };
 
 #endif 
@@ -0,0 +1,75 @@
+#ifndef MOTOR_PROFILE_H
+#define MOTOR_PROFILE_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * One line level change at a fixed offset from the start of playback
+ */
+struct MotorEdge {
+    int64_t atNs;
+    int value;
+};
+
+/**
+ * Precomputed edge timeline, playback drives the line low at durationNs
+ */
+struct EdgeTimeline {
+    std::vector<MotorEdge> edges;
+    int64_t durationNs = 0;
+};
+
+/**
+ * A constant duty cycle segment of a feed profile
+ */
+struct MotorProfileStep {
+    int dutyCycle;
+    int periodMs;
+    int durationMs;
+};
+
+/**
+ * Named feed profiles compiled once into edge timelines
+ */
+class MotorProfileLibrary {
+public:
+    // Built-in profiles, used when no config file is loaded
+    MotorProfileLibrary();
+
+    /**
+     * Load profiles from a JSON config, replacing built-ins of the same name
+     * @param path Path to the profile config
+     * @return true if the file was read and every profile compiled
+     */
+    bool load(const std::string& path);
+
+    /**
+     * Look up a compiled profile
+     * @param name Profile name, empty for the default profile
+     * @return timeline or nullptr if no profile has that name
+     */
+    const EdgeTimeline* timeline(const std::string& name) const;
+
+    const std::string& defaultProfile() const { return m_defaultProfile; }
+    std::vector<std::string> names() const;
+
+    /**
+     * Compile duty cycle steps into an edge timeline
+     */
+    static EdgeTimeline compile(const std::vector<MotorProfileStep>& steps);
+
+private:
+    std::map<std::string, EdgeTimeline> m_timelines;
+    std::string m_defaultProfile;
+};
+
+/**
+ * CLOCK_MONOTONIC helpers shared by the timeline players
+ */
+int64_t monotonicNowNs();
+void sleepUntilNs(int64_t deadlineNs);
+
+#endif
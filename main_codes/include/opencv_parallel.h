@@ -0,0 +1,49 @@
+#ifndef OPENCV_PARALLEL_H
+#define OPENCV_PARALLEL_H
+
+#include "worker_pool.h"
+#include <opencv2/opencv.hpp>
+
+#if __has_include(<opencv2/core/parallel/parallel_backend.hpp>)
+#include <opencv2/core/parallel/parallel_backend.hpp>
+#define HAVE_OPENCV_PARALLEL_BACKEND 1
+#endif
+
+#ifdef HAVE_OPENCV_PARALLEL_BACKEND
+/**
+ * cv::parallel_for_ backend on the shared worker pool
+ *
+ * Loop chunks run as jobs on the caller's lane and the caller works through
+ * them too, so a loop started from a pool job can't deadlock waiting on busy
+ * workers and OpenCV never starts threads of its own.
+ */
+class PoolParallelBackend : public cv::parallel::ParallelForAPI {
+public:
+    explicit PoolParallelBackend(WorkerPool& pool) : m_pool(pool) {}
+
+    void parallel_for(int tasks, cv::parallel::FN_parallel_for_body_cb_t body, void* data) override;
+
+    // Workers are 1..n, any other thread (the caller) is 0
+    int getThreadNum() const override;
+    int getNumThreads() const override;
+
+    // The pool is sized once at startup, requests are ignored
+    int setNumThreads(int threads) override;
+
+    const char* getName() const override { return "worker_pool"; }
+
+private:
+    WorkerPool& m_pool;
+};
+#endif
+
+/**
+ * Route OpenCV's parallel loops to the pool, older OpenCV without pluggable
+ * backends runs them on the calling thread instead of its own thread pool
+ */
+void installOpenCVBackend(WorkerPool& pool);
+
+// Back to OpenCV's built-in backend, call before the pool is destroyed
+void removeOpenCVBackend();
+
+#endif
@@ -0,0 +1,152 @@
+#ifndef PH_HISTORY_H
+#define PH_HISTORY_H
+
+#include "event_bus.h"
+#include "ph_sensor.h"
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * pH history settings, loaded from config/ph_history.json
+ */
+struct PHHistoryConfig {
+    std::string path = "../data/ph_history.bin";
+    int rawRecords = 60480; // A week of readings at one per 10 s
+    int minuteDays = 31;    // Retention of each rollup
+    int hourDays = 400;
+    int dayDays = 3650;
+    int syncIntervalMs = 60000; // Between writebacks of dirty pages to the card
+
+    bool load(const std::string& path);
+};
+
+/**
+ * pH time series in one memory-mapped file
+ *
+ * Every reading on the "ph" topic is appended to a ring of fixed-size
+ * records, and min/max/mean rollups at 1 min, 1 h and 1 day are updated in
+ * place as it arrives. Each ring overwrites its oldest record, so the file
+ * never grows past the size set by the retention. The file is allocated
+ * once and only the tail pages of each ring are dirtied, which the kernel
+ * writes back in batches. Every syncIntervalMs an append starts writeback
+ * of those pages without waiting for it. Queries binary-search a
+ * ring and copy out the range.
+ */
+class PHHistory {
+public:
+    enum class Resolution {
+        Raw,
+        Minute,
+        Hour,
+        Day
+    };
+    static const size_t RESOLUTIONS = 4;
+
+    struct Point {
+        int64_t time; // Unix seconds, bucket start for rollups
+        float min;
+        float max;
+        float mean;
+        uint32_t count;
+    };
+
+    struct Stats {
+        bool open;
+        uint64_t appended;
+        uint64_t outOfOrder; // Older than the newest bucket, kept raw only
+        uint64_t syncs;
+        uint64_t queries;
+        uint64_t fileBytes;
+        uint64_t records[RESOLUTIONS]; // Currently held per resolution
+    };
+
+    PHHistory(EventBus& bus, const PHHistoryConfig& config = PHHistoryConfig());
+    ~PHHistory();
+    PHHistory(const PHHistory&) = delete;
+    PHHistory& operator=(const PHHistory&) = delete;
+
+    bool isOpen() const { return m_base != nullptr; }
+
+    // Append one reading, timeMs is wall clock
+    void append(int64_t timeMs, const PHSensor::Sample& sample);
+
+    /**
+     * Points with from <= time <= to, oldest first
+     * @param from Unix seconds
+     * @param to Unix seconds
+     */
+    std::vector<Point> query(Resolution resolution, int64_t from, int64_t to) const;
+
+    // Finest resolution that still covers from and needs at most maxPoints
+    Resolution resolutionFor(int64_t from, int64_t to, size_t maxPoints) const;
+
+    // Write dirty pages back now and wait for them
+    void sync();
+
+    Stats stats() const;
+
+    static const char* resolutionName(Resolution resolution);
+    static bool parseResolution(const std::string& name, Resolution& resolution);
+
+private:
+    // On-disk layout, native endian, the header has a page to itself
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t capacity[RESOLUTIONS];
+        uint64_t written[RESOLUTIONS]; // Records ever written, the next goes to written % capacity
+    };
+
+    struct RawRecord {
+        int64_t timeMs;
+        float pH;
+        float voltage;
+        int16_t adcValue;
+        int16_t reserved[3];
+    };
+
+    struct RollupRecord {
+        int64_t start; // Unix seconds
+        uint32_t count;
+        float min;
+        float max;
+        float reserved;
+        double sum;
+    };
+
+    bool open();
+    void close();
+
+    // Start writing dirty pages back, from append without waiting for the card
+    void writeBack();
+
+    size_t count(Resolution resolution) const;
+    // Logical index 0 is the oldest record held
+    int64_t timeAt(Resolution resolution, size_t index) const;
+    Point pointAt(Resolution resolution, size_t index) const;
+    size_t lowerBound(Resolution resolution, int64_t time) const;
+    // Fold into the newest bucket or start one, false if time is before the newest
+    bool roll(Resolution resolution, int64_t time, float pH);
+
+    PHHistoryConfig m_config;
+
+    mutable std::mutex m_mutex;
+    int m_fd;
+    unsigned char* m_base;
+    size_t m_size;
+    FileHeader* m_header;
+    size_t m_offsets[RESOLUTIONS];
+    int64_t m_lastSyncNs;
+    uint64_t m_appended;
+    uint64_t m_outOfOrder;
+    uint64_t m_syncs;
+    mutable uint64_t m_queries;
+
+    // Last member, cancelled before anything a handler touches is destroyed
+    Subscriptions m_subscriptions;
+};
+
+#endif
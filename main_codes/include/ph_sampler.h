@@ -0,0 +1,159 @@
+#ifndef PH_SAMPLER_H
+#define PH_SAMPLER_H
+
+#include "event_bus.h"
+#include "event_loop.h"
+#include "feeder_bank.h"
+#include "ph_sensor.h"
+#include "seqlock.h"
+#include "worker_pool.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * pH sampling settings, loaded from config/ph_sampler.json
+ */
+struct PHSamplerConfig {
+    int intervalMs = 10000; // Between bursts, the first interval when adaptive
+    int burst = 9;          // Sensor reads filtered into one reading
+    double hampelK = 3.0;   // Outlier beyond this many scaled MADs from the median, at least 1
+    int maxAgeMs = 15000;   // Older readings are refreshed on demand
+
+    // Adaptive interval: backs off while pH is flat, drops to the minimum on a change or a feed
+    bool adaptive = true;
+    int minIntervalMs = 2000;
+    int maxIntervalMs = 300000;
+    double backoff = 2.0;      // Interval multiplier per flat reading, at least 1
+    double changePH = 0.05;    // A smaller change, or one within the readings' noise, is flat
+    int feedBoostMs = 900000;  // Minimum interval for this long after the feeders stop
+
+    bool load(const std::string& path);
+};
+
+/**
+ * Background pH sampling, the only code that reads the sensor
+ *
+ * On a fixed cadence a burst of reads runs on the pool's analytics lane. A
+ * Hampel filter drops reads too far from the burst's median (air bubbles,
+ * pump noise) and the rest are averaged into one reading, which is
+ * published on the "ph" topic and kept in a seqlock. API requests read that
+ * copy without locking or touching I2C. A request for a stale reading
+ * starts a burst, and requests while one runs share it.
+ *
+ * When adaptive, each flat reading multiplies the interval by the backoff
+ * up to the maximum. A change beyond the noise, or a feed on the "feed"
+ * topic, drops it to the minimum, and it stays there for a while after a
+ * feed to catch the dip as food breaks down. A reading counts as fresh
+ * until the next scheduled burst, so backing off also saves the bursts
+ * on-demand reads would start.
+ */
+class PHSampler {
+public:
+    struct Reading {
+        bool valid;          // false before the first burst
+        float pH;
+        float voltage;
+        int16_t adcValue;
+        int64_t timestampNs; // CLOCK_MONOTONIC
+        std::time_t time;
+        uint32_t samples;    // Reads kept by the filter
+        uint32_t outliers;   // Reads dropped by the filter
+        float noise;         // Standard error of the mean, pH
+    };
+
+    // Called with the refreshed reading, or the last one if the burst failed
+    using Callback = std::function<void(const Reading& reading)>;
+
+    struct Stats {
+        uint64_t bursts;
+        uint64_t failures;    // Bursts without a single read
+        uint64_t samples;
+        uint64_t outliers;
+        uint64_t cached;      // Requests served from a fresh reading
+        uint64_t refreshes;   // Requests that started a burst
+        uint64_t collapsed;   // Requests that joined a running burst
+        double avgBurstMs;
+        double ageMs;         // Of the latest reading, -1 if none
+        int intervalMs;       // Until the next scheduled burst
+        bool boosted;         // At the minimum after a feed
+        uint64_t boosts;      // Feeds seen
+        uint64_t changes;     // Readings that moved beyond the noise
+        double dutyPercent;   // Time spent in bursts since start
+        uint64_t samplesSaved; // Sensor reads skipped against sampling at the minimum interval
+    };
+
+    PHSampler(EventLoop& loop, WorkerPool& pool, PHSensor& sensor, EventBus& bus,
+              const PHSamplerConfig& config = PHSamplerConfig());
+    ~PHSampler();
+    PHSampler(const PHSampler&) = delete;
+    PHSampler& operator=(const PHSampler&) = delete;
+
+    // Arm the cadence timer and take the first reading
+    void start();
+
+    // Disarm the timer and wait for a running burst
+    void stop();
+
+    // Lock-free copy of the latest reading
+    Reading latest() const { return m_latest.load(); }
+    bool isFresh(const Reading& reading) const;
+
+    // Serve a fresh reading, refreshing it first if it is stale
+    void read(Callback done);
+
+    // Refresh a stale reading without waiting for it
+    void refresh();
+
+    Stats stats() const;
+
+private:
+    // Timer: start a burst unless one is running
+    void scheduled();
+
+    // Feed seen on the "feed" topic
+    void fed(const FeederBank::FeedEvent& event);
+
+    // Next interval after a reading, called with m_mutex held
+    void adapt(const Reading& previous, const Reading& reading);
+    // Reschedule the timer at the current interval, called with m_mutex held
+    void rearm();
+
+    // Burst, filter and publish on the worker pool
+    void burst();
+
+    // Hampel filter over the burst, false if no read survived
+    bool filter(const std::vector<PHSensor::Sample>& samples, Reading& reading) const;
+
+    EventLoop& m_loop;
+    WorkerPool& m_pool;
+    PHSensor& m_sensor;
+    Topic<PHSensor::Sample>& m_sampleTopic;
+    PHSamplerConfig m_config;
+    int m_timer;
+
+    SeqLock<Reading> m_latest;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_idle;
+    bool m_busy;
+    bool m_running;
+    std::vector<Callback> m_waiters; // Requests served by the running burst
+    Stats m_stats;
+    int64_t m_totalBurstNs;
+    uint64_t m_reads;        // Sensor reads attempted
+    int64_t m_startNs;
+    int m_intervalMs;
+    int64_t m_boostUntilNs;
+    std::atomic<int> m_freshMs; // Age limit of a fresh reading, read without the lock
+
+    // Last member, cancelled before anything a handler touches is destroyed
+    Subscriptions m_subscriptions;
+};
+
+#endif
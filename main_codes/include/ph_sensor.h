@@ -1,33 +1,196 @@
 #ifndef PH_SENSOR_H
 #define PH_SENSOR_H
 
-#include <vector>
+#include "event_bus.h"
+#include "gpio_request.h"
+#include "i2c_bus.h"
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <ctime>
+#include <gpiod.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * pH probe ADC settings, loaded from config/ph.json
+ */
+struct PHSensorConfig {
+    std::string mode = "continuous"; // "alarm" or "single_shot"
+    int chipNumber = 0;
+    int readyPin = 27;   // ADS1115 ALERT/RDY: conversion ready, or the alarm in alarm mode
+    int dataRate = 860;  // Conversions per second: 8, 16, 32, 64, 128, 250, 475 or 860
+    int oversample = 64; // Conversions averaged into one reading
+
+    // Other probes on single-ended inputs A1 to A3, read after each pH burst
+    struct Channel {
+        std::string name;
+        int channel;
+    };
+    std::vector<Channel> channels;
+
+    // Safe pH band, alarm mode watches it with the ADC's window comparator
+    bool alarmEnabled = true;
+    float alarmLow = 6.5f;
+    float alarmHigh = 8.0f;
+    int alarmDataRate = 8;     // Conversions per second while watching
+    int alarmConversions = 4;  // Out of band this many in a row: 1, 2 or 4
+
+    bool load(const std::string& path);
+};
 
+/**
+ * ADS1115 pH probe, read by PHSampler which publishes on the "ph" topic
+ *
+ * In continuous mode the ADC converts on its own and its ALERT/RDY pin
+ * signals each result, a sampler thread waits for the edge and reads only
+ * the conversion register. read() then returns the average of the next
+ * oversample conversions without touching the bus. Without the ready line
+ * the sensor falls back to single-shot reads. Every transfer goes through
+ * the shared I2C bus manager.
+ *
+ * In alarm mode the ADC converts slowly with its window comparator set to
+ * the safe band, converted back to ADC codes through the calibration, and
+ * asserts ALERT/RDY while pH is outside it. A thread sleeps on that edge,
+ * so watching costs no CPU and no I2C traffic. In the other modes each
+ * reading is checked against the band instead. Changes are published on
+ * the "ph_alarm" topic.
+ */
 class PHSensor {
 public:
-    // Interface for pH sensor callbacks
-    struct PHSensorCallbackInterface {
-        virtual void onPHSample(float pH, float voltage, int16_t adcValue) = 0;
+    struct Sample {
+        float pH;
+        float voltage;
+        int16_t adcValue;
+    };
+
+    struct ChannelReading {
+        std::string name;
+        int channel;
+        bool valid;
+        float voltage;
+    };
+
+    struct AlarmEvent {
+        uint64_t timestampNs; // CLOCK_MONOTONIC
+        bool active;          // Left the band, or back inside
+        float pH;             // Conversion at the change, NaN if it couldn't be read
+        float low;
+        float high;
+        bool hardware;        // From the comparator, else from a reading
+    };
+
+    struct AlarmState {
+        bool enabled;
+        bool hardware;
+        bool active;
+        float low;
+        float high;
+        uint64_t changes;
+        std::time_t lastChange; // 0 if never
     };
 
-    PHSensor();
+    struct Stats {
+        bool continuous;       // Sampler running, else single-shot
+        uint64_t conversions;  // Read by the sampler
+        uint64_t missed;       // Ready edges that arrived before the previous read
+        uint64_t i2cErrors;
+        uint64_t readings;     // Returned by read()
+        double conversionsPerSecond;
+        std::vector<ChannelReading> channels;
+    };
+
+    PHSensor(EventBus& bus, I2cBus& i2c, const PHSensorConfig& config = PHSensorConfig());
     ~PHSensor();
 
-    void registerCallback(PHSensorCallbackInterface* callback);
     bool initialize();
     void cleanup();
-    float readPH();
-    bool isInitialized() const { return m_fd >= 0; }
+
+    /**
+     * Read one sample without publishing it, initializing the sensor if needed.
+     * In continuous mode it waits for an average newer than the last one read.
+     */
+    bool read(Sample& sample);
+
+    // Single-shot voltage of input A1 to A3, continuous pH sampling resumes after.
+    // Fails in alarm mode, the comparator needs the ADC to itself.
+    bool readChannel(int channel, float& voltage);
+
+    // Read every configured channel, the voltages are reported in stats()
+    void scanChannels();
+
+    // New safe band, reprograms the comparator in alarm mode
+    bool setAlarm(float low, float high);
+    AlarmState alarm() const;
+
+    bool isInitialized() const { return m_initialized; }
+    const I2cBus& i2c() const { return m_i2c; }
+    Stats stats() const;
 
 private:
-    int16_t readADC();
-    float adcToVoltage(int16_t adcValue);
+    // Configure the ADC and ready line and start the sampler
+    bool startContinuous();
+    // Configure the window comparator and start the alarm watcher
+    bool startAlarm();
+    // Stop either thread and power the ADC down
+    void stopContinuous();
+    void sampler();
+    void alarmWatcher();
+
+    bool writeThresholds();
+    // Publish if the alarm changed
+    void setAlarmState(bool active, float pH, bool hardware);
+    int16_t pHToAdc(float pH) const;
+
+    // Single-shot conversion of one input
+    bool readADC(uint16_t mux, int16_t& value);
+    bool writeRegister(uint8_t reg, uint16_t value);
+    bool readConversion(int16_t& value);
+    uint16_t continuousConfig() const;
+    uint16_t alarmConfig() const;
+    uint16_t dataRateBits(int rate) const;
+    float adcToVoltage(float adcValue);
     float voltageToPH(float voltage);
-    void notifyCallbacks(float pH, float voltage, int16_t adcValue);
 
-    std::vector<PHSensorCallbackInterface*> m_callbackInterfaces;
-    int m_fd;
+    Topic<AlarmEvent>& m_alarmTopic;
+    PHSensorConfig m_config;
+    I2cBus& m_i2c;
+    std::atomic<bool> m_initialized;
+    // Periodic samples and on-demand reads come from different pool threads
+    std::recursive_mutex m_mutex;
+
+    // Continuous mode
+    gpiod_line_request* m_request;
+    gpiod_edge_event_buffer* m_eventBuffer;
+    gpio::Wakeup m_wakeup;
+    std::thread m_sampler;
+    std::atomic<bool> m_sampling;
+    std::atomic<bool> m_alarmMode; // Alarm watcher running, conversions are continuous
+
+    // Last full average, written by the sampler
+    mutable std::mutex m_latestMutex;
+    std::condition_variable m_latestCondition;
+    float m_latestAdc;
+    uint64_t m_latestSequence; // Averages so far, 0 before the first
+    uint64_t m_readSequence;   // Last average handed out by read()
+    int64_t m_samplerStartNs;
+
+    std::atomic<uint64_t> m_conversions;
+    std::atomic<uint64_t> m_missed;
+    std::atomic<uint64_t> m_i2cErrors;
+    std::atomic<uint64_t> m_readings;
+    std::atomic<int> m_skip; // Sampler conversions to drop after a channel read
+    std::vector<ChannelReading> m_channels; // Under m_latestMutex
+
+    // Under m_latestMutex
+    bool m_alarmEnabled;
+    float m_alarmLow;
+    float m_alarmHigh;
+    bool m_alarmActive;
+    uint64_t m_alarmChanges;
+    std::time_t m_alarmChangedAt;
 };
 
-#endif 
+#endif
@@ -1,47 +1,103 @@
 #ifndef PIR_SENSOR_H
 #define PIR_SENSOR_H
 
+#include "event_bus.h"
+#include "event_loop.h"
+#include "gpio_request.h"
 #include <atomic>
+#include <cstdint>
 #include <gpiod.h>
-#include <thread>
+#include <mutex>
+#include <string>
 #include <vector>
 
+/**
+ * PIR sensor configuration, loaded from config/pir.json
+ */
+struct PirSensorConfig {
+    int chipNumber = 0;
+    int pinNumber = 17;
+    int debounceMs = 50;   // Pulses shorter than this are glitches, filtered by the kernel if it can
+    int holdOffMs = 3000;  // Rising edges within this of the last motion join its burst
+    bool kernelDebounce = true; // False debounces in userspace even if the line could
+
+    bool load(const std::string& path);
+};
+
 /**
  * PIR motion sensor interface class with callback
+ *
+ * Edges are debounced and coalesced so one burst of motion is reported once.
+ * The line's event fd is watched by the event loop, motion is published on the
+ * "motion" topic from the loop thread.
  */
 class PirSensor {
 public:
-    // Interface for motion callbacks
-    struct MotionCallbackInterface {
-        virtual void motionDetected(gpiod_line_event e) = 0;
+    struct MotionEvent {
+        uint64_t timestampNs;  // Hardware timestamp if the line supports it, else CLOCK_MONOTONIC
+        unsigned int pin;
+        unsigned long seqno;
+    };
+
+    struct Stats {
+        uint64_t edges;        // Every edge read from the line
+        uint64_t risingEdges;
+        uint64_t glitches;     // Rising edges dropped by the debounce
+        uint64_t coalesced;    // Rising edges absorbed into a burst
+        uint64_t motions;      // Published on the motion topic
+        uint64_t reads;        // Wakeups that drained events, edges / reads is the batch size
+        bool kernelDebounce;   // Debounce done by the kernel instead of here
+        bool hardwareTimestamps;
     };
 
-    PirSensor(int chipNumber = 0, int pinNumber = 17);
+    PirSensor(EventLoop& loop, EventBus& bus, const PirSensorConfig& config = PirSensorConfig());
     ~PirSensor();
 
-    // Start motion detection thread
+    // Start watching the line in the event loop, edges queued while stopped are dropped
     void start();
 
-    // Stop motion detection thread
+    // Stop watching the line, a pending rise is forgotten
     void stop();
 
-    // Register callback for motion events
-    void registerCallback(MotionCallbackInterface* callback);
+    Stats stats() const;
 
 private:
-    // Worker thread function - blocks until motion detected
-    void worker();
+    // Drain queued edge events, called by the event loop
+    void readEvents();
+
+    // Debounce timer expired
+    void pendingTimeout();
+
+    // Forget the pending rise and the burst if stop() was called since, loop thread only
+    void dropStaleState();
 
     // Process GPIO event
-    void gpioEvent(gpiod_line_event& event);
+    void gpioEvent(gpiod_edge_event* event);
+
+    // Rising edge that survived the debounce
+    void stableRise(const MotionEvent& event);
+
+    // Request the line, dropping kernel debounce and hardware timestamps if unsupported
+    void requestLine();
 
-    int m_chipNumber;
-    int m_pinNumber;
+    static const size_t EVENT_BUFFER_SIZE = 64;
+
+    EventLoop& m_loop;
+    PirSensorConfig m_config;
     std::atomic<bool> m_running;
-    std::thread m_thread;
-    std::vector<MotionCallbackInterface*> m_callbacks;
-    struct gpiod_chip* m_chip;
-    struct gpiod_line* m_line;
+    Topic<MotionEvent>& m_motionTopic;
+    gpiod_line_request* m_request;
+    gpiod_edge_event_buffer* m_eventBuffer;
+    int m_debounceTimer;
+    std::atomic<bool> m_stopped; // Set by stop(), cleared by the loop thread once it dropped its state
+
+    // Event loop thread state
+    bool m_pendingRise;
+    MotionEvent m_pendingEvent;
+    int64_t m_lastMotionNs;
+
+    mutable std::mutex m_statsMutex;
+    Stats m_stats;
 };
 
 #endif 
@@ -0,0 +1,74 @@
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <sched.h>
+#include <string>
+
+/**
+ * Opt-in real-time execution mode
+ *
+ * Latency-critical threads (PIR, motor) run SCHED_FIFO on a dedicated core,
+ * everything else is confined to the remaining cores. Threads apply their
+ * own policy because libraries (FastCGI) create threads we don't own and
+ * which inherit the policy of their creator.
+ */
+namespace realtime {
+
+enum class ThreadRole {
+    Main,
+    Pir,
+    Motor,
+    Camera,
+    Detection,
+    Api
+};
+
+struct Config {
+    bool enabled = false;
+    int rtCore = -1;        // -1 picks the first isolated core, or the last core
+    int pirPriority = 80;   // SCHED_FIFO priority of the PIR worker
+    int motorPriority = 70; // SCHED_FIFO priority while playing a motor profile
+    bool lockMemory = true; // mlockall(MCL_CURRENT | MCL_FUTURE)
+};
+
+/**
+ * Set the process-wide policy, call once before any thread is started
+ * @return true if the policy is usable (always true when disabled)
+ */
+bool configure(const Config& config);
+
+bool isEnabled();
+
+/**
+ * Apply the policy for a role to the calling thread
+ * @return true if applied or real-time mode is disabled
+ */
+bool applyThreadPolicy(ThreadRole role);
+
+/**
+ * Human readable summary of the applied policy for the startup log
+ */
+std::string report();
+
+/**
+ * Applies a role policy to the calling thread and restores the
+ * previous scheduler and affinity on destruction
+ */
+class ScopedThreadPolicy {
+public:
+    explicit ScopedThreadPolicy(ThreadRole role);
+    ~ScopedThreadPolicy();
+
+    ScopedThreadPolicy(const ScopedThreadPolicy&) = delete;
+    ScopedThreadPolicy& operator=(const ScopedThreadPolicy&) = delete;
+
+private:
+    bool m_active;
+    int m_policy;
+    sched_param m_param;
+    cpu_set_t m_cpus;
+};
+
+} // namespace realtime
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/**
+ * Latest value of a small trivially copyable type, one writer, any readers
+ *
+ * The writer makes the sequence odd, copies the value and makes it even
+ * again. Readers never block the writer or each other, they copy the value
+ * and retry if the sequence moved underneath them. The value is held in
+ * relaxed atomic words, so a torn copy is discarded rather than undefined.
+ */
+template <typename T>
+class SeqLock {
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock needs a trivially copyable type");
+
+public:
+    explicit SeqLock(const T& initial = T());
+    SeqLock(const SeqLock&) = delete;
+    SeqLock& operator=(const SeqLock&) = delete;
+
+    // Writer: only one thread at a time
+    void store(const T& value);
+
+    // Reader: a consistent copy of the last stored value
+    T load() const;
+
+    // Number of stores so far
+    uint64_t version() const { return m_sequence.load(std::memory_order_acquire) / 2; }
+
+private:
+    static const size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    void write(const T& value);
+
+    std::atomic<uint64_t> m_sequence;
+    std::atomic<uint64_t> m_words[WORDS];
+};
+
+template <typename T>
+SeqLock<T>::SeqLock(const T& initial) : m_sequence(0) {
+    write(initial);
+}
+
+template <typename T>
+void SeqLock<T>::store(const T& value) {
+    uint64_t sequence = m_sequence.load(std::memory_order_relaxed);
+    m_sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    write(value);
+    m_sequence.store(sequence + 2, std::memory_order_release);
+}
+
+template <typename T>
+T SeqLock<T>::load() const {
+    uint64_t words[WORDS];
+    while (true) {
+        uint64_t before = m_sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            continue; // Store in progress
+        }
+        for (size_t i = 0; i < WORDS; ++i) {
+            words[i] = m_words[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_sequence.load(std::memory_order_relaxed) == before) {
+            break;
+        }
+    }
+    T value;
+    std::memcpy(&value, words, sizeof(T));
+    return value;
+}
+
+template <typename T>
+void SeqLock<T>::write(const T& value) {
+    uint64_t words[WORDS] = {};
+    std::memcpy(words, &value, sizeof(T));
+    for (size_t i = 0; i < WORDS; ++i) {
+        m_words[i].store(words[i], std::memory_order_relaxed);
+    }
+}
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+/**
+ * Bounded lock-free ring between two pipeline stages, drop-oldest when full
+ *
+ * One producer and one consumer, each may move between threads as long as
+ * the hand-over is synchronised. Every cell carries a sequence number
+ * (Vyukov's bounded queue), so the producer can take the oldest item itself
+ * when the ring is full without racing the consumer for it. The consumer
+ * sleeps on an atomic wait when the ring is empty.
+ */
+template <typename T>
+class SpscRing {
+public:
+    /**
+     * @param capacity Rounded up to a power of two, at least 2
+     */
+    explicit SpscRing(size_t capacity);
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    /**
+     * Producer: append an item, dropping the oldest one if full
+     * @return true if an item was dropped, it is moved into dropped
+     */
+    bool push(T item, T& dropped);
+
+    // Consumer: take the oldest item if there is one
+    bool tryPop(T& item);
+
+    /**
+     * Consumer: wait for an item
+     * @return false once closed and empty
+     */
+    bool pop(T& item);
+
+    // Wake the consumer, pop() drains what is left and then returns false
+    void close();
+
+    size_t capacity() const { return m_mask + 1; }
+    size_t size() const;
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> m_cells;
+    size_t m_mask;
+    alignas(64) std::atomic<size_t> m_enqueuePos;
+    alignas(64) std::atomic<size_t> m_dequeuePos;
+    alignas(64) std::atomic<uint32_t> m_signal; // Bumped on every push and on close
+    std::atomic<bool> m_closed;
+};
+
+template <typename T>
+SpscRing<T>::SpscRing(size_t capacity) : m_enqueuePos(0), m_dequeuePos(0), m_signal(0), m_closed(false) {
+    size_t size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    m_cells = std::make_unique<Cell[]>(size);
+    m_mask = size - 1;
+    for (size_t i = 0; i < size; ++i) {
+        m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+template <typename T>
+bool SpscRing<T>::push(T item, T& dropped) {
+    bool hasDropped = false;
+    // Only this thread enqueues, so the position can't move under us
+    size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+    Cell* cell = &m_cells[pos & m_mask];
+    while (cell->sequence.load(std::memory_order_acquire) != pos) {
+        // Full: the oldest goes, unless the consumer is taking it right now
+        T oldest;
+        if (!hasDropped && tryPop(oldest)) {
+            dropped = std::move(oldest);
+            hasDropped = true;
+        }
+    }
+    cell->value = std::move(item);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    m_enqueuePos.store(pos + 1, std::memory_order_relaxed);
+
+    m_signal.fetch_add(1, std::memory_order_release);
+    m_signal.notify_one();
+    return hasDropped;
+}
+
+template <typename T>
+bool SpscRing<T>::tryPop(T& item) {
+    // The producer dequeues too when it drops, so the position is claimed
+    size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+    while (true) {
+        Cell* cell = &m_cells[pos & m_mask];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        if (sequence < pos + 1) {
+            return false; // Empty
+        }
+        if (sequence == pos + 1) {
+            if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                item = std::move(cell->value);
+                cell->value = T();
+                cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+                return true;
+            }
+        } else {
+            pos = m_dequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+template <typename T>
+bool SpscRing<T>::pop(T& item) {
+    while (true) {
+        uint32_t seen = m_signal.load(std::memory_order_acquire);
+        if (tryPop(item)) {
+            return true;
+        }
+        if (m_closed.load(std::memory_order_acquire)) {
+            return false;
+        }
+        m_signal.wait(seen, std::memory_order_acquire);
+    }
+}
+
+template <typename T>
+void SpscRing<T>::close() {
+    m_closed.store(true, std::memory_order_release);
+    m_signal.fetch_add(1, std::memory_order_release);
+    m_signal.notify_all();
+}
+
+template <typename T>
+size_t SpscRing<T>::size() const {
+    size_t enqueued = m_enqueuePos.load(std::memory_order_relaxed);
+    size_t dequeued = m_dequeuePos.load(std::memory_order_relaxed);
+    return enqueued > dequeued ? enqueued - dequeued : 0;
+}
+
+#endif
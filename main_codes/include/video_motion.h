@@ -0,0 +1,93 @@
+#ifndef VIDEO_MOTION_H
+#define VIDEO_MOTION_H
+
+#include "camera.h"
+#include "event_bus.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <thread>
+
+/**
+ * Video motion detector settings, loaded from config/video_motion.json
+ */
+struct VideoMotionConfig {
+    int width = 160;              // Preview stream, small enough to run all the time
+    int height = 120;
+    int fps = 4;
+    double backgroundRate = 0.05; // Share of each frame blended into the background
+    double noiseFactor = 4.0;     // Pixel threshold in multiples of the measured noise
+    int minThreshold = 8;         // Floor of the pixel threshold, grey levels
+    double minAreaPercent = 0.5;  // Changed pixels that count as motion
+    int holdOffMs = 3000;         // Motion within this of the last report is coalesced
+
+    bool load(const std::string& path);
+};
+
+/**
+ * Motion from the camera's preview stream, an alternative to the PIR sensor
+ *
+ * Frame differencing against a running background on a dedicated thread.
+ * The pixel threshold follows the sensor noise measured on still frames, so
+ * it adapts to light level and gain. Motion is published on the
+ * "video_motion" topic.
+ */
+class VideoMotionDetector {
+public:
+    struct MotionEvent {
+        uint64_t timestampNs; // CLOCK_MONOTONIC
+        double changedPercent;
+    };
+
+    struct Stats {
+        bool running;
+        uint64_t frames;
+        uint64_t motions;     // Published on the topic
+        uint64_t coalesced;   // Motion within the hold-off
+        uint64_t readFailures;
+        double noise;         // Mean difference of still frames
+        double threshold;     // Current pixel threshold
+        double avgFrameMs;    // Processing time per frame
+        double cpuPercent;    // Processing time over run time
+    };
+
+    VideoMotionDetector(Camera& camera, EventBus& bus,
+                        const VideoMotionConfig& config = VideoMotionConfig());
+    ~VideoMotionDetector();
+    VideoMotionDetector(const VideoMotionDetector&) = delete;
+    VideoMotionDetector& operator=(const VideoMotionDetector&) = delete;
+
+    void start();
+
+    // Stop the thread and release the preview stream
+    void stop();
+
+    bool isRunning() const { return m_running; }
+    Stats stats() const;
+
+private:
+    void run();
+
+    // Compare one grey frame with the background, true on motion
+    bool process(const cv::Mat& frame, double& changedPercent);
+
+    Camera& m_camera;
+    VideoMotionConfig m_config;
+    Topic<MotionEvent>& m_motionTopic;
+    std::atomic<bool> m_running;
+    std::thread m_thread;
+    std::mutex m_startMutex;
+
+    // Detector thread state
+    cv::Mat m_background; // CV_32F
+    int64_t m_lastMotionNs;
+
+    mutable std::mutex m_statsMutex;
+    Stats m_stats;
+    int64_t m_busyNs;
+    int64_t m_runNs;
+};
+
+#endif
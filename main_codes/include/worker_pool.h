@@ -0,0 +1,119 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include "realtime.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Shared work-stealing pool for all blocking and CPU-heavy work (capture and
+ * detection, feeding, archiving, pH reads, API requests and OpenCV's own
+ * parallel loops)
+ *
+ * Every worker has a deque per priority lane. Jobs submitted from a worker go
+ * to its own deque, others are spread round robin. A worker takes the newest
+ * job of its own deque and steals the oldest from the others, lane by lane,
+ * so it steals feeding work before it runs its own archiving work.
+ */
+class WorkerPool {
+public:
+    // Highest priority first
+    enum class Lane {
+        Feeding,   // Capture, detection, feeding and API requests
+        Archiving, // Image and data writes
+        Analytics  // Periodic sampling and anything that can wait
+    };
+    static const size_t LANES = 3;
+
+    struct LaneStats {
+        Lane lane;
+        uint64_t submitted;
+        uint64_t completed;
+        uint64_t stolen;      // Run by a worker other than the one it was queued on
+        size_t queued;
+        double busySeconds;   // Summed over all workers
+        double utilisation;   // Share of the pool's thread time since start
+        double avgWaitMs;     // Submit to start
+    };
+
+    explicit WorkerPool(size_t threads = defaultSize(),
+                        realtime::ThreadRole role = realtime::ThreadRole::Detection);
+    ~WorkerPool();
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // One worker per core, less the event loop's, at least two
+    static size_t defaultSize();
+
+    static const char* laneName(Lane lane);
+
+    // Queue a job, dropped if the pool is stopped
+    bool submit(std::function<void()> job, Lane lane = Lane::Feeding);
+
+    // Run the queued jobs, then join the threads
+    void stop();
+
+    size_t size() const { return m_workers.size(); }
+    size_t queued() const { return m_pending; }
+    uint64_t completed() const;
+    std::vector<LaneStats> laneStats() const;
+
+    /**
+     * Index of the calling thread in this pool, -1 if it isn't one of its workers
+     */
+    int currentWorker() const;
+
+    /**
+     * Lane of the job running on the calling thread, Feeding outside the pool
+     */
+    static Lane currentLane();
+
+private:
+    struct Job {
+        std::function<void()> run;
+        int64_t queuedNs;
+        size_t owner; // Worker whose deque it was queued on
+    };
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Job> jobs[LANES];
+        std::thread thread;
+    };
+
+    struct LaneCounters {
+        std::atomic<uint64_t> submitted{0};
+        std::atomic<uint64_t> completed{0};
+        std::atomic<uint64_t> stolen{0};
+        std::atomic<size_t> queued{0};
+        std::atomic<int64_t> busyNs{0};
+        std::atomic<int64_t> waitNs{0};
+    };
+
+    void worker(size_t index);
+    bool take(size_t index, Job& job, size_t& lane);
+    void run(size_t index, Job& job, size_t lane);
+
+    realtime::ThreadRole m_role;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    LaneCounters m_lanes[LANES];
+    std::atomic<size_t> m_nextWorker;
+    int64_t m_startNs;
+
+    // Guards m_running and sleeping; m_pending counts reserved jobs so no
+    // worker exits while a submit is still pushing
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_running;
+    size_t m_sleeping;
+    std::atomic<size_t> m_pending;
+};
+
+#endif
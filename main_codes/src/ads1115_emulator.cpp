@@ -0,0 +1,249 @@
+#include "ads1115_emulator.h"
+#include <jsoncpp/json/json.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+// Register pointers
+static const uint8_t CONVERSION_REG = 0x00;
+static const uint8_t CONFIG_REG = 0x01;
+static const uint8_t LO_THRESH_REG = 0x02;
+static const uint8_t HI_THRESH_REG = 0x03;
+
+// Config register fields
+static const uint16_t CONFIG_OS = 1 << 15;
+static const uint16_t CONFIG_MODE_SINGLE = 1 << 8;
+
+// Power-on register values
+static const uint16_t DEFAULT_CONFIG = 0x8583;
+static const uint16_t DEFAULT_LO_THRESH = 0x8000;
+static const uint16_t DEFAULT_HI_THRESH = 0x7FFF;
+
+static const int DATA_RATES[] = { 8, 16, 32, 64, 128, 250, 475, 860 };
+static const double FULL_SCALE[] = { 6.144, 4.096, 2.048, 1.024, 0.512, 0.256, 0.256, 0.256 };
+
+static const int64_t NS_PER_SEC = 1000000000LL;
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool Ads1115EmulatorConfig::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Cannot open ADS1115 emulator config " << path << std::endl;
+        return false;
+    }
+
+    Json::Value root;
+    Json::CharReaderBuilder builder;
+    JSONCPP_STRING err;
+    if (!Json::parseFromStream(builder, file, &root, &err)) {
+        std::cerr << "Error parsing ADS1115 emulator config: " << err << std::endl;
+        return false;
+    }
+
+    int value = root.get("address", address).asInt();
+    if (value >= 0x48 && value <= 0x4B) {
+        address = value;
+    } else {
+        std::cerr << "ADS1115 address " << value << " not in 0x48 to 0x4B, using 0x48" << std::endl;
+    }
+    if (root.isMember("script")) {
+        script.clear();
+        for (const auto& point : root["script"]) {
+            if (point.isArray() && point.size() == 2) {
+                script.push_back({ point[0].asDouble(), point[1].asDouble() });
+            }
+        }
+        std::sort(script.begin(), script.end(), [](const Point& a, const Point& b) {
+            return a.seconds < b.seconds;
+        });
+    }
+    loop = root.get("loop", loop).asBool();
+    timeScale = std::max(0.0, root.get("time_scale", timeScale).asDouble());
+    probeSlope = root.get("probe_slope", probeSlope).asDouble();
+    if (probeSlope == 0.0) {
+        std::cerr << "ADS1115 emulator probe slope can't be 0, using -12.5" << std::endl;
+        probeSlope = -12.5;
+    }
+    probeOffset = root.get("probe_offset", probeOffset).asDouble();
+    const Json::Value& volts = root["channel_volts"];
+    for (Json::ArrayIndex i = 0; i < 3 && i < volts.size(); ++i) {
+        channelVolts[i] = volts[i].asDouble();
+    }
+    noiseUv = std::max(0.0, root.get("noise_uv", noiseUv).asDouble());
+    spikeRate = std::max(0.0, std::min(1.0, root.get("spike_rate", spikeRate).asDouble()));
+    spikeVolts = root.get("spike_volts", spikeVolts).asDouble();
+    seed = root.get("seed", seed).asUInt();
+    return true;
+}
+
+Ads1115Emulator::Ads1115Emulator(const Ads1115EmulatorConfig& config)
+    : m_config(config),
+      m_startNs(nowNs()),
+      m_random(config.seed),
+      m_pointer(CONVERSION_REG),
+      m_configRegister(DEFAULT_CONFIG & ~CONFIG_OS),
+      m_loThresh(DEFAULT_LO_THRESH),
+      m_hiThresh(DEFAULT_HI_THRESH),
+      m_conversion(0),
+      m_busy(false),
+      m_readyNs(0),
+      m_continuousNs(-1),
+      m_converted(0),
+      m_stats() {
+}
+
+bool Ads1115Emulator::transfer(const uint8_t* out, size_t outLength, uint8_t* in, size_t inLength) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    int64_t now = nowNs();
+    update(now);
+
+    if (outLength > 0) {
+        // Pointer byte, then an optional 16-bit value for that register
+        if (out[0] > HI_THRESH_REG) {
+            errno = EREMOTEIO;
+            return false;
+        }
+        m_pointer = out[0];
+    }
+    if (outLength >= 3) {
+        m_stats.writes++;
+        uint16_t value = static_cast<uint16_t>((out[1] << 8) | out[2]);
+        if (m_pointer == CONFIG_REG) {
+            m_configRegister = value & ~CONFIG_OS;
+            if (value & CONFIG_MODE_SINGLE) {
+                m_continuousNs = -1;
+                if ((value & CONFIG_OS) && !m_busy) {
+                    m_busy = true;
+                    m_readyNs = now + periodNs();
+                }
+            } else {
+                // Continuous, restarted on every config write
+                m_busy = false;
+                m_continuousNs = now;
+                m_converted = 0;
+            }
+        } else if (m_pointer == LO_THRESH_REG) {
+            m_loThresh = value;
+        } else if (m_pointer == HI_THRESH_REG) {
+            m_hiThresh = value;
+        }
+    }
+
+    if (inLength > 0) {
+        m_stats.reads++;
+        uint16_t value = 0;
+        if (m_pointer == CONVERSION_REG) {
+            if (m_busy) {
+                m_stats.earlyReads++;
+            }
+            value = static_cast<uint16_t>(m_conversion);
+        } else if (m_pointer == CONFIG_REG) {
+            // OS reads 1 only while a single-shot device is idle
+            bool idle = (m_configRegister & CONFIG_MODE_SINGLE) && !m_busy;
+            value = m_configRegister | (idle ? CONFIG_OS : 0);
+        } else if (m_pointer == LO_THRESH_REG) {
+            value = m_loThresh;
+        } else {
+            value = m_hiThresh;
+        }
+        for (size_t i = 0; i < inLength; ++i) {
+            in[i] = i == 0 ? static_cast<uint8_t>(value >> 8) : (i == 1 ? static_cast<uint8_t>(value & 0xFF) : 0xFF);
+        }
+    }
+    return true;
+}
+
+double Ads1115Emulator::truePH(double seconds) const {
+    const auto& script = m_config.script;
+    if (script.empty()) {
+        return 7.0;
+    }
+    double t = seconds * m_config.timeScale;
+    if (m_config.loop && script.back().seconds > 0.0) {
+        t = std::fmod(t, script.back().seconds);
+    }
+    if (t <= script.front().seconds) {
+        return script.front().pH;
+    }
+    for (size_t i = 1; i < script.size(); ++i) {
+        const auto& a = script[i - 1];
+        const auto& b = script[i];
+        if (t <= b.seconds) {
+            double span = b.seconds - a.seconds;
+            return span > 0.0 ? a.pH + (b.pH - a.pH) * (t - a.seconds) / span : b.pH;
+        }
+    }
+    return script.back().pH;
+}
+
+double Ads1115Emulator::elapsed() const {
+    return (nowNs() - m_startNs) / 1e9;
+}
+
+Ads1115Emulator::Stats Ads1115Emulator::stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void Ads1115Emulator::update(int64_t now) {
+    if (m_busy && now >= m_readyNs) {
+        m_conversion = convert(m_readyNs);
+        m_busy = false;
+        m_stats.conversions++;
+    }
+    if (m_continuousNs >= 0) {
+        // Only the newest result is visible, earlier ones were overwritten unread
+        int64_t period = periodNs();
+        int64_t done = (now - m_continuousNs) / period;
+        if (done > m_converted) {
+            m_conversion = convert(m_continuousNs + done * period);
+            m_stats.conversions += done - m_converted;
+            m_converted = done;
+        }
+    }
+}
+
+int16_t Ads1115Emulator::convert(int64_t atNs) {
+    uint16_t mux = (m_configRegister >> 12) & 0x7;
+    uint16_t gain = (m_configRegister >> 9) & 0x7;
+    int rate = DATA_RATES[(m_configRegister >> 5) & 0x7];
+
+    double volts = inputVolts(mux, (atNs - m_startNs) / 1e9);
+    // Noise density is flat, the digital filter's bandwidth follows the data rate
+    std::normal_distribution<double> noise(0.0, m_config.noiseUv * 1e-6 * std::sqrt(rate / 8.0));
+    volts += noise(m_random);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    if (m_config.spikeRate > 0.0 && uniform(m_random) < m_config.spikeRate) {
+        volts += uniform(m_random) < 0.5 ? -m_config.spikeVolts : m_config.spikeVolts;
+    }
+
+    double code = std::round(volts * 32768.0 / FULL_SCALE[gain]);
+    return static_cast<int16_t>(std::max(-32768.0, std::min(32767.0, code)));
+}
+
+double Ads1115Emulator::inputVolts(uint16_t mux, double seconds) const {
+    double inputs[4] = {
+        (truePH(seconds) - m_config.probeOffset) / m_config.probeSlope,
+        m_config.channelVolts[0],
+        m_config.channelVolts[1],
+        m_config.channelVolts[2]
+    };
+    switch (mux) {
+    case 0: return inputs[0] - inputs[1];
+    case 1: return inputs[0] - inputs[3];
+    case 2: return inputs[1] - inputs[3];
+    case 3: return inputs[2] - inputs[3];
+    default: return inputs[mux - 4];
+    }
+}
+
+int64_t Ads1115Emulator::periodNs() const {
+    return NS_PER_SEC / DATA_RATES[(m_configRegister >> 5) & 0x7];
+}
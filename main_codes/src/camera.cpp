@@ -1,12 +1,21 @@
 #include "camera.h"
+#include <cstdio>
+#include <filesystem>
 #include <iostream>
 #include <sstream>
 
-Camera::Camera(const std::string& outputPath, int width, int height) 
+Camera::Camera(EventBus& bus, const std::string& topic, const std::string& outputPath, int width, int height) 
     : m_outputPath(outputPath), 
       m_width(width),
       m_height(height),
-      m_running(false) {}
+      m_running(false),
+      m_busy(false),
+      m_captures(0),
+      m_failures(0),
+      m_imageTopic(bus.topic<ImageEvent>(topic)),
+      m_previewWidth(160),
+      m_previewHeight(120),
+      m_previewFps(4) {}
 
 Camera::~Camera() {
     stop();
@@ -14,79 +23,118 @@ Camera::~Camera() {
 
 void Camera::start() {
     m_running = true;
-    m_thread = std::thread(&Camera::worker, this);
 }
 
 void Camera::stop() {
     m_running = false;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_captureCondition.wait(lock, [this]() { return !m_busy; });
+    }
+    closePreview();
+}
+
+std::string Camera::captureFile(uint64_t frame) {
     {
         std::lock_guard<std::mutex> lock(m_mutex);
-        m_captureRequested = true;
-        m_captureCondition.notify_one();
+        if (!m_running || m_busy) {
+            return std::string();
+        }
+        m_busy = true;
     }
     
-    if (m_thread.joinable()) {
-        m_thread.join();
+    // Capture image using libcamera-still 
+    std::cout << "Capturing image..." << std::endl;
+    
+    // One file per frame, the previous one may still be waiting for decode
+    std::string path = framePath(frame);
+    std::stringstream command;
+    command << "libcamera-still "
+            << "--immediate " // Capture immediately without settling time
+            << "--nopreview " // Disable preview window
+            << "--width " << m_width << " --height " << m_height << " " // Lower resolution 
+            << "--quality 85 " // Slightly reduced quality for faster processing
+            << "-o " << path;
+    
+    int result;
+    {
+        std::lock_guard<std::mutex> device(m_deviceMutex);
+        if (m_preview.isOpened()) {
+            m_preview.release(); // libcamera-still needs the camera to itself
+        }
+        result = system(command.str().c_str());
     }
+    m_captures++;
+    if (result != 0) {
+        std::cerr << "Failed to capture image with libcamera-still" << std::endl;
+        m_failures++;
+        path.clear();
+    }
+    
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_busy = false;
+    m_captureCondition.notify_all();
+    return path;
 }
 
-void Camera::captureImage() {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    m_captureRequested = true;
-    m_captureCondition.notify_one();
+cv::Mat Camera::decode(const std::string& path) {
+    // Load captured image
+    cv::Mat image = cv::imread(path);
+    std::remove(path.c_str());
+    if (image.empty()) {
+        std::cerr << "Failed to load captured image from " << path << std::endl;
+        m_failures++;
+        return image;
+    }
+    
+    // Image captured successfully, also published for other consumers
+    std::cout << "Image captured successfully, processing..." << std::endl;
+    m_imageTopic.publish({image});
+    return image;
 }
 
-void Camera::registerCallback(ImageCallbackInterface* callback) {
-    m_callbacks.push_back(callback);
+void Camera::setPreview(int width, int height, int fps) {
+    std::lock_guard<std::mutex> device(m_deviceMutex);
+    m_previewWidth = width;
+    m_previewHeight = height;
+    m_previewFps = fps;
 }
 
-void Camera::worker() {
-    std::cout << "Camera thread started." << std::endl;
-    
-    while (m_running) {
-        // Wait for capture request (blocks until requested)
-        {
-            std::unique_lock<std::mutex> lock(m_mutex);
-            m_captureCondition.wait(lock, [this]() {
-                return m_captureRequested || !m_running;
-            });
-            
-            if (!m_running) break;
-            m_captureRequested = false;
-        }
-        
-        // Capture image using libcamera-still 
-        std::cout << "Capturing image..." << std::endl;
-        
-       
-        std::stringstream command;
-        command << "libcamera-still "
-                << "--immediate " // Capture immediately without settling time
-                << "--nopreview " // Disable preview window
-                << "--width " << m_width << " --height " << m_height << " " // Lower resolution 
-                << "--quality 85 " // Slightly reduced quality for faster processing
-                << "-o " << m_outputPath;
-        
-        int result = system(command.str().c_str());
-        
-        if (result != 0) {
-            std::cerr << "Failed to capture image with libcamera-still" << std::endl;
-            continue;
-        }
-        
-        // Load captured image
-        cv::Mat image = cv::imread(m_outputPath);
-        if (image.empty()) {
-            std::cerr << "Failed to load captured image from " << m_outputPath << std::endl;
-            continue;
-        }
-        
-        // Image captured successfully, notify callbacks
-        std::cout << "Image captured successfully, processing..." << std::endl;
-        for (auto& callback : m_callbacks) {
-            callback->imageReady(image);
+bool Camera::readPreview(cv::Mat& frame, bool& opened) {
+    opened = false;
+    if (!m_running) {
+        return false;
+    }
+    std::lock_guard<std::mutex> device(m_deviceMutex);
+    if (!m_preview.isOpened()) {
+        // Grey frames straight from the ISP, only the newest one is kept
+        std::stringstream pipeline;
+        pipeline << "libcamerasrc ! video/x-raw,width=" << m_previewWidth
+                 << ",height=" << m_previewHeight << ",framerate=" << m_previewFps << "/1"
+                 << " ! videoconvert ! video/x-raw,format=GRAY8"
+                 << " ! appsink drop=true max-buffers=1 sync=false";
+        if (!m_preview.open(pipeline.str(), cv::CAP_GSTREAMER)) {
+            std::cerr << "Failed to open camera preview stream" << std::endl;
+            return false;
         }
+        opened = true;
     }
-    
-    std::cout << "Camera thread stopped." << std::endl;
+    return m_preview.read(frame) && !frame.empty();
+}
+
+void Camera::closePreview() {
+    std::lock_guard<std::mutex> device(m_deviceMutex);
+    if (m_preview.isOpened()) {
+        m_preview.release();
+    }
+}
+
+Camera::Stats Camera::stats() const {
+    return { m_captures, m_failures };
+}
+
+std::string Camera::framePath(uint64_t frame) const {
+    std::filesystem::path path(m_outputPath);
+    std::string name = path.stem().string() + "_" + std::to_string(frame) + path.extension().string();
+    return (path.parent_path() / name).string();
 }
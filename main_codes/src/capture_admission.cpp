@@ -0,0 +1,197 @@
+#include "capture_admission.h"
+#include <jsoncpp/json/json.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+static const int64_t NS_PER_MS = 1000000LL;
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool CaptureAdmissionConfig::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Cannot open capture config " << path << std::endl;
+        return false;
+    }
+
+    Json::Value root;
+    Json::CharReaderBuilder builder;
+    JSONCPP_STRING err;
+    if (!Json::parseFromStream(builder, file, &root, &err)) {
+        std::cerr << "Error parsing capture config: " << err << std::endl;
+        return false;
+    }
+
+    policy = root.get("policy", policy).asString();
+    queueDepth = std::max(1, root.get("queue_depth", queueDepth).asInt());
+    minIntervalMs = std::max(0, root.get("min_interval_ms", minIntervalMs).asInt());
+    return true;
+}
+
+CaptureAdmission::CaptureAdmission(Camera& camera, FramePipeline& pipeline, WorkerPool& pool,
+                                   const CaptureAdmissionConfig& config)
+    : m_camera(camera),
+      m_pipeline(pipeline),
+      m_pool(pool),
+      m_queueDepth(static_cast<size_t>(std::max(1, config.queueDepth))),
+      m_policy(Policy::LatestWins),
+      m_minIntervalNs(config.minIntervalMs * NS_PER_MS),
+      m_busy(false),
+      m_lastStartNs(0),
+      m_requests(0),
+      m_started(0),
+      m_totalWaitNs(0),
+      m_maxWaitNs(0) {
+    if (!parsePolicy(config.policy, m_policy)) {
+        std::cerr << "Unknown capture policy " << config.policy << ", using latest_wins" << std::endl;
+    }
+}
+
+CaptureAdmission::~CaptureAdmission() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this]() { return !m_busy; });
+}
+
+void CaptureAdmission::captureImage() {
+    request(nullptr);
+}
+
+void CaptureAdmission::request(Callback done) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_requests++;
+    if (!m_camera.isRunning()) {
+        lock.unlock();
+        if (done) {
+            done(false, 0);
+        }
+        return;
+    }
+
+    const int64_t now = nowNs();
+    PolicyCounters& counters = m_counters[static_cast<size_t>(m_policy)];
+    bool coalesce = false;
+    bool shed = false;
+    switch (m_policy) {
+    case Policy::LatestWins:
+        coalesce = m_queue.size() >= m_queueDepth;
+        break;
+    case Policy::DropIfBusy:
+        shed = m_busy || !m_queue.empty();
+        break;
+    case Policy::MinInterval:
+        coalesce = !m_queue.empty();
+        shed = !coalesce && m_lastStartNs > 0 && now - m_lastStartNs < m_minIntervalNs;
+        break;
+    }
+
+    if (shed) {
+        counters.shed++;
+        lock.unlock();
+        if (done) {
+            done(false, 0);
+        }
+        return;
+    }
+    if (coalesce) {
+        // The newest queued capture starts after this request, its image is fresh enough
+        counters.coalesced++;
+        if (done) {
+            m_queue.back().waiters.push_back(std::move(done));
+        }
+        return;
+    }
+
+    counters.captured++;
+    Pending pending;
+    pending.requestedNs = now;
+    if (done) {
+        pending.waiters.push_back(std::move(done));
+    }
+    m_queue.push_back(std::move(pending));
+    if (!m_busy) {
+        m_busy = m_pool.submit([this]() { worker(); });
+        if (!m_busy) {
+            std::vector<Callback> waiters = std::move(m_queue.back().waiters);
+            m_queue.pop_back();
+            lock.unlock();
+            for (auto& waiter : waiters) {
+                waiter(false, 0);
+            }
+        }
+    }
+}
+
+void CaptureAdmission::setPolicy(Policy policy, int minIntervalMs) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_policy = policy;
+    if (minIntervalMs >= 0) {
+        m_minIntervalNs = minIntervalMs * NS_PER_MS;
+    }
+}
+
+CaptureAdmission::Stats CaptureAdmission::stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats stats;
+    stats.policy = m_policy;
+    stats.queued = m_queue.size();
+    stats.requests = m_requests;
+    stats.avgWaitMs = m_started ? m_totalWaitNs / 1e6 / m_started : 0.0;
+    stats.maxWaitMs = m_maxWaitNs / 1e6;
+    for (size_t i = 0; i < POLICIES; ++i) {
+        stats.policies.push_back({ static_cast<Policy>(i), m_counters[i].captured,
+                                   m_counters[i].coalesced, m_counters[i].shed });
+    }
+    return stats;
+}
+
+const char* CaptureAdmission::policyName(Policy policy) {
+    switch (policy) {
+    case Policy::LatestWins:
+        return "latest_wins";
+    case Policy::DropIfBusy:
+        return "drop_if_busy";
+    case Policy::MinInterval:
+        return "min_interval";
+    }
+    return "unknown";
+}
+
+bool CaptureAdmission::parsePolicy(const std::string& name, Policy& policy) {
+    for (size_t i = 0; i < POLICIES; ++i) {
+        if (name == policyName(static_cast<Policy>(i))) {
+            policy = static_cast<Policy>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void CaptureAdmission::worker() {
+    while (true) {
+        Pending next;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_queue.empty()) {
+                m_busy = false;
+                m_idle.notify_all();
+                return;
+            }
+            next = std::move(m_queue.front());
+            m_queue.pop_front();
+
+            m_lastStartNs = nowNs();
+            int64_t waitNs = m_lastStartNs - next.requestedNs;
+            m_started++;
+            m_totalWaitNs += waitNs;
+            m_maxWaitNs = std::max(m_maxWaitNs, waitNs);
+        }
+
+        // A stopped camera returns at once, the queue drains with failures
+        m_pipeline.capture(std::move(next.waiters));
+    }
+}
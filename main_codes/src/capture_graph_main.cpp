@@ -0,0 +1,232 @@
+#include "camera.h"
+#include "capture_admission.h"
+#include "event_bus.h"
+#include "event_loop.h"
+#include "feed_flow.h"
+#include "feeder.h"
+#include "frame_pipeline.h"
+#include "image_processor.h"
+#include "motion_trigger.h"
+#include "motor_profile.h"
+#include "pir_sensor.h"
+#include "video_motion.h"
+#include "worker_pool.h"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+/**
+ * Capture graph test
+ *
+ * Builds the one capture graph the fish monitor runs (motion trigger, feed
+ * flow, capture admission, frame pipeline) with libcamera-still replaced by a
+ * script that copies a prepared image and counts its runs. Fires triggers
+ * through the motion trigger and checks that each one took exactly one
+ * capture and one detection, also when the PIR sensor and camera motion both
+ * report the same movement. Exits non-zero on a mismatch.
+ */
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Options {
+    int triggers = 5;
+    int captureMs = 200; // How long the stub capture takes
+};
+
+struct Counts {
+    uint64_t triggers;
+    uint64_t captures;
+    uint64_t stubRuns;
+    uint64_t detections;
+};
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Stand-in for libcamera-still, first on the PATH
+bool installStub(const fs::path& dir, const Options& options) {
+    fs::path image = dir / "template.jpg";
+    cv::Mat frame(480, 640, CV_8UC3, cv::Scalar(96, 128, 96));
+    if (!cv::imwrite(image.string(), frame)) {
+        std::cerr << "Cannot write " << image << std::endl;
+        return false;
+    }
+
+    fs::path stub = dir / "libcamera-still";
+    std::ofstream script(stub);
+    script << "#!/bin/sh\n"
+           << "while [ $# -gt 0 ]; do\n"
+           << "    if [ \"$1\" = \"-o\" ]; then out=\"$2\"; fi\n"
+           << "    shift\n"
+           << "done\n"
+           << "echo run >> " << (dir / "runs") << "\n"
+           << "sleep " << options.captureMs / 1000.0 << "\n"
+           << "cp " << image << " \"$out\"\n";
+    script.close();
+    if (!script) {
+        std::cerr << "Cannot write " << stub << std::endl;
+        return false;
+    }
+    fs::permissions(stub, fs::perms::owner_all, fs::perm_options::add);
+
+    const char* path = std::getenv("PATH");
+    std::string searched = dir.string() + ":" + (path ? path : "/usr/bin:/bin");
+    setenv("PATH", searched.c_str(), 1);
+    return true;
+}
+
+uint64_t stubRuns(const fs::path& dir) {
+    std::ifstream runs(dir / "runs");
+    std::string line;
+    uint64_t count = 0;
+    while (std::getline(runs, line)) {
+        count++;
+    }
+    return count;
+}
+
+// Until no flow is in flight and the pipeline has drained
+bool waitIdle(FeedFlow& flow, FramePipeline& pipeline, int timeoutMs) {
+    int64_t deadline = nowNs() + timeoutMs * 1000000LL;
+    while (nowNs() < deadline) {
+        bool idle = flow.stats().inFlight == 0;
+        for (const auto& stage : pipeline.stats()) {
+            idle = idle && stage.queued == 0;
+        }
+        if (idle) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+bool check(const std::string& name, const Counts& before, const Counts& after, uint64_t expected) {
+    uint64_t triggers = after.triggers - before.triggers;
+    uint64_t captures = after.captures - before.captures;
+    uint64_t runs = after.stubRuns - before.stubRuns;
+    uint64_t detections = after.detections - before.detections;
+    bool ok = triggers == expected && captures == triggers && runs == triggers && detections == triggers;
+    std::cout << (ok ? "ok   " : "FAIL ") << name << ": " << triggers << " triggers, " << captures
+              << " captures, " << runs << " libcamera-still runs, " << detections << " detections" << std::endl;
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--triggers" && i + 1 < argc) {
+            options.triggers = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--capture-ms" && i + 1 < argc) {
+            options.captureMs = std::max(0, std::atoi(argv[++i]));
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--triggers N] [--capture-ms MS]" << std::endl;
+            return 1;
+        }
+    }
+
+    // Archived images go to ../archive, keep them out of the tree
+    fs::path dir = fs::temp_directory_path() / ("capture_graph_test_" + std::to_string(getpid()));
+    fs::create_directories(dir / "run");
+    fs::create_directories(dir / "archive");
+    fs::current_path(dir / "run");
+    if (!installStub(dir, options)) {
+        return 1;
+    }
+
+    bool ok = true;
+    {
+        EventLoop loop;
+        std::thread loopThread([&loop]() { loop.run(); });
+        WorkerPool pool(WorkerPool::defaultSize());
+        EventBus bus(pool);
+
+        Camera camera(bus, "image", (dir / "run" / "fish_detection.jpg").string(), 640, 480);
+        VideoMotionDetector video(camera, bus);
+        MotionTriggerConfig triggerConfig;
+        triggerConfig.fuseWindowMs = 1000;
+        MotionTrigger trigger(bus, video, triggerConfig);
+        ImageProcessor imageProcessor(bus, "", "detection");
+        MotorProfileLibrary profiles;
+        FeederBankConfig feederConfig;
+        feederConfig.chipPath = ""; // Simulated, fish or not nothing turns
+        Feeder feeder(bus, feederConfig, &profiles);
+        FramePipeline pipeline(camera, imageProcessor, feeder);
+        CaptureAdmission capture(camera, pipeline, pool);
+        FeedFlow flow(loop, pool, capture, pipeline, feeder, nullptr);
+
+        // Wired as in the fish monitor; detections fan out to every other
+        // consumer instead of each running a camera of its own
+        std::atomic<uint64_t> detections{0};
+        Subscriptions subscriptions;
+        subscriptions.add(bus.topic<MotionTrigger::TriggerEvent>("trigger"), "test", Delivery::Inline,
+                          [&flow](const MotionTrigger::TriggerEvent&) { flow.trigger(); });
+        subscriptions.add(bus.topic<ImageProcessor::DetectionEvent>("detection"), "test", Delivery::Inline,
+                          [&detections](const ImageProcessor::DetectionEvent&) { detections++; });
+
+        // The video detector isn't started, camera motion is reported by hand
+        Topic<PirSensor::MotionEvent>& pirMotion = bus.topic<PirSensor::MotionEvent>("motion");
+        Topic<VideoMotionDetector::MotionEvent>& videoMotion =
+            bus.topic<VideoMotionDetector::MotionEvent>("video_motion");
+        camera.start();
+
+        auto counts = [&]() {
+            return Counts{ trigger.stats().triggers, camera.stats().captures, stubRuns(dir), detections.load() };
+        };
+        int timeoutMs = options.captureMs + 10000;
+        unsigned long seqno = 0;
+
+        // One PIR report per trigger
+        Counts before = counts();
+        for (int i = 0; i < options.triggers && ok; ++i) {
+            pirMotion.publish({ static_cast<uint64_t>(nowNs()), 17, ++seqno });
+            ok = waitIdle(flow, pipeline, timeoutMs);
+        }
+        ok = check("pir", before, counts(), options.triggers) && ok;
+
+        // Both sources see the same movement, one trigger and one capture
+        trigger.setMode(MotionTrigger::Mode::Fused);
+        before = counts();
+        for (int i = 0; i < options.triggers && ok; ++i) {
+            pirMotion.publish({ static_cast<uint64_t>(nowNs()), 17, ++seqno });
+            videoMotion.publish({ static_cast<uint64_t>(nowNs()), 5.0 });
+            ok = waitIdle(flow, pipeline, timeoutMs);
+        }
+        ok = check("pir and camera", before, counts(), options.triggers) && ok;
+
+        // Camera motion alone in pir mode starts nothing
+        trigger.setMode(MotionTrigger::Mode::Pir);
+        before = counts();
+        videoMotion.publish({ static_cast<uint64_t>(nowNs()), 5.0 });
+        ok = waitIdle(flow, pipeline, timeoutMs) && ok;
+        ok = check("ignored", before, counts(), 0) && ok;
+
+        subscriptions.clear();
+        flow.stop();
+        pool.stop();
+        pipeline.stop();
+        bus.stop();
+        loop.stop();
+        loopThread.join();
+    }
+
+    fs::current_path(fs::temp_directory_path());
+    fs::remove_all(dir);
+    std::cout << (ok ? "All captures matched their triggers" : "Captures didn't match the triggers") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,250 @@
+#include "command_queue.h"
+#include "realtime.h"
+#include <chrono>
+#include <exception>
+#include <iostream>
+
+// Waiting commands per lane, a client retrying faster than the motors turn is refused
+static const size_t MAX_QUEUED = 16;
+
+// Finished commands kept for status lookups
+static const size_t MAX_FINISHED = 64;
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+CommandQueue::CommandQueue(WorkerPool& pool, Listener listener)
+    : m_pool(pool),
+      m_listener(std::move(listener)),
+      m_busy{ false, false },
+      m_notifying(false),
+      m_stopped(false),
+      m_nextId(0),
+      m_running(0),
+      m_submitted(0),
+      m_rejected(0),
+      m_done(0),
+      m_failed(0),
+      m_started(0),
+      m_totalWaitNs(0),
+      m_totalRunNs(0),
+      m_motor(&CommandQueue::motorThread, this) {
+}
+
+CommandQueue::~CommandQueue() {
+    stop();
+}
+
+uint64_t CommandQueue::submit(const std::string& name, Lane lane, Job job) {
+    size_t index = static_cast<size_t>(lane);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_queues[index].size() >= MAX_QUEUED) {
+        m_rejected++;
+        return 0;
+    }
+    uint64_t id = ++m_nextId;
+    Entry& entry = m_commands[id];
+    entry.command = { id, name, lane, State::Queued, std::string(), std::string(), std::time(nullptr), 0.0, 0.0 };
+    entry.job = std::move(job);
+    entry.queuedNs = nowNs();
+    entry.startedNs = 0;
+    m_queues[index].push_back(id);
+    m_submitted++;
+    changed(entry.command);
+
+    if (m_stopped) {
+        m_queues[index].pop_back();
+        finish(entry, false, "Command queue stopped");
+    } else if (lane == Lane::Motor) {
+        m_motorWork.notify_one();
+    } else if (!m_busy[index]) {
+        m_busy[index] = m_pool.submit([this, lane]() { worker(lane); });
+        if (!m_busy[index]) {
+            m_queues[index].pop_back();
+            finish(entry, false, "Worker pool stopped");
+        }
+    }
+    notify(lock);
+    return id;
+}
+
+void CommandQueue::stop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_stopped = true;
+    for (auto& queue : m_queues) {
+        for (uint64_t id : queue) {
+            finish(m_commands[id], false, "Cancelled");
+        }
+        queue.clear();
+    }
+    m_motorWork.notify_one();
+    notify(lock);
+    m_idle.wait(lock, [this]() { return !m_busy[0] && !m_busy[1] && !m_notifying; });
+    lock.unlock();
+    if (m_motor.joinable()) {
+        m_motor.join();
+    }
+}
+
+bool CommandQueue::find(uint64_t id, Command& command) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_commands.find(id);
+    if (it == m_commands.end()) {
+        return false;
+    }
+    command = it->second.command;
+    return true;
+}
+
+std::vector<CommandQueue::Command> CommandQueue::recent() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<Command> commands;
+    commands.reserve(m_commands.size());
+    for (auto it = m_commands.rbegin(); it != m_commands.rend(); ++it) {
+        commands.push_back(it->second.command);
+    }
+    return commands;
+}
+
+CommandQueue::Stats CommandQueue::stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats stats;
+    stats.queued = m_queues[0].size() + m_queues[1].size();
+    stats.running = m_running;
+    stats.submitted = m_submitted;
+    stats.rejected = m_rejected;
+    stats.done = m_done;
+    stats.failed = m_failed;
+    stats.avgWaitMs = m_started ? m_totalWaitNs / 1e6 / m_started : 0.0;
+    uint64_t ran = m_started - m_running;
+    stats.avgRunMs = ran ? m_totalRunNs / 1e6 / ran : 0.0;
+    return stats;
+}
+
+const char* CommandQueue::laneName(Lane lane) {
+    switch (lane) {
+    case Lane::Motor: return "motor";
+    case Lane::Control: return "control";
+    }
+    return "unknown";
+}
+
+const char* CommandQueue::stateName(State state) {
+    switch (state) {
+    case State::Queued: return "queued";
+    case State::Running: return "running";
+    case State::Done: return "done";
+    case State::Failed: return "failed";
+    }
+    return "unknown";
+}
+
+void CommandQueue::worker(Lane lane) {
+    size_t index = static_cast<size_t>(lane);
+    for (;;) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_queues[index].empty()) {
+            m_busy[index] = false;
+            m_idle.notify_all();
+            return;
+        }
+        uint64_t id = m_queues[index].front();
+        m_queues[index].pop_front();
+        Entry& entry = m_commands[id];
+        entry.startedNs = nowNs();
+        entry.command.state = State::Running;
+        entry.command.waitMs = (entry.startedNs - entry.queuedNs) / 1e6;
+        m_started++;
+        m_totalWaitNs += entry.startedNs - entry.queuedNs;
+        m_running++;
+        Job job = std::move(entry.job);
+        changed(entry.command);
+        notify(lock);
+        lock.unlock();
+
+        std::string error;
+        std::string result;
+        bool ok;
+        try {
+            ok = job(error, result);
+        } catch (const std::exception& e) {
+            ok = false;
+            error = e.what();
+        } catch (...) {
+            ok = false;
+            error = "Unknown exception";
+        }
+
+        lock.lock();
+        // Still there, only finished commands are forgotten
+        Entry& done = m_commands[id];
+        m_running--;
+        m_totalRunNs += nowNs() - done.startedNs;
+        finish(done, ok, error, result);
+        notify(lock);
+    }
+}
+
+void CommandQueue::motorThread() {
+    realtime::applyThreadPolicy(realtime::ThreadRole::Main); // Motor::play raises itself while it plays
+    size_t index = static_cast<size_t>(Lane::Motor);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        m_motorWork.wait(lock, [this, index]() { return m_stopped || !m_queues[index].empty(); });
+        if (m_queues[index].empty()) {
+            return; // Stopped
+        }
+        m_busy[index] = true;
+        lock.unlock();
+        worker(Lane::Motor);
+        lock.lock();
+    }
+}
+
+void CommandQueue::finish(Entry& entry, bool ok, const std::string& error, const std::string& result) {
+    Command& command = entry.command;
+    command.state = ok ? State::Done : State::Failed;
+    command.error = ok ? std::string() : (error.empty() ? "Failed" : error);
+    command.result = result;
+    if (entry.startedNs > 0) {
+        command.runMs = (nowNs() - entry.startedNs) / 1e6;
+    }
+    entry.job = nullptr;
+    changed(command);
+    if (ok) {
+        m_done++;
+    } else {
+        m_failed++;
+        std::cerr << "Command " << command.id << " (" << command.name << ") failed: " << command.error << std::endl;
+    }
+
+    m_finished.push_back(command.id);
+    while (m_finished.size() > MAX_FINISHED) {
+        m_commands.erase(m_finished.front());
+        m_finished.pop_front();
+    }
+}
+
+void CommandQueue::changed(const Command& command) {
+    if (m_listener) {
+        m_changes.push_back(command);
+    }
+}
+
+void CommandQueue::notify(std::unique_lock<std::mutex>& lock) {
+    if (m_notifying) {
+        return; // The thread delivering now takes these too
+    }
+    m_notifying = true;
+    while (!m_changes.empty()) {
+        Command command = std::move(m_changes.front());
+        m_changes.pop_front();
+        lock.unlock();
+        m_listener(command);
+        lock.lock();
+    }
+    m_notifying = false;
+    m_idle.notify_all();
+}
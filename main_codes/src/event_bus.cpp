@@ -0,0 +1,58 @@
+#include "event_bus.h"
+
+const char* deliveryName(Delivery delivery) {
+    switch (delivery) {
+    case Delivery::Inline:
+        return "inline";
+    case Delivery::Dedicated:
+        return "dedicated";
+    case Delivery::Pool:
+        return "pool";
+    }
+    return "unknown";
+}
+
+void DeliveryCounters::queued(size_t depth) {
+    size_t max = maxDepth.load();
+    while (depth > max && !maxDepth.compare_exchange_weak(max, depth)) {
+    }
+}
+
+void DeliveryCounters::record(int64_t latencyNs) {
+    delivered++;
+    totalLatencyNs += latencyNs;
+    int64_t max = maxLatencyNs.load();
+    while (latencyNs > max && !maxLatencyNs.compare_exchange_weak(max, latencyNs)) {
+    }
+}
+
+TopicBase::TopicBase(EventBus& bus, const std::string& name)
+    : m_bus(bus),
+      m_name(name),
+      m_published(0),
+      m_dropped(0) {
+}
+
+EventBus::EventBus(WorkerPool& pool) : m_pool(pool), m_running(true) {
+}
+
+EventBus::~EventBus() {
+    stop();
+}
+
+void EventBus::stop() {
+    m_running = false;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& topic : m_topics) {
+        topic.second->stop();
+    }
+}
+
+std::vector<TopicStats> EventBus::stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<TopicStats> stats;
+    for (const auto& topic : m_topics) {
+        stats.push_back(topic.second->stats());
+    }
+    return stats;
+}
@@ -0,0 +1,197 @@
+#include "event_loop.h"
+#include "realtime.h"
+#include <cerrno>
+#include <csignal>
+#include <iostream>
+#include <pthread.h>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+static const int MAX_EVENTS = 16;
+
+EventLoop::EventLoop()
+    : m_epollFd(epoll_create1(EPOLL_CLOEXEC)),
+      m_wakeupFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      m_signalFd(-1),
+      m_running(false),
+      m_wakeups(0) {
+    if (m_epollFd < 0 || m_wakeupFd < 0) {
+        throw std::runtime_error("Failed to create event loop");
+    }
+    add(m_wakeupFd, EPOLLIN, [this](uint32_t) {
+        uint64_t value;
+        ssize_t r = read(m_wakeupFd, &value, sizeof(value));
+        (void)r;
+        drainPosted();
+    });
+}
+
+EventLoop::~EventLoop() {
+    if (m_signalFd >= 0) {
+        close(m_signalFd);
+    }
+    close(m_wakeupFd);
+    close(m_epollFd);
+}
+
+bool EventLoop::add(int fd, uint32_t events, Handler handler) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    epoll_event event = {};
+    event.events = events;
+    event.data.fd = fd;
+    if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        std::cerr << "Failed to watch fd " << fd << " in event loop" << std::endl;
+        return false;
+    }
+    m_handlers[fd] = std::make_shared<Handler>(std::move(handler));
+    return true;
+}
+
+bool EventLoop::rearm(int fd, uint32_t events) {
+    epoll_event event = {};
+    event.events = events;
+    event.data.fd = fd;
+    return epoll_ctl(m_epollFd, EPOLL_CTL_MOD, fd, &event) == 0;
+}
+
+void EventLoop::remove(int fd) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_handlers.erase(fd) > 0) {
+        epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    }
+}
+
+int EventLoop::addTimer(std::function<void()> callback) {
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "Failed to create timer" << std::endl;
+        return -1;
+    }
+    bool added = add(fd, EPOLLIN, [fd, callback](uint32_t) {
+        uint64_t expirations;
+        if (read(fd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+            callback(); // Overruns are collapsed into one call
+        }
+    });
+    if (!added) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool EventLoop::armTimer(int timer, int64_t delayNs, int64_t intervalNs) {
+    itimerspec spec = {};
+    spec.it_value = { static_cast<time_t>(delayNs / 1000000000), static_cast<long>(delayNs % 1000000000) };
+    spec.it_interval = { static_cast<time_t>(intervalNs / 1000000000), static_cast<long>(intervalNs % 1000000000) };
+    return timerfd_settime(timer, 0, &spec, nullptr) == 0;
+}
+
+void EventLoop::removeTimer(int timer) {
+    if (timer >= 0) {
+        remove(timer);
+        close(timer);
+    }
+}
+
+bool EventLoop::addSignals(const std::vector<int>& signals, std::function<void(int)> callback) {
+    sigset_t mask;
+    sigemptyset(&mask);
+    for (int signal : signals) {
+        sigaddset(&mask, signal);
+    }
+    if (m_signalFd >= 0) {
+        std::cerr << "Event loop already handles signals" << std::endl;
+        return false;
+    }
+    m_signalFd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (m_signalFd < 0) {
+        std::cerr << "Failed to create signalfd" << std::endl;
+        return false;
+    }
+    int fd = m_signalFd;
+    return add(fd, EPOLLIN, [fd, callback](uint32_t) {
+        signalfd_siginfo info;
+        while (read(fd, &info, sizeof(info)) == sizeof(info)) {
+            callback(static_cast<int>(info.ssi_signo));
+        }
+    });
+}
+
+void EventLoop::blockSignals(const std::vector<int>& signals) {
+    sigset_t mask;
+    sigemptyset(&mask);
+    for (int signal : signals) {
+        sigaddset(&mask, signal);
+    }
+    pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+}
+
+void EventLoop::post(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_posted.push_back(std::move(job));
+    }
+    uint64_t one = 1;
+    ssize_t r = write(m_wakeupFd, &one, sizeof(one));
+    (void)r;
+}
+
+void EventLoop::run() {
+    // The loop handles PIR edges, so it takes the PIR thread's real-time policy
+    realtime::applyThreadPolicy(realtime::ThreadRole::Pir);
+    std::cout << "Event loop started." << std::endl;
+
+    m_running = true;
+    epoll_event events[MAX_EVENTS];
+    while (m_running) {
+        int count = epoll_wait(m_epollFd, events, MAX_EVENTS, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Event loop wait failed" << std::endl;
+            break;
+        }
+        m_wakeups++;
+
+        for (int i = 0; i < count; ++i) {
+            std::shared_ptr<Handler> handler;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                auto it = m_handlers.find(events[i].data.fd);
+                if (it != m_handlers.end()) {
+                    handler = it->second;
+                }
+            }
+            if (handler) {
+                (*handler)(events[i].events);
+            }
+        }
+    }
+    std::cout << "Event loop stopped." << std::endl;
+}
+
+void EventLoop::stop() {
+    post([this]() { m_running = false; });
+}
+
+size_t EventLoop::watchCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_handlers.size();
+}
+
+void EventLoop::drainPosted() {
+    std::vector<std::function<void()>> jobs;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        jobs.swap(m_posted);
+    }
+    for (auto& job : jobs) {
+        job();
+    }
+}
@@ -0,0 +1,327 @@
+#include "event_stream.h"
+#include <jsoncpp/json/json.h>
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static const int64_t NS_PER_MS = 1000000LL;
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// A browser's GET with its headers fits easily, anything longer isn't one
+static const size_t MAX_REQUEST_BYTES = 8 * 1024;
+
+// X-Accel-Buffering stops nginx from holding events back
+static const char* RESPONSE_HEADERS =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: text/event-stream\r\n"
+    "Cache-Control: no-cache\r\n"
+    "Connection: keep-alive\r\n"
+    "X-Accel-Buffering: no\r\n"
+    "\r\n"
+    "retry: 2000\n\n";
+
+bool EventStreamConfig::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Cannot open event stream config " << path << std::endl;
+        return false;
+    }
+
+    Json::Value root;
+    Json::CharReaderBuilder builder;
+    JSONCPP_STRING err;
+    if (!Json::parseFromStream(builder, file, &root, &err)) {
+        std::cerr << "Error parsing event stream config: " << err << std::endl;
+        return false;
+    }
+
+    socketPath = root.get("socket", socketPath).asString();
+    maxClients = std::max(1, root.get("max_clients", maxClients).asInt());
+    bufferBytes = std::max(4096, root.get("buffer_bytes", bufferBytes).asInt());
+    keepaliveMs = std::max(1000, root.get("keepalive_ms", keepaliveMs).asInt());
+    return true;
+}
+
+EventStream::EventStream(EventLoop& loop, const EventStreamConfig& config)
+    : m_loop(loop),
+      m_config(config),
+      m_socket(-1),
+      m_timer(-1),
+      m_nextClient(0),
+      m_nextEvent(0),
+      m_streaming(0),
+      m_stats() {
+}
+
+EventStream::~EventStream() {
+    stop();
+}
+
+bool EventStream::start(Greeting greeting) {
+    if (m_socket >= 0) {
+        return true;
+    }
+    m_greeting = std::move(greeting);
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (m_config.socketPath.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Event stream socket path too long: " << m_config.socketPath << std::endl;
+        return false;
+    }
+    std::strncpy(address.sun_path, m_config.socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+    m_socket = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_socket < 0) {
+        std::cerr << "Failed to create event stream socket" << std::endl;
+        return false;
+    }
+    unlink(m_config.socketPath.c_str());
+    if (bind(m_socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(m_socket, 64) < 0) {
+        std::cerr << "Failed to open event stream socket " << m_config.socketPath << std::endl;
+        close(m_socket);
+        m_socket = -1;
+        return false;
+    }
+    // The web server runs as another user
+    chmod(m_config.socketPath.c_str(), 0666);
+
+    if (!m_loop.add(m_socket, EPOLLIN, [this](uint32_t) { accept(); })) {
+        close(m_socket);
+        m_socket = -1;
+        return false;
+    }
+    m_timer = m_loop.addTimer([this]() { keepalive(); });
+    m_loop.armTimer(m_timer, m_config.keepaliveMs * NS_PER_MS, m_config.keepaliveMs * NS_PER_MS);
+    std::cout << "Event stream listening on " << m_config.socketPath << std::endl;
+    return true;
+}
+
+void EventStream::stop() {
+    if (m_socket < 0) {
+        return;
+    }
+    m_loop.removeTimer(m_timer);
+    m_timer = -1;
+    m_loop.remove(m_socket);
+    close(m_socket);
+    m_socket = -1;
+    unlink(m_config.socketPath.c_str());
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    while (!m_clients.empty()) {
+        drop(m_clients.begin());
+    }
+}
+
+void EventStream::publish(const std::string& event, const std::string& data) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_streaming == 0) {
+        return;
+    }
+    m_stats.events++;
+    broadcast(format(event, ++m_nextEvent, data));
+}
+
+std::string EventStream::format(const std::string& event, uint64_t id, const std::string& data) {
+    std::string message = "event: " + event + "\n";
+    if (id > 0) {
+        message += "id: " + std::to_string(id) + "\n";
+    }
+    size_t start = 0;
+    while (start <= data.size()) {
+        size_t end = data.find('\n', start);
+        if (end == std::string::npos) {
+            end = data.size();
+        }
+        message += "data: ";
+        message.append(data, start, end - start);
+        message += '\n';
+        start = end + 1;
+    }
+    message += '\n';
+    return message;
+}
+
+EventStream::Stats EventStream::stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats stats = m_stats;
+    stats.clients = m_streaming;
+    return stats;
+}
+
+void EventStream::accept() {
+    for (;;) {
+        int fd = accept4(m_socket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return; // EAGAIN, or the peer gave up before we got to it
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_clients.size() >= static_cast<size_t>(m_config.maxClients)) {
+            m_stats.rejected++;
+            close(fd);
+            continue;
+        }
+        uint64_t id = ++m_nextClient;
+        if (!m_loop.add(fd, EPOLLIN, [this, id](uint32_t events) { handle(id, events); })) {
+            close(fd);
+            continue;
+        }
+        m_clients[id] = { fd, false, false, std::string(), std::string(), 0, nowNs() };
+        m_stats.accepted++;
+    }
+}
+
+void EventStream::handle(uint64_t id, uint32_t events) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_clients.find(id);
+    if (it == m_clients.end()) {
+        return;
+    }
+    Client& client = it->second;
+    if (events & (EPOLLERR | EPOLLHUP)) {
+        drop(it);
+        return;
+    }
+
+    if (events & EPOLLIN) {
+        // Only the request is of interest, anything after it is read and ignored
+        char buffer[1024];
+        for (;;) {
+            ssize_t length = recv(client.fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+            if (length > 0) {
+                if (!client.streaming) {
+                    client.request.append(buffer, length);
+                }
+                continue;
+            }
+            if (length < 0 && errno == EINTR) {
+                continue;
+            }
+            if (length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            }
+            drop(it); // Closed by the client
+            return;
+        }
+
+        if (!client.streaming) {
+            if (client.request.find("\r\n\r\n") != std::string::npos) {
+                client.streaming = true;
+                std::string().swap(client.request);
+                m_streaming++;
+                if (!queue(client, RESPONSE_HEADERS + (m_greeting ? m_greeting() : std::string()))) {
+                    drop(it);
+                    return;
+                }
+            } else if (client.request.size() > MAX_REQUEST_BYTES) {
+                m_stats.rejected++;
+                drop(it);
+                return;
+            }
+        }
+    }
+
+    if ((events & EPOLLOUT) && !flush(client)) {
+        drop(it);
+    }
+}
+
+void EventStream::keepalive() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // A connection still without its request by now isn't a browser that will send one
+    int64_t deadline = nowNs() - m_config.keepaliveMs * NS_PER_MS;
+    for (auto it = m_clients.begin(); it != m_clients.end();) {
+        auto next = std::next(it);
+        if (!it->second.streaming && it->second.acceptedNs <= deadline) {
+            m_stats.rejected++;
+            drop(it);
+        }
+        it = next;
+    }
+    broadcast(": keepalive\n\n");
+}
+
+void EventStream::broadcast(const std::string& message) {
+    for (auto it = m_clients.begin(); it != m_clients.end();) {
+        auto next = std::next(it);
+        if (it->second.streaming && !queue(it->second, message)) {
+            drop(it);
+        }
+        it = next;
+    }
+}
+
+bool EventStream::queue(Client& client, const std::string& message) {
+    if (client.backlog.size() - client.sent + message.size() > static_cast<size_t>(m_config.bufferBytes)) {
+        // Reconnecting costs it the missed events but not the status, the greeting has that
+        m_stats.dropped++;
+        return false;
+    }
+    client.backlog += message;
+    return flush(client);
+}
+
+bool EventStream::flush(Client& client) {
+    while (client.sent < client.backlog.size()) {
+        ssize_t written = send(client.fd, client.backlog.data() + client.sent, client.backlog.size() - client.sent,
+                               MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (written > 0) {
+            client.sent += written;
+            m_stats.bytes += written;
+            continue;
+        }
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        return false;
+    }
+
+    if (client.sent == client.backlog.size()) {
+        client.backlog.clear();
+        client.sent = 0;
+    } else if (client.sent > client.backlog.size() / 2) {
+        client.backlog.erase(0, client.sent);
+        client.sent = 0;
+    }
+
+    // Ask for writability only while there is something left to write
+    bool pending = !client.backlog.empty();
+    if (pending != client.watchingOutput) {
+        uint32_t events = EPOLLIN;
+        if (pending) {
+            events |= EPOLLOUT;
+        }
+        m_loop.rearm(client.fd, events);
+        client.watchingOutput = pending;
+    }
+    return true;
+}
+
+void EventStream::drop(Clients::iterator client) {
+    if (client->second.streaming) {
+        m_streaming--;
+    }
+    m_loop.remove(client->second.fd);
+    close(client->second.fd);
+    m_clients.erase(client);
+}
@@ -0,0 +1,123 @@
+#include "fastcgi_server.h"
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Upper bound for a POST body, commands are small JSON objects
+static const long MAX_POST_BYTES = 64 * 1024;
+
+FastCgiServer::FastCgiServer(EventLoop& loop, WorkerPool& pool)
+    : m_loop(loop),
+      m_pool(pool),
+      m_getCallback(nullptr),
+      m_postCallback(nullptr),
+      m_socket(-1),
+      m_requests(0) {
+}
+
+FastCgiServer::~FastCgiServer() {
+    stop();
+}
+
+bool FastCgiServer::start(GETCallback* getCallback, POSTCallback* postCallback,
+                          const std::string& socketPath) {
+    if (m_socket >= 0) {
+        return true;
+    }
+    m_getCallback = getCallback;
+    m_postCallback = postCallback;
+    m_socketPath = socketPath;
+
+    if (FCGX_Init() != 0) {
+        std::cerr << "Failed to initialise FastCGI" << std::endl;
+        return false;
+    }
+    unlink(socketPath.c_str());
+    m_socket = FCGX_OpenSocket(socketPath.c_str(), 16);
+    if (m_socket < 0) {
+        std::cerr << "Failed to open FastCGI socket " << socketPath << std::endl;
+        return false;
+    }
+    // The web server runs as another user
+    chmod(socketPath.c_str(), 0666);
+
+    // Non-blocking so a connection dropped before accept cannot stall the pool
+    fcntl(m_socket, F_SETFL, fcntl(m_socket, F_GETFL) | O_NONBLOCK);
+
+    if (!m_loop.add(m_socket, EPOLLIN | EPOLLONESHOT, [this](uint32_t) {
+            m_pool.submit([this]() { accept(); });
+        })) {
+        close(m_socket);
+        m_socket = -1;
+        return false;
+    }
+    std::cout << "FastCGI server listening on " << socketPath << std::endl;
+    return true;
+}
+
+void FastCgiServer::stop() {
+    if (m_socket < 0) {
+        return;
+    }
+    m_loop.remove(m_socket);
+    close(m_socket);
+    m_socket = -1;
+    unlink(m_socketPath.c_str());
+}
+
+void FastCgiServer::accept() {
+    int socket = m_socket;
+    if (socket < 0) {
+        return;
+    }
+    FCGX_Request* request = new FCGX_Request;
+    FCGX_InitRequest(request, socket, 0);
+    int accepted = FCGX_Accept_r(request);
+    // Let the loop report the next connection while this one is served
+    m_loop.rearm(socket, EPOLLIN | EPOLLONESHOT);
+
+    if (accepted < 0) {
+        FCGX_Free(request, 0);
+        delete request;
+        return;
+    }
+    handle(request);
+    FCGX_Finish_r(request);
+    delete request;
+}
+
+void FastCgiServer::handle(FCGX_Request* request) {
+    m_requests++;
+    const char* method = FCGX_GetParam("REQUEST_METHOD", request->envp);
+
+    std::string json;
+    if (method && strcmp(method, "POST") == 0 && m_postCallback) {
+        const char* lengthParam = FCGX_GetParam("CONTENT_LENGTH", request->envp);
+        long length = lengthParam ? std::strtol(lengthParam, nullptr, 10) : 0;
+        if (length > MAX_POST_BYTES) {
+            FCGX_FPrintF(request->out, "Status: 413 Payload Too Large\r\nContent-Type: text/plain\r\n\r\n");
+            return;
+        }
+        std::string body(length > 0 ? length : 0, '\0');
+        if (length > 0) {
+            int read = FCGX_GetStr(&body[0], static_cast<int>(length), request->in);
+            body.resize(read > 0 ? read : 0);
+        }
+        json = m_postCallback->postString(body);
+    }
+
+    const char* query = FCGX_GetParam("QUERY_STRING", request->envp);
+    bool get = !method || strcmp(method, "GET") == 0;
+    if (json.empty() && m_getCallback) {
+        json = (get && query && *query) ? m_getCallback->queryJSONString(query) : m_getCallback->getJSONString();
+    }
+    if (json.empty()) {
+        json = "{}";
+    }
+    FCGX_FPrintF(request->out, "Content-Type: application/json\r\n\r\n");
+    FCGX_PutStr(json.data(), static_cast<int>(json.size()), request->out);
+}
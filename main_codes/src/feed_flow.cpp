@@ -0,0 +1,187 @@
+#include "feed_flow.h"
+#include <jsoncpp/json/json.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+static const int64_t NS_PER_MS = 1000000LL;
+
+static const char* STAGE_NAMES[] = { "capture", "detect", "feed" };
+
+bool FeedFlowConfig::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Cannot open feed flow config " << path << std::endl;
+        return false;
+    }
+
+    Json::Value root;
+    Json::CharReaderBuilder builder;
+    JSONCPP_STRING err;
+    if (!Json::parseFromStream(builder, file, &root, &err)) {
+        std::cerr << "Error parsing feed flow config: " << err << std::endl;
+        return false;
+    }
+
+    captureTimeoutMs = std::max(0, root.get("capture_timeout_ms", captureTimeoutMs).asInt());
+    detectTimeoutMs = std::max(0, root.get("detect_timeout_ms", detectTimeoutMs).asInt());
+    feedTimeoutMs = std::max(0, root.get("feed_timeout_ms", feedTimeoutMs).asInt());
+    maxInFlight = std::max(1, root.get("max_in_flight", maxInFlight).asInt());
+    return true;
+}
+
+FeedFlow::FeedFlow(EventLoop& loop, WorkerPool& pool, CaptureAdmission& capture, FramePipeline& pipeline,
+                   Feeder& feeder, FeedScheduler* scheduler, const FeedFlowConfig& config)
+    : m_loop(loop),
+      m_pool(pool),
+      m_capture(capture),
+      m_pipeline(pipeline),
+      m_feeder(feeder),
+      m_scheduler(scheduler),
+      m_config(config),
+      m_running(true),
+      m_triggered(0),
+      m_rejected(0),
+      m_fed(0),
+      m_noFish(0),
+      m_windowed(0),
+      m_lastFedTime(0) {
+}
+
+FeedFlow::~FeedFlow() {
+    stop();
+}
+
+bool FeedFlow::trigger() {
+    m_triggered++;
+    auto cancellation = std::make_shared<Cancellation>();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running || static_cast<int>(m_inFlight.size()) >= m_config.maxInFlight) {
+            m_rejected++;
+            return false;
+        }
+        m_inFlight.insert(cancellation);
+    }
+    run(cancellation).start(m_pool, WorkerPool::Lane::Feeding);
+    return true;
+}
+
+void FeedFlow::stop() {
+    std::set<std::shared_ptr<Cancellation>> inFlight;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+        inFlight = m_inFlight;
+    }
+    for (const auto& cancellation : inFlight) {
+        cancellation->cancel();
+    }
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this]() { return m_inFlight.empty(); });
+}
+
+FeedFlow::Stats FeedFlow::stats() const {
+    Stats stats;
+    stats.triggered = m_triggered;
+    stats.rejected = m_rejected;
+    stats.fed = m_fed;
+    stats.noFish = m_noFish;
+    stats.windowed = m_windowed;
+    stats.lastFedTime = m_lastFedTime;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        stats.inFlight = m_inFlight.size();
+    }
+    for (int stage = 0; stage < STAGES; ++stage) {
+        const StepCounters& counters = m_steps[stage];
+        stats.steps.push_back({ STAGE_NAMES[stage], counters.ok, counters.failed,
+                                counters.timedOut, counters.cancelled });
+    }
+    return stats;
+}
+
+Flow FeedFlow::run(std::shared_ptr<Cancellation> cancellation) {
+    FlowContext context = { m_loop, m_pool, WorkerPool::Lane::Feeding, cancellation };
+
+    StepResult<uint64_t> frame = co_await capture(context);
+    if (record(CAPTURE, frame.status)) {
+        StepResult<ImageProcessor::DetectionEvent> detection = co_await detect(context, frame.value);
+        if (record(DETECT, detection.status)) {
+            if (!detection.value.fishDetected) {
+                m_noFish++;
+            } else if (m_scheduler && m_scheduler->fishDetected()) {
+                m_windowed++;
+            } else {
+                StepResult<bool> fed = co_await feed(context);
+                if (record(FEED, fed.status)) {
+                    m_fed++;
+                    m_lastFedTime = std::time(nullptr);
+                }
+            }
+        }
+    }
+    finished(cancellation);
+}
+
+Step<uint64_t> FeedFlow::capture(const FlowContext& context) {
+    // libcamera-still can't be interrupted, an abandoned capture still
+    // finishes and goes down the pipeline. A shed request fails the step at
+    // once.
+    return Step<uint64_t>(context, m_config.captureTimeoutMs * NS_PER_MS,
+        [this](Step<uint64_t>::Complete complete, const std::atomic<bool>&) {
+            m_capture.request(complete);
+        });
+}
+
+Step<ImageProcessor::DetectionEvent> FeedFlow::detect(const FlowContext& context, uint64_t frame) {
+    // The pipeline's detect stage runs every frame, the step only waits for it
+    using DetectStep = Step<ImageProcessor::DetectionEvent>;
+    return DetectStep(context, m_config.detectTimeoutMs * NS_PER_MS,
+        [this, frame](DetectStep::Complete complete, const std::atomic<bool>&) {
+            m_pipeline.awaitDetection(frame, [complete](bool ok, const ImageProcessor::DetectionEvent& event) {
+                complete(ok, event);
+            });
+        });
+}
+
+Step<bool> FeedFlow::feed(const FlowContext& context) {
+    WorkerPool::Lane lane = context.lane;
+    return Step<bool>(context, m_config.feedTimeoutMs * NS_PER_MS,
+        [this, lane](Step<bool>::Complete complete, const std::atomic<bool>& abandoned) {
+            // A timeout or cancellation sets abandoned, which stops the motors
+            bool queued = m_pool.submit([this, complete, &abandoned]() {
+                bool fed = m_feeder.feed(&abandoned);
+                complete(fed, fed);
+            }, lane);
+            if (!queued) {
+                complete(false, false);
+            }
+        });
+}
+
+bool FeedFlow::record(Stage stage, StepStatus status) {
+    StepCounters& counters = m_steps[stage];
+    switch (status) {
+    case StepStatus::Ok:
+        counters.ok++;
+        return true;
+    case StepStatus::Failed:
+        counters.failed++;
+        break;
+    case StepStatus::TimedOut:
+        counters.timedOut++;
+        break;
+    case StepStatus::Cancelled:
+        counters.cancelled++;
+        break;
+    }
+    std::cerr << "Feed flow " << STAGE_NAMES[stage] << " step " << stepStatusName(status) << std::endl;
+    return false;
+}
+
+void FeedFlow::finished(const std::shared_ptr<Cancellation>& cancellation) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_inFlight.erase(cancellation);
+    m_idle.notify_all();
+}
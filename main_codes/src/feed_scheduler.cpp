@@ -0,0 +1,495 @@
+#include "feed_scheduler.h"
+#include <jsoncpp/json/json.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Overdue one-shot feeds older than this are dropped instead of fired late
+const int64_t ONE_SHOT_GRACE_SECONDS = 15 * 60;
+
+// Larger gaps (suspend, clock change) rebuild the wheel instead of ticking through
+const int64_t MAX_CATCH_UP_TICKS = 3600;
+
+template <size_t N>
+bool parseField(const std::string& field, int min, int max, std::bitset<N>& bits, bool& any) {
+    bits.reset();
+    any = field == "*";
+    std::stringstream ss(field);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        int step = 1;
+        size_t slash = item.find('/');
+        if (slash != std::string::npos) {
+            step = std::stoi(item.substr(slash + 1));
+            item = item.substr(0, slash);
+        }
+        int from = min;
+        int to = max;
+        if (item != "*") {
+            size_t dash = item.find('-');
+            from = std::stoi(item.substr(0, dash));
+            to = dash == std::string::npos ? (slash == std::string::npos ? from : max)
+                                           : std::stoi(item.substr(dash + 1));
+        }
+        if (step < 1 || from < min || to > max || from > to) {
+            return false;
+        }
+        for (int v = from; v <= to; v += step) {
+            bits.set(v);
+        }
+    }
+    return bits.any();
+}
+
+} // namespace
+
+bool CronExpression::parse(const std::string& expression) {
+    std::stringstream ss(expression);
+    std::string minutes, hours, daysOfMonth, months, daysOfWeek, extra;
+    if (!(ss >> minutes >> hours >> daysOfMonth >> months >> daysOfWeek) || (ss >> extra)) {
+        return false;
+    }
+
+    bool any;
+    try {
+        std::bitset<8> dow;
+        if (!parseField(minutes, 0, 59, m_minutes, any) ||
+            !parseField(hours, 0, 23, m_hours, any) ||
+            !parseField(daysOfMonth, 1, 31, m_daysOfMonth, m_anyDayOfMonth) ||
+            !parseField(months, 1, 12, m_months, any) ||
+            !parseField(daysOfWeek, 0, 7, dow, m_anyDayOfWeek)) {
+            return false;
+        }
+        // Both 0 and 7 are Sunday
+        for (int d = 0; d < 7; ++d) {
+            m_daysOfWeek[d] = dow[d] || (d == 0 && dow[7]);
+        }
+    } catch (const std::exception&) {
+        return false;
+    }
+    return true;
+}
+
+std::time_t CronExpression::nextAfter(std::time_t t) const {
+    std::tm tm;
+    localtime_r(&t, &tm);
+    tm.tm_sec = 0;
+    tm.tm_min += 1;
+    const std::time_t limit = t + 366 * 24 * 3600;
+
+    // Skip whole months, days and hours that can't match instead of scanning minutes
+    while (true) {
+        tm.tm_isdst = -1;
+        std::time_t candidate = std::mktime(&tm);
+        if (candidate > limit) {
+            return 0;
+        }
+        if (!m_months[tm.tm_mon + 1]) {
+            tm.tm_mon += 1;
+            tm.tm_mday = 1;
+            tm.tm_hour = 0;
+            tm.tm_min = 0;
+            continue;
+        }
+        // Like cron, a restricted day-of-month and day-of-week match either
+        bool dom = m_daysOfMonth[tm.tm_mday];
+        bool dow = m_daysOfWeek[tm.tm_wday];
+        bool dayMatches = (m_anyDayOfMonth || m_anyDayOfWeek) ? (dom && dow) : (dom || dow);
+        if (!dayMatches) {
+            tm.tm_mday += 1;
+            tm.tm_hour = 0;
+            tm.tm_min = 0;
+            continue;
+        }
+        if (!m_hours[tm.tm_hour]) {
+            tm.tm_hour += 1;
+            tm.tm_min = 0;
+            continue;
+        }
+        if (!m_minutes[tm.tm_min]) {
+            tm.tm_min += 1;
+            continue;
+        }
+        return candidate;
+    }
+}
+
+FeedScheduler::FeedScheduler(EventLoop& loop, EventBus& bus, const std::string& persistPath)
+    : m_loop(loop),
+      m_feedTopic(bus.topic<Entry>("scheduled_feed")),
+      m_persistPath(persistPath),
+      m_running(false),
+      m_timer(-1),
+      m_currentTick(std::time(nullptr)),
+      m_nextId(1) {
+}
+
+FeedScheduler::~FeedScheduler() {
+    stop();
+}
+
+void FeedScheduler::start() {
+    if (m_running) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        load();
+    }
+    m_running = true;
+    m_timer = m_loop.addTimer([this]() { onTimer(); });
+    m_loop.armTimer(m_timer, 1000000000LL, 1000000000LL);
+    std::cout << "Feed scheduler started." << std::endl;
+}
+
+void FeedScheduler::stop() {
+    if (!m_running.exchange(false)) {
+        return;
+    }
+    m_loop.removeTimer(m_timer);
+    m_timer = -1;
+    std::cout << "Feed scheduler stopped." << std::endl;
+}
+
+int FeedScheduler::addOneShot(int delaySeconds, const std::string& profile,
+                              const std::vector<std::string>& feeders) {
+    Entry entry{0, Kind::OneShot, "", std::time(nullptr) + std::max(1, delaySeconds), 0, false, profile, feeders};
+    return add(entry, CronExpression());
+}
+
+int FeedScheduler::addRecurring(const std::string& cron, const std::string& profile,
+                                const std::vector<std::string>& feeders) {
+    CronExpression expression;
+    if (!expression.parse(cron)) {
+        std::cerr << "Invalid cron expression: " << cron << std::endl;
+        return -1;
+    }
+    Entry entry{0, Kind::Recurring, cron, expression.nextAfter(std::time(nullptr)), 0, false, profile, feeders};
+    return add(entry, expression);
+}
+
+int FeedScheduler::addWindow(const std::string& cron, int windowMinutes, const std::string& profile,
+                             const std::vector<std::string>& feeders) {
+    CronExpression expression;
+    if (!expression.parse(cron) || windowMinutes < 1) {
+        std::cerr << "Invalid feed window: " << cron << " for " << windowMinutes << " minutes" << std::endl;
+        return -1;
+    }
+    Entry entry{0, Kind::Window, cron, expression.nextAfter(std::time(nullptr)), windowMinutes, false, profile, feeders};
+    return add(entry, expression);
+}
+
+bool FeedScheduler::cancel(int id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // Wheel references to the entry are dropped when their slot comes up
+    if (m_timers.erase(id) == 0) {
+        return false;
+    }
+    save();
+    return true;
+}
+
+std::vector<FeedScheduler::Entry> FeedScheduler::entries() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<Entry> result;
+    for (const auto& timer : m_timers) {
+        result.push_back(timer.second.entry);
+    }
+    return result;
+}
+
+bool FeedScheduler::fishDetected() {
+    std::vector<Entry> due;
+    bool open = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& timer : m_timers) {
+            if (!timer.second.entry.windowOpen) {
+                continue;
+            }
+            open = true;
+            if (!timer.second.fed) {
+                timer.second.fed = true;
+                due.push_back(timer.second.entry);
+            }
+        }
+    }
+    notify(due);
+    return open;
+}
+
+const char* FeedScheduler::kindName(Kind kind) {
+    switch (kind) {
+        case Kind::OneShot:   return "once";
+        case Kind::Recurring: return "recurring";
+        case Kind::Window:    return "window";
+    }
+    return "unknown";
+}
+
+void FeedScheduler::onTimer() {
+    std::vector<Entry> due;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        int64_t now = std::time(nullptr);
+        if (now - m_currentTick > MAX_CATCH_UP_TICKS || now < m_currentTick) {
+            std::cout << "Clock jumped, rebuilding feed schedule" << std::endl;
+            rebuild(now);
+        }
+
+        while (m_currentTick < now) {
+            tick(due);
+        }
+        if (due.empty()) {
+            return;
+        }
+        save();
+    }
+
+    notify(due);
+}
+
+int FeedScheduler::add(const Entry& entry, const CronExpression& cron) {
+    if (entry.fireAt == 0) {
+        std::cerr << "Cron expression never matches: " << entry.cron << std::endl;
+        return -1;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    int id = m_nextId++;
+    Timer& timer = m_timers[id];
+    timer.entry = entry;
+    timer.entry.id = id;
+    timer.cron = cron;
+    timer.generation = 0;
+    timer.fed = false;
+    schedule(timer);
+    save();
+    std::cout << "Scheduled " << kindName(entry.kind) << " feed " << id << std::endl;
+    return id;
+}
+
+void FeedScheduler::schedule(Timer& timer) {
+    timer.generation++;
+    insert({timer.entry.id, timer.generation}, timer.entry.fireAt);
+}
+
+void FeedScheduler::insert(const TimerRef& ref, int64_t due) {
+    if (due <= m_currentTick) {
+        due = m_currentTick + 1;
+    }
+    int64_t delta = due - m_currentTick;
+    for (int level = 0; level < LEVELS; ++level) {
+        int shift = SLOT_BITS * level;
+        if (delta < (int64_t(1) << (shift + SLOT_BITS)) || level == LEVELS - 1) {
+            // Beyond the top level's range the entry is re-inserted on each cascade
+            int64_t slotTime = std::min(due, m_currentTick + (int64_t(1) << (shift + SLOT_BITS)) - 1);
+            m_wheel[level][(slotTime >> shift) & (SLOTS - 1)].push_back(ref);
+            return;
+        }
+    }
+}
+
+void FeedScheduler::tick(std::vector<Entry>& due) {
+    m_currentTick++;
+
+    // Cascade higher levels whose period just rolled over
+    for (int level = 1; level < LEVELS; ++level) {
+        int shift = SLOT_BITS * level;
+        if ((m_currentTick & ((int64_t(1) << shift) - 1)) != 0) {
+            break;
+        }
+        std::vector<TimerRef> refs;
+        refs.swap(m_wheel[level][(m_currentTick >> shift) & (SLOTS - 1)]);
+        for (const auto& ref : refs) {
+            auto it = m_timers.find(ref.id);
+            if (it == m_timers.end() || it->second.generation != ref.generation) {
+                continue;
+            }
+            if (it->second.entry.fireAt <= m_currentTick) {
+                // Due this very tick, the level 0 slot is processed below
+                m_wheel[0][m_currentTick & (SLOTS - 1)].push_back(ref);
+            } else {
+                insert(ref, it->second.entry.fireAt);
+            }
+        }
+    }
+
+    std::vector<TimerRef> refs;
+    refs.swap(m_wheel[0][m_currentTick & (SLOTS - 1)]);
+    for (const auto& ref : refs) {
+        auto it = m_timers.find(ref.id);
+        if (it == m_timers.end() || it->second.generation != ref.generation) {
+            continue; // Cancelled or rescheduled
+        }
+        if (it->second.entry.fireAt <= m_currentTick) {
+            fire(it->second, due);
+        } else {
+            insert(ref, it->second.entry.fireAt);
+        }
+    }
+}
+
+void FeedScheduler::fire(Timer& timer, std::vector<Entry>& due) {
+    Entry& entry = timer.entry;
+    switch (entry.kind) {
+        case Kind::OneShot:
+            due.push_back(entry);
+            m_timers.erase(entry.id);
+            return;
+
+        case Kind::Recurring:
+            due.push_back(entry);
+            entry.fireAt = timer.cron.nextAfter(m_currentTick);
+            break;
+
+        case Kind::Window:
+            if (!entry.windowOpen) {
+                std::cout << "Feed window " << entry.id << " open for " << entry.windowMinutes
+                          << " minutes, waiting for fish" << std::endl;
+                entry.windowOpen = true;
+                timer.fed = false;
+                entry.fireAt = m_currentTick + entry.windowMinutes * 60;
+            } else {
+                if (!timer.fed) {
+                    std::cout << "Feed window " << entry.id << " closed without detection" << std::endl;
+                }
+                entry.windowOpen = false;
+                entry.fireAt = timer.cron.nextAfter(m_currentTick);
+            }
+            break;
+    }
+
+    if (entry.fireAt == 0) {
+        m_timers.erase(entry.id);
+        return;
+    }
+    schedule(timer);
+}
+
+bool FeedScheduler::catchUp(Timer& timer, int64_t now) {
+    Entry& entry = timer.entry;
+    if (entry.fireAt > now) {
+        return true;
+    }
+    if (entry.kind == Kind::OneShot) {
+        // Fired on the next tick if only slightly late
+        return now - entry.fireAt <= ONE_SHOT_GRACE_SECONDS;
+    }
+    // Missed recurring feeds and windows are skipped, not fed all at once
+    entry.windowOpen = false;
+    entry.fireAt = timer.cron.nextAfter(now);
+    return entry.fireAt != 0;
+}
+
+void FeedScheduler::rebuild(int64_t now) {
+    for (auto& level : m_wheel) {
+        for (auto& slot : level) {
+            slot.clear();
+        }
+    }
+    m_currentTick = now;
+    for (auto it = m_timers.begin(); it != m_timers.end();) {
+        if (!catchUp(it->second, now)) {
+            std::cout << "Dropping missed feed " << it->first << std::endl;
+            it = m_timers.erase(it);
+            continue;
+        }
+        schedule(it->second);
+        ++it;
+    }
+}
+
+void FeedScheduler::notify(const std::vector<Entry>& due) {
+    for (const auto& entry : due) {
+        std::cout << "Scheduled feed " << entry.id << " (" << kindName(entry.kind) << ") due" << std::endl;
+        m_feedTopic.publish(entry);
+    }
+}
+
+void FeedScheduler::load() {
+    std::ifstream file(m_persistPath);
+    if (!file) {
+        return; // Nothing scheduled yet
+    }
+
+    Json::Value root;
+    Json::CharReaderBuilder builder;
+    JSONCPP_STRING err;
+    if (!Json::parseFromStream(builder, file, &root, &err)) {
+        std::cerr << "Error parsing feed schedule: " << err << std::endl;
+        return;
+    }
+
+    m_timers.clear();
+    m_nextId = std::max(1, root.get("next_id", 1).asInt());
+    for (const auto& item : root["entries"]) {
+        Timer timer;
+        Entry& entry = timer.entry;
+        entry.id = item["id"].asInt();
+        std::string kind = item["type"].asString();
+        entry.kind = kind == "once" ? Kind::OneShot : kind == "window" ? Kind::Window : Kind::Recurring;
+        entry.cron = item.get("cron", "").asString();
+        entry.fireAt = static_cast<std::time_t>(item["fire_at"].asInt64());
+        entry.windowMinutes = item.get("window_minutes", 0).asInt();
+        entry.windowOpen = false;
+        entry.profile = item.get("profile", "").asString();
+        for (const auto& feeder : item["feeders"]) {
+            entry.feeders.push_back(feeder.asString());
+        }
+        if (entry.kind != Kind::OneShot && !timer.cron.parse(entry.cron)) {
+            std::cerr << "Skipping feed " << entry.id << " with invalid cron: " << entry.cron << std::endl;
+            continue;
+        }
+        timer.generation = 0;
+        timer.fed = false;
+        m_timers[entry.id] = timer;
+        m_nextId = std::max(m_nextId, entry.id + 1);
+    }
+
+    rebuild(std::time(nullptr));
+    std::cout << "Loaded " << m_timers.size() << " scheduled feeds" << std::endl;
+}
+
+void FeedScheduler::save() const {
+    Json::Value root;
+    root["next_id"] = m_nextId;
+    root["entries"] = Json::Value(Json::arrayValue);
+    for (const auto& timer : m_timers) {
+        const Entry& entry = timer.second.entry;
+        Json::Value item;
+        item["id"] = entry.id;
+        item["type"] = kindName(entry.kind);
+        item["cron"] = entry.cron;
+        item["fire_at"] = static_cast<Json::Int64>(entry.fireAt);
+        item["window_minutes"] = entry.windowMinutes;
+        item["profile"] = entry.profile;
+        item["feeders"] = Json::Value(Json::arrayValue);
+        for (const auto& feeder : entry.feeders) {
+            item["feeders"].append(feeder);
+        }
+        root["entries"].append(item);
+    }
+
+    // Write then rename, so a crash never leaves a truncated schedule
+    std::error_code ec;
+    fs::create_directories(fs::path(m_persistPath).parent_path(), ec);
+    std::string tmpPath = m_persistPath + ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::trunc);
+        if (!file) {
+            std::cerr << "Cannot write feed schedule to " << tmpPath << std::endl;
+            return;
+        }
+        Json::StreamWriterBuilder builder;
+        file << Json::writeString(builder, root);
+    }
+    fs::rename(tmpPath, m_persistPath, ec);
+    if (ec) {
+        std::cerr << "Cannot save feed schedule: " << ec.message() << std::endl;
+    }
+}
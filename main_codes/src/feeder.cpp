@@ -5,47 +5,30 @@
 
 namespace fs = std::filesystem;
 
-Feeder::Feeder(int motorPin) {
-    // Create the motor controller
-    if (motorPin >= 0) {  // Negative pins are for testing (no hardware init)
-        m_motor = std::make_unique<Motor>(motorPin);
-        std::cout << "Feeder initialized with motor on pin " << motorPin << std::endl;
-    } else {
-        std::cout << "Feeder initialized in test mode without hardware" << std::endl;
+Feeder::Feeder(EventBus& bus, const FeederBankConfig& config, const MotorProfileLibrary* profiles) {
+    // Create the motor controllers, an empty chip path is for testing (no hardware init)
+    m_bank = std::make_unique<FeederBank>(bus, config, profiles);
+    for (const auto& feeder : config.feeders) {
+        std::cout << "Feeder '" << feeder.name << "' on pin " << feeder.pin
+                  << (feeder.autoFeed ? " (auto)" : "") << std::endl;
     }
 }
 
-void Feeder::fishDetected(const cv::Mat& image) {
-    std::cout << "FISH DETECTED! Activating feeding mechanism..." << std::endl;
-    activateFeeder();
-    saveImage(image, true);
-}
-
-void Feeder::noFishDetected(const cv::Mat& image) {
-    std::cout << "No feeding necessary." << std::endl;
-    saveImage(image, false);
-}
-
-void Feeder::activateFeeder() {
-    if (!m_motor || !m_motor->isInitialized()) {
+bool Feeder::feed(const std::atomic<bool>* abort) {
+    if (!m_bank->isInitialized()) {
         std::cerr << "Cannot activate feeder: Motor not initialized" << std::endl;
-        return;
+        return false;
     }
     
     std::cout << "*** FEEDING MECHANISM ACTIVATED ***" << std::endl;
     
-    // Run motor sequence for feeding
-    std::cout << "Running feeder motor at full speed..." << std::endl;
-    m_motor->run(100, 10, 3000);  // Full speed for 1 second
-    
-    std::cout << "Slowing down feeder motor..." << std::endl;
-    m_motor->run(50, 10, 500);    // Half speed for 0.5 seconds
-    
-    std::cout << "Stopping feeder motor..." << std::endl;
-    m_motor->stop();
+    // Run each automatic feeder with its own profile
+    bool fed = m_bank->feedAuto(abort);
+    std::cout << "Feeder motors stopped" << std::endl;
+    return fed;
 }
 
-void Feeder::saveImage(const cv::Mat& image, bool fishDetected) {
+bool Feeder::saveImage(const cv::Mat& image, bool fishDetected) {
     // Create archive directory if it doesn't exist
     if (!fs::exists("../archive")) {
         fs::create_directory("../archive");
@@ -64,6 +47,10 @@ void Feeder::saveImage(const cv::Mat& image, bool fishDetected) {
     std::string filename = "../archive/" + prefix + timestamp + ".jpg";
     
     // Save image
-    cv::imwrite(filename, image);
+    if (!cv::imwrite(filename, image)) {
+        std::cerr << "Failed to save image to: " << filename << std::endl;
+        return false;
+    }
     std::cout << "Image saved to: " << filename << std::endl;
+    return true;
 }
@@ -0,0 +1,285 @@
+#include "feeder_bank.h"
+#include "realtime.h"
+#include <jsoncpp/json/json.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+// Abort latency while a feed plays
+static const int64_t ABORT_POLL_NS = 20 * 1000000LL;
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool FeederBankConfig::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Cannot open feeder config " << path << std::endl;
+        return false;
+    }
+
+    Json::Value root;
+    Json::CharReaderBuilder builder;
+    JSONCPP_STRING err;
+    if (!Json::parseFromStream(builder, file, &root, &err)) {
+        std::cerr << "Error parsing feeder config: " << err << std::endl;
+        return false;
+    }
+
+    std::vector<Feeder> loaded;
+    for (const auto& entry : root["feeders"]) {
+        Feeder feeder;
+        feeder.name = entry.get("name", "feeder" + std::to_string(loaded.size())).asString();
+        feeder.pin = entry.get("pin", -1).asInt();
+        feeder.autoFeed = entry.get("auto", true).asBool();
+        feeder.profile = entry.get("profile", "").asString();
+        if (feeder.pin < 0) {
+            std::cerr << "Feeder " << feeder.name << " has no pin" << std::endl;
+            return false;
+        }
+        loaded.push_back(feeder);
+    }
+    if (loaded.empty() || loaded.size() > FeederBank::MAX_FEEDERS) {
+        std::cerr << "Feeder config needs 1 to " << FeederBank::MAX_FEEDERS << " feeders" << std::endl;
+        return false;
+    }
+
+    feeders = loaded;
+    chipPath = root.get("chip", chipPath).asString();
+    staggered = root.get("mode", staggered ? "staggered" : "concurrent").asString() == "staggered";
+    staggerMs = std::max(0, root.get("stagger_ms", staggerMs).asInt());
+    std::cout << "Loaded " << feeders.size() << " feeders from " << path << std::endl;
+    return true;
+}
+
+FeederBank::FeederBank(EventBus& bus, const FeederBankConfig& config, const MotorProfileLibrary* profiles)
+    : m_feedTopic(bus.topic<FeedEvent>("feed")),
+      m_config(config),
+      m_profiles(profiles),
+      m_request(nullptr),
+      m_gpioInitialized(false),
+      m_simulated(config.chipPath.empty()),
+      m_levels(0),
+      m_values(config.feeders.size(), GPIOD_LINE_VALUE_INACTIVE) {
+
+    for (const auto& feeder : m_config.feeders) {
+        m_stats.push_back({feeder.name, feeder.pin, 0, 0, 0, false});
+    }
+
+    if (m_simulated) {
+        m_gpioInitialized = true;
+        std::cout << "Feeder bank simulated with " << size() << " feeders" << std::endl;
+        return;
+    }
+
+    std::vector<unsigned int> offsets;
+    for (const auto& feeder : m_config.feeders) {
+        offsets.push_back(static_cast<unsigned int>(feeder.pin));
+    }
+
+    // All motor lines in one request, so they can be written with one syscall
+    gpio::LineSettings settings;
+    settings.output = true;
+    m_request = gpio::requestLines(m_config.chipPath, offsets, settings, "feeder_bank");
+    if (!m_request) {
+        std::cerr << "Failed to request GPIO lines as outputs for feeder bank!" << std::endl;
+        return;
+    }
+
+    m_gpioInitialized = true;
+    std::cout << "Feeder bank initialized with " << size() << " feeders" << std::endl;
+}
+
+FeederBank::~FeederBank() {
+    stop();
+    if (m_request) {
+        gpiod_line_request_release(m_request);
+    }
+}
+
+bool FeederBank::feed(const std::vector<int>& indices, const std::string& profile, bool staggered,
+                      const std::atomic<bool>* abort) {
+    if (!m_profiles) {
+        std::cerr << "Cannot feed: no feed profiles" << std::endl;
+        return false;
+    }
+
+    std::vector<Playback> playbacks;
+    uint64_t feeders = 0;
+    int64_t offsetNs = 0;
+    for (int index : indices) {
+        if (index < 0 || index >= static_cast<int>(size())) {
+            std::cerr << "Unknown feeder index: " << index << std::endl;
+            return false;
+        }
+        if (feeders & (1ULL << index)) {
+            // Two timelines on one line would fight over its edges
+            std::cerr << "Duplicate feeder: " << m_config.feeders[index].name << std::endl;
+            return false;
+        }
+        const std::string& name = profile.empty() ? m_config.feeders[index].profile : profile;
+        const EdgeTimeline* timeline = m_profiles->timeline(name);
+        if (!timeline) {
+            std::cerr << "Unknown feed profile: " << name << std::endl;
+            return false;
+        }
+        playbacks.push_back({index, timeline, offsetNs});
+        feeders |= 1ULL << index;
+        if (staggered) {
+            offsetNs += m_config.staggerMs * 1000000LL;
+        }
+    }
+    if (playbacks.empty() || !m_gpioInitialized) {
+        // No motor turns, nothing to announce
+        return playMerged(playbacks, abort);
+    }
+    m_feedTopic.publish({ static_cast<uint64_t>(nowNs()), feeders, true, false });
+    bool fed = playMerged(playbacks, abort);
+    m_feedTopic.publish({ static_cast<uint64_t>(nowNs()), feeders, false, fed });
+    return fed;
+}
+
+bool FeederBank::feedAuto(const std::atomic<bool>* abort) {
+    return feed(autoFeeders(), "", m_config.staggered, abort);
+}
+
+bool FeederBank::play(int index, const EdgeTimeline& timeline) {
+    if (index < 0 || index >= static_cast<int>(size())) {
+        std::cerr << "Unknown feeder index: " << index << std::endl;
+        return false;
+    }
+    return playMerged({{index, &timeline, 0}});
+}
+
+void FeederBank::stop() {
+    std::lock_guard<std::mutex> playLock(m_playMutex);
+    if (m_gpioInitialized) {
+        writeLevels(0);
+    }
+}
+
+int FeederBank::indexOf(const std::string& name) const {
+    for (size_t i = 0; i < m_config.feeders.size(); ++i) {
+        if (m_config.feeders[i].name == name) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+std::vector<int> FeederBank::autoFeeders() const {
+    std::vector<int> indices;
+    for (size_t i = 0; i < m_config.feeders.size(); ++i) {
+        if (m_config.feeders[i].autoFeed) {
+            indices.push_back(static_cast<int>(i));
+        }
+    }
+    return indices;
+}
+
+std::vector<FeederBank::FeederStats> FeederBank::stats() const {
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    return m_stats;
+}
+
+bool FeederBank::playMerged(const std::vector<Playback>& playbacks, const std::atomic<bool>* abort) {
+    if (!m_gpioInitialized) {
+        std::cerr << "Cannot run feeders: GPIO not initialized" << std::endl;
+        return false;
+    }
+    if (playbacks.empty()) {
+        return true;
+    }
+
+    // Merging is per feed, playback itself is only deadline sleeps and writes
+    std::vector<BankEdge> edges = merge(playbacks);
+
+    std::lock_guard<std::mutex> playLock(m_playMutex);
+    {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        for (const auto& playback : playbacks) {
+            m_stats[playback.index].running = true;
+        }
+    }
+
+    bool aborted = false;
+    {
+        realtime::ScopedThreadPolicy policy(realtime::ThreadRole::Motor);
+        const int64_t startNs = monotonicNowNs();
+        for (const auto& edge : edges) {
+            const int64_t deadlineNs = startNs + edge.atNs;
+            // Long segments sleep in slices so an abort doesn't wait for the
+            // segment to end, the last slice still lands on the edge exactly
+            while (abort && !*abort && deadlineNs - monotonicNowNs() > ABORT_POLL_NS) {
+                sleepUntilNs(monotonicNowNs() + ABORT_POLL_NS);
+            }
+            if (abort && *abort) {
+                writeLevels(0);
+                aborted = true;
+                break;
+            }
+            sleepUntilNs(deadlineNs);
+            writeLevels((m_levels & ~edge.mask) | (edge.values & edge.mask));
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    if (aborted) {
+        std::cerr << "Feed aborted, motors stopped" << std::endl;
+        for (const auto& playback : playbacks) {
+            m_stats[playback.index].running = false;
+        }
+        return false;
+    }
+    std::time_t now = std::time(nullptr);
+    for (const auto& playback : playbacks) {
+        FeederStats& stats = m_stats[playback.index];
+        stats.running = false;
+        stats.feedCount++;
+        stats.lastFeedTime = now;
+        stats.runTimeMs += playback.timeline->durationNs / 1000000;
+    }
+    return true;
+}
+
+std::vector<FeederBank::BankEdge> FeederBank::merge(const std::vector<Playback>& playbacks) {
+    struct LineEdge {
+        int64_t atNs;
+        int index;
+        int value;
+    };
+
+    std::vector<LineEdge> lineEdges;
+    for (const auto& playback : playbacks) {
+        for (const auto& edge : playback.timeline->edges) {
+            lineEdges.push_back({playback.offsetNs + edge.atNs, playback.index, edge.value});
+        }
+        lineEdges.push_back({playback.offsetNs + playback.timeline->durationNs, playback.index, 0});
+    }
+    std::stable_sort(lineEdges.begin(), lineEdges.end(),
+                     [](const LineEdge& a, const LineEdge& b) { return a.atNs < b.atNs; });
+
+    std::vector<BankEdge> edges;
+    for (const auto& lineEdge : lineEdges) {
+        if (edges.empty() || edges.back().atNs != lineEdge.atNs) {
+            edges.push_back({lineEdge.atNs, 0, 0});
+        }
+        uint64_t bit = 1ULL << lineEdge.index;
+        edges.back().mask |= bit;
+        edges.back().values = lineEdge.value ? (edges.back().values | bit) : (edges.back().values & ~bit);
+    }
+    return edges;
+}
+
+void FeederBank::writeLevels(uint64_t levels) {
+    m_levels = levels;
+    for (size_t i = 0; i < m_values.size(); ++i) {
+        m_values[i] = ((levels >> i) & 1) ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE;
+    }
+    if (!m_simulated) {
+        gpiod_line_request_set_values(m_request, m_values.data());
+    }
+}
@@ -1,30 +1,295 @@
 #include "fish_api.h"
 #include <jsoncpp/json/json.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <iostream>
 #include <ctime>
 
+// Default span and size of a pH history query
+static const int64_t PH_HISTORY_DEFAULT_SECONDS = 24 * 3600;
+static const size_t PH_HISTORY_DEFAULT_POINTS = 500;
+
+// Counters move all the time, the status is rebuilt at least this often
+static const int64_t SNAPSHOT_REFRESH_NS = 1000 * 1000000LL;
+
+// Status fields that change on their own: the clock, traffic and load
+// counters. Refreshed in every build, but a build that only moves these
+// keeps the version. Dotted names are fields inside a section, applied to
+// every item of an array on the way.
+static const char* const VOLATILE_FIELDS[] = {
+    "current_time",
+    // Whole sections of counters
+    "reactor", "event_bus", "pipeline", "snapshot", "events", "commands", "feed_flow",
+    "ph_sensor", "i2c", "ph_sampler", "ph_history",
+    // Counters next to state: modes, policies, running feeders and feed counts stay
+    "feeders.run_time_ms",
+    "pir.edges", "pir.rising_edges", "pir.glitches", "pir.coalesced", "pir.absorbed", "pir.motions",
+    "pir.reads",
+    "trigger.pir_reports", "trigger.video_reports", "trigger.triggers", "trigger.unconfirmed",
+    "trigger.ignored", "trigger.video",
+    "camera.captures", "camera.failures", "camera.admission.queued", "camera.admission.requests",
+    "camera.admission.avg_wait_ms", "camera.admission.max_wait_ms", "camera.admission.policies"
+};
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Local time as shown on the dashboard, "Never" for 0
+static std::string formatTime(std::time_t time) {
+    if (time <= 0) {
+        return "Never";
+    }
+    std::tm local;
+    char buffer[32];
+    localtime_r(&time, &local);
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &local);
+    return buffer;
+}
+
+// Remove one dotted field, from each item where the path meets an array
+static void removeField(Json::Value& value, const std::string& path) {
+    if (value.isArray()) {
+        for (auto& item : value) {
+            removeField(item, path);
+        }
+        return;
+    }
+    if (!value.isObject()) {
+        return;
+    }
+    size_t dot = path.find('.');
+    if (dot == std::string::npos) {
+        value.removeMember(path);
+        return;
+    }
+    std::string key = path.substr(0, dot);
+    if (value.isMember(key)) {
+        removeField(value[key], path.substr(dot + 1));
+    }
+}
+
+// Status data without its volatile fields
+static Json::Value stableState(const Json::Value& data) {
+    Json::Value state = data;
+    for (const char* field : VOLATILE_FIELDS) {
+        removeField(state, field);
+    }
+    return state;
+}
+
+// key=value pairs of a query string, keys without a value map to ""
+static std::map<std::string, std::string> parseQuery(const std::string& query) {
+    std::map<std::string, std::string> params;
+    size_t start = 0;
+    while (start <= query.size()) {
+        size_t end = query.find('&', start);
+        if (end == std::string::npos) {
+            end = query.size();
+        }
+        std::string pair = query.substr(start, end - start);
+        size_t equals = pair.find('=');
+        if (!pair.empty()) {
+            params[pair.substr(0, equals)] = equals == std::string::npos ? "" : pair.substr(equals + 1);
+        }
+        start = end + 1;
+    }
+    return params;
+}
+
+// Lane a POST command runs on, false if there is no such command
+static bool commandLane(const std::string& command, CommandQueue::Lane& lane) {
+    static const std::map<std::string, CommandQueue::Lane> COMMANDS = {
+        { "run_motor", CommandQueue::Lane::Motor },
+        { "feed_fish", CommandQueue::Lane::Motor },
+        { "schedule_feed", CommandQueue::Lane::Control },
+        { "cancel_schedule", CommandQueue::Lane::Control },
+        { "read_ph", CommandQueue::Lane::Control },
+        { "set_ph_alarm", CommandQueue::Lane::Control },
+        { "init_ph_sensor", CommandQueue::Lane::Control },
+        { "set_auto_mode", CommandQueue::Lane::Control },
+        { "set_trigger_mode", CommandQueue::Lane::Control },
+        { "set_capture_policy", CommandQueue::Lane::Control },
+    };
+    auto it = COMMANDS.find(command);
+    if (it == COMMANDS.end()) {
+        return false;
+    }
+    lane = it->second;
+    return true;
+}
+
+static Json::Value commandJSON(const CommandQueue::Command& command) {
+    Json::Value item;
+    item["id"] = (Json::UInt64)command.id;
+    item["command"] = command.name;
+    item["lane"] = CommandQueue::laneName(command.lane);
+    item["state"] = CommandQueue::stateName(command.state);
+    if (!command.error.empty()) {
+        item["error"] = command.error;
+    }
+    if (!command.result.empty()) {
+        item["result"] = command.result;
+    }
+    item["submitted"] = (Json::Int64)command.submitted;
+    item["wait_ms"] = command.waitMs;
+    item["run_ms"] = command.runMs;
+    return item;
+}
+
+enum class FieldType {
+    Number,
+    String,
+    Bool
+};
+
+// Optional POST fields and their types, checked before a command reads them
+static const std::pair<const char*, FieldType> COMMAND_FIELDS[] = {
+    { "duty_cycle", FieldType::Number },
+    { "duration", FieldType::Number },
+    { "period", FieldType::Number },
+    { "low", FieldType::Number },
+    { "high", FieldType::Number },
+    { "min_interval_ms", FieldType::Number },
+    { "delay", FieldType::Number },
+    { "window_minutes", FieldType::Number },
+    { "id", FieldType::Number },
+    { "profile", FieldType::String },
+    { "mode", FieldType::String },
+    { "policy", FieldType::String },
+    { "type", FieldType::String },
+    { "cron", FieldType::String },
+    { "override", FieldType::Bool },
+    { "enabled", FieldType::Bool },
+};
+
+// False with a message naming the first field of the wrong type
+static bool checkFieldTypes(const Json::Value& root, std::string& error) {
+    for (const auto& [name, type] : COMMAND_FIELDS) {
+        if (!root.isMember(name)) {
+            continue;
+        }
+        const Json::Value& value = root[name];
+        bool ok = type == FieldType::Number ? value.isNumeric()
+                : type == FieldType::String ? value.isString()
+                : value.isBool();
+        if (!ok) {
+            const char* expected = type == FieldType::Number ? "a number"
+                                 : type == FieldType::String ? "a string" : "true or false";
+            error = std::string("'") + name + "' must be " + expected;
+            return false;
+        }
+    }
+    return true;
+}
+
+static std::string failureReply(const std::string& message) {
+    Json::Value root;
+    root["success"] = false;
+    root["message"] = message;
+    Json::StreamWriterBuilder builder;
+    return Json::writeString(builder, root);
+}
+
 // Constructor
-FishAPI::FishAPI(Motor* motor, PHSensor* phSensor, PirSensor* pirSensor)
-    : m_motor(motor),
+FishAPI::FishAPI(FeederBank* feeders, PHSensor* phSensor, PHSampler* phSampler, const PHHistory* phHistory,
+                 PirSensor* pirSensor, MotionTrigger* trigger, CaptureAdmission* capture,
+                 const MotorProfileLibrary* profiles, FeedScheduler* scheduler,
+                 const FeedFlow* flow, const FramePipeline* pipeline, EventLoop& loop, EventBus& bus,
+                 const EventStreamConfig& eventsConfig)
+    : m_feeders(feeders),
+      m_profiles(profiles),
+      m_scheduler(scheduler),
+      m_flow(flow),
+      m_pipeline(pipeline),
       m_phSensor(phSensor),
+      m_phSampler(phSampler),
+      m_phHistory(phHistory),
       m_pirSensor(pirSensor), 
-      m_camera(), // Initialize Camera 
-      m_imageProcessor(),
+      m_trigger(trigger),
+      m_capture(capture),
+      m_loop(loop),
+      m_bus(bus),
+      m_pool(bus.pool()),
       m_running(false),
+      m_server(loop, m_pool),
+      m_events(loop, eventsConfig),
       m_getHandler(this),
       m_postHandler(this),
+      m_commands(m_pool, [this](const CommandQueue::Command& command) { commandChanged(command); }),
       m_fishDetected(false),
       m_feedCount(0),
       m_autoFeedCount(0),
+      m_scheduledFeedCount(0),
       m_lastFeedTime(0),
       m_AutolastFeedTime(0),
       m_autoModeEnabled(true),
-      m_currentPH(0.0f),
-      m_currentPHVoltage(0.0f),
-      m_lastPHReadTime(0) {
-    m_pirSensor->registerCallback(this);
-    m_camera.registerCallback(&m_imageProcessor); // Camera sends images to ImageProcessor
-    m_imageProcessor.registerCallback(this); // ImageProcessor notifies FishAPI
+      m_snapshotVersion(0),
+      m_snapshotPending(false),
+      m_snapshotTimer(-1),
+      m_snapshotBuilds(0),
+      m_snapshotBuildNs(0),
+      m_snapshotServes(0),
+      m_snapshotServeNs(0) {
+    // Writes the last image and opens feed windows, so on the pool
+    m_subscriptions.add(bus.topic<ImageProcessor::DetectionEvent>("detection"), "api", Delivery::Pool,
+                        [this](const ImageProcessor::DetectionEvent& event) {
+                            Json::Value data;
+                            data["fish_detected"] = event.fishDetected;
+                            data["time"] = (Json::Int64)std::time(nullptr);
+                            push("detection", data);
+                            if (event.fishDetected) {
+                                fishDetected(event.image);
+                            } else {
+                                noFishDetected(event.image);
+                            }
+                        });
+    m_subscriptions.add(bus.topic<FeedScheduler::Entry>("scheduled_feed"), "api", Delivery::Pool,
+                        [this](const FeedScheduler::Entry& entry) { scheduledFeed(entry); });
+    // State the status shows, streamed now and rebuilt off the publisher's thread
+    m_subscriptions.add(bus.topic<PHSensor::Sample>("ph"), "api_status", Delivery::Inline,
+                        [this](const PHSensor::Sample& sample) {
+                            Json::Value data;
+                            data["ph"] = sample.pH;
+                            data["voltage"] = sample.voltage;
+                            data["adc_value"] = sample.adcValue;
+                            data["time"] = (Json::Int64)std::time(nullptr);
+                            push("ph", data);
+                            invalidate();
+                        });
+    m_subscriptions.add(bus.topic<PHSensor::AlarmEvent>("ph_alarm"), "api_status", Delivery::Inline,
+                        [this](const PHSensor::AlarmEvent& event) {
+                            Json::Value data;
+                            data["active"] = event.active;
+                            data["ph"] = event.pH;
+                            data["low"] = event.low;
+                            data["high"] = event.high;
+                            data["hardware"] = event.hardware;
+                            data["time"] = (Json::Int64)std::time(nullptr);
+                            push("ph_alarm", data);
+                            invalidate();
+                        });
+    m_subscriptions.add(bus.topic<FeederBank::FeedEvent>("feed"), "api_status", Delivery::Inline,
+                        [this](const FeederBank::FeedEvent& event) {
+                            Json::Value data;
+                            Json::Value names(Json::arrayValue);
+                            std::vector<FeederBank::FeederStats> feeders = m_feeders->stats();
+                            for (size_t i = 0; i < feeders.size(); ++i) {
+                                if (event.feeders & (1ULL << i)) {
+                                    names.append(feeders[i].name);
+                                }
+                            }
+                            data["feeders"] = names;
+                            data["running"] = event.running;
+                            data["completed"] = event.completed;
+                            data["time"] = (Json::Int64)std::time(nullptr);
+                            push("feed", data);
+                            invalidate();
+                        });
+    m_subscriptions.add(bus.topic<MotionTrigger::TriggerEvent>("trigger"), "api_status", Delivery::Inline,
+                        [this](const MotionTrigger::TriggerEvent&) { invalidate(); });
     if (m_phSensor) {
         std::cout << "Initializing pH sensor in FishAPI constructor..." << std::endl;
         if (m_phSensor->initialize()) {
@@ -42,16 +307,21 @@ FishAPI::~FishAPI() {
     stop();
 }
 
-// Start the API in a separate thread
+// Start serving the API from the event loop
 void FishAPI::start() {
     if (!m_running) {
         m_running = true;
-        m_thread = std::thread(&FishAPI::threadFunction, this);
+        publishSnapshot();
+        m_events.start([this]() { return greeting(); });
+        m_snapshotTimer = m_loop.addTimer([this]() { invalidate(); });
+        m_loop.armTimer(m_snapshotTimer, SNAPSHOT_REFRESH_NS, SNAPSHOT_REFRESH_NS);
+        m_server.start(&m_getHandler, &m_postHandler, "/tmp/fish_api.socket");
         if (m_autoModeEnabled) {
             m_pirSensor->start(); 
-            m_camera.start();
+            m_capture->camera().start();
+            m_trigger->start();
         }
-        std::cout << "API thread started" << std::endl;
+        std::cout << "API started" << std::endl;
     }
 }
 
@@ -59,13 +329,15 @@ void FishAPI::start() {
 void FishAPI::stop() {
     if (m_running) {
         m_running = false;
+        m_server.stop();
+        m_commands.stop();
+        m_loop.removeTimer(m_snapshotTimer);
+        m_snapshotTimer = -1;
+        m_events.stop();
         m_pirSensor->stop(); 
-        m_camera.stop();
-        if (m_thread.joinable()) {
-            m_handler.stop();
-            m_thread.join();
-        }
-        std::cout << "API thread stopped" << std::endl;
+        m_trigger->stop();
+        m_capture->camera().stop();
+        std::cout << "API stopped" << std::endl;
     }
 }
 
@@ -73,25 +345,32 @@ void FishAPI::stop() {
 void FishAPI::setFishDetected(bool detected) {
     m_fishDetected = detected;
     std::cout << "Fish detected set to: " << (detected ? "true" : "false") << std::endl;
-    if (detected && m_autoModeEnabled) {
-        feedFish(false); // Trigger automatic feeding only if auto mode is enabled
-    }
+    invalidate();
+    // Feeding is the feed flow's last step, or an open feed window's, never both
 }
 
 // Update last img path
 void FishAPI::setLastImagePath(const std::string& path) {
-    m_lastImagePath = path;
+    {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        m_lastImagePath = path;
+    }
+    invalidate();
 }
 
 //  feeding logic
-void FishAPI::feedFish(bool override) {
+bool FishAPI::feedFish(bool override, const std::string& profile,
+                       const std::vector<int>& feeders, bool staggered) {
     if ((m_autoModeEnabled && m_fishDetected) || override) {
         std::cout << "Feeding fish..." << std::endl;
-        if (m_motor && m_motor->isInitialized()) {
-            m_motor->run(100, 10, 3000);
-            m_motor->run(50, 10, 500);
-            m_motor->stop();
+        if (m_feeders && m_feeders->isInitialized()) {
+            // No feeder given runs the automatic ones, each with its own profile
+            const std::vector<int> indices = feeders.empty() ? m_feeders->autoFeeders() : feeders;
+            if (!m_feeders->feed(indices, profile, staggered)) {
+                return false;
+            }
             // m_lastFeedTime = std::time(nullptr);
+            std::lock_guard<std::mutex> lock(m_stateMutex);
             if (override) {
                 m_feedCount++;
                 m_lastFeedTime = std::time(nullptr);
@@ -99,25 +378,118 @@ void FishAPI::feedFish(bool override) {
                 m_autoFeedCount++;
                 m_AutolastFeedTime = std::time(nullptr);
             }
-        } else {
-            std::cerr << "Motor not initialized" << std::endl;
+            return true;
         }
-    } else {
-        std::cout << "Feed ignored - auto mode disabled or no fish detected and override not set" << std::endl;
+        std::cerr << "Motor not initialized" << std::endl;
+        return false;
     }
+    std::cout << "Feed ignored - auto mode disabled or no fish detected and override not set" << std::endl;
+    return false;
 }
 
-// Motion detection callback from PIR sensor
-void FishAPI::motionDetected(gpiod_line_event event) {
-    if (m_autoModeEnabled) {
-        std::cout << "Motion detected, triggering camera..." << std::endl;
-        m_camera.captureImage(); // Trigger camera to capture an image
+// Play a named feed profile on one feeder, empty name selects the default
+bool FishAPI::runProfile(const std::string& profile, int feeder) {
+    if (!m_feeders || !m_feeders->isInitialized()) {
+        std::cerr << "Motor not initialized" << std::endl;
+        return false;
+    }
+    std::cout << "Running feed profile '" << (profile.empty() ? m_profiles->defaultProfile() : profile)
+              << "' on feeder " << feeder << std::endl;
+    return m_feeders->feed({feeder}, profile.empty() ? m_profiles->defaultProfile() : profile, false);
+}
+
+// Timed feed from the scheduler, fed regardless of detection
+void FishAPI::scheduledFeed(const FeedScheduler::Entry& entry) {
+    Json::Value names(Json::arrayValue);
+    for (const auto& name : entry.feeders) {
+        names.append(name);
+    }
+    std::vector<int> feeders;
+    std::string error;
+    if (!parseFeeders(names, feeders, error)) {
+        std::cerr << "Scheduled feed " << entry.id << " skipped: " << error << std::endl;
+        return;
+    }
+    feedFish(true, entry.profile, feeders, m_feeders && m_feeders->isStaggered());
+    m_scheduledFeedCount++;
+}
+
+bool FishAPI::scheduleCommand(const std::string& command, const Json::Value& root, std::string& error) {
+    if (!m_scheduler) {
+        error = "Feed scheduler not available";
+        return false;
+    }
+    if (command == "cancel_schedule") {
+        int id = root.get("id", -1).asInt();
+        bool cancelled = m_scheduler->cancel(id);
+        std::cout << "Cancel scheduled feed " << id << ": " << (cancelled ? "done" : "not found") << std::endl;
+        if (!cancelled) {
+            error = "No scheduled feed " + std::to_string(id);
+        }
+        return cancelled;
+    }
+
+    // Persist feeder names, indices may change when the feeder config does
+    std::vector<int> indices;
+    if (!parseFeeders(root["feeder"], indices, error)) {
+        return false;
+    }
+    std::vector<std::string> feeders;
+    for (int index : indices) {
+        feeders.push_back(m_feeders->stats()[index].name);
+    }
+    std::string type = root.get("type", "once").asString();
+    std::string profile = root.get("profile", "").asString();
+    int id = -1;
+    if (type == "once") {
+        id = m_scheduler->addOneShot(root.get("delay", 60).asInt(), profile, feeders);
+    } else if (type == "recurring") {
+        id = m_scheduler->addRecurring(root.get("cron", "").asString(), profile, feeders);
+    } else if (type == "window") {
+        id = m_scheduler->addWindow(root.get("cron", "").asString(),
+                                    root.get("window_minutes", 30).asInt(), profile, feeders);
     } else {
-        std::cout << "Motion detected, but auto mode is off. Ignoring..." << std::endl;
+        error = "Unknown schedule type: " + type;
+        return false;
+    }
+    if (id < 0) {
+        error = "Failed to schedule feed";
+        return false;
+    }
+    return true;
+}
+
+bool FishAPI::parseFeeders(const Json::Value& value, std::vector<int>& indices, std::string& error) const {
+    indices.clear();
+    auto add = [&](const Json::Value& item) {
+        int index = -1;
+        if (m_feeders && item.isInt()) {
+            index = item.asInt();
+        } else if (m_feeders && item.isString()) {
+            index = m_feeders->indexOf(item.asString());
+        }
+        if (index < 0 || !m_feeders || index >= static_cast<int>(m_feeders->size())) {
+            Json::StreamWriterBuilder builder;
+            builder["indentation"] = "";
+            std::string name = item.isString() ? item.asString() : Json::writeString(builder, item);
+            error = "Unknown feeder '" + name + "'";
+            return false;
+        }
+        indices.push_back(index);
+        return true;
+    };
+    if (value.isArray()) {
+        for (const auto& item : value) {
+            if (!add(item)) {
+                return false;
+            }
+        }
+        return true;
     }
+    return value.isNull() || add(value);
 }
 
-// Fish detection callbacks from ImageProcessor
+// Detection events from the shared ImageProcessor
 void FishAPI::fishDetected(const cv::Mat& image) {
     std::cout << "FishAPI: Fish detected callback received" << std::endl;
     if (m_autoModeEnabled) {
@@ -136,113 +508,583 @@ void FishAPI::noFishDetected(const cv::Mat& image) {
 
 // Request a pH reading
 float FishAPI::requestPHReading() {
-    std::cout << "requestPHReading() called" << std::endl;
-    if (!m_phSensor) {
-        std::cerr << "ERROR: pH sensor object is NULL" << std::endl;
+    if (!m_phSampler) {
+        std::cerr << "ERROR: pH sampler object is NULL" << std::endl;
         return -1.0f;
     }
-    std::cout << "pH sensor initialization status: " << (m_phSensor->isInitialized() ? "Initialized" : "Not initialized") << std::endl;
-    if (!m_phSensor->isInitialized()) {
-        std::cerr << "pH sensor not initialized, attempting to initialize..." << std::endl;
-        if (!m_phSensor->initialize()) {
-            std::cerr << "pH sensor initialization failed" << std::endl;
-            return -1.0f;
-        }
-        std::cout << "pH sensor initialization successful" << std::endl;
+    PHSampler::Reading reading = m_phSampler->latest();
+    if (!m_phSampler->isFresh(reading)) {
+        // Runs on the pool, shared with a burst already in flight
+        m_phSampler->refresh();
     }
-    std::cout << "Reading pH value..." << std::endl;
-    float ph = m_phSensor->readPH();
-    std::cout << "Raw pH value from sensor: " << ph << std::endl;
-    if (ph < 0) {
-        std::cerr << "Failed to read pH value" << std::endl;
+    if (!reading.valid) {
+        std::cerr << "No pH reading yet" << std::endl;
         return -1.0f;
     }
-    std::cout << "Successfully read pH value: " << ph << std::endl;
-    return ph;
+    return reading.pH;
+}
+
+// GET Handler implementation
+FishAPI::GETHandler::GETHandler(FishAPI* api) : m_api(api) {
 }
 
-void FishAPI::threadFunction() {
-    try {
-        m_handler.start(&m_getHandler, &m_postHandler, "/tmp/fish_api.socket");
-        while (m_running) {
-            std::this_thread::sleep_for(std::chrono::seconds(1));
+std::string FishAPI::GETHandler::queryJSONString(const std::string& query) {
+    std::map<std::string, std::string> params = parseQuery(query);
+    if (params.count("ph_history")) {
+        return phHistoryJSONString(params);
+    }
+    if (params.count("command") || params.count("commands")) {
+        return commandsJSONString(params);
+    }
+    auto since = params.find("since");
+    if (since != params.end()) {
+        // Pollers that already hold this version get a few bytes instead of the status
+        std::shared_ptr<const StatusSnapshot> snapshot = m_api->m_snapshot.load();
+        uint64_t version = std::strtoull(since->second.c_str(), nullptr, 10);
+        if (snapshot && snapshot->version == version) {
+            return "{\"success\": true, \"unchanged\": true, \"version\": " + std::to_string(version) + "}";
         }
-        m_handler.stop();
-    } catch (const std::exception& e) {
-        std::cerr << "API thread error: " << e.what() << std::endl;
     }
+    return getJSONString();
 }
 
-// GET Handler implementation
-FishAPI::GETHandler::GETHandler(FishAPI* api) : m_api(api) {
+std::string FishAPI::GETHandler::commandsJSONString(const std::map<std::string, std::string>& params) {
+    Json::Value root;
+    auto id = params.find("command");
+    if (id != params.end()) {
+        CommandQueue::Command command;
+        if (!m_api->m_commands.find(std::strtoull(id->second.c_str(), nullptr, 10), command)) {
+            return failureReply("Unknown command id " + id->second);
+        }
+        root["data"] = commandJSON(command);
+    } else {
+        Json::Value list(Json::arrayValue);
+        for (const auto& command : m_api->m_commands.recent()) {
+            list.append(commandJSON(command));
+        }
+        root["data"] = list;
+    }
+    root["success"] = true;
+    Json::StreamWriterBuilder builder;
+    return Json::writeString(builder, root);
 }
 
-void FishAPI::onPHSample(float pH, float voltage, int16_t adcValue) {
-    m_currentPH.store(pH);
-    m_currentPHVoltage.store(voltage);
-    m_currentPHAdcValue.store(adcValue);
-    m_lastPHReadTime = std::time(nullptr);
-    std::cout << "pH Sensor Reading - pH: " << pH 
-              << ", Voltage: " << voltage 
-              << ", ADC Value: " << adcValue << std::endl;
+std::string FishAPI::GETHandler::phHistoryJSONString(const std::map<std::string, std::string>& params) {
+    Json::Value root;
+    const PHHistory* history = m_api->m_phHistory;
+    if (!history || !history->isOpen()) {
+        root["success"] = false;
+        root["error"] = "pH history unavailable";
+        Json::StreamWriterBuilder builder;
+        return Json::writeString(builder, root);
+    }
+
+    auto number = [&params](const char* key, int64_t fallback) {
+        auto it = params.find(key);
+        return it != params.end() && !it->second.empty() ? std::strtoll(it->second.c_str(), nullptr, 10) : fallback;
+    };
+    int64_t to = number("to", std::time(nullptr));
+    int64_t from = number("from", to - PH_HISTORY_DEFAULT_SECONDS);
+    size_t maxPoints = static_cast<size_t>(std::max<int64_t>(1, number("points", PH_HISTORY_DEFAULT_POINTS)));
+
+    auto start = std::chrono::steady_clock::now();
+    PHHistory::Resolution resolution;
+    auto requested = params.find("resolution");
+    if (requested == params.end() || !PHHistory::parseResolution(requested->second, resolution)) {
+        resolution = history->resolutionFor(from, to, maxPoints);
+    }
+    std::vector<PHHistory::Point> points = history->query(resolution, from, to);
+    double queryUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    Json::Value data;
+    data["resolution"] = PHHistory::resolutionName(resolution);
+    data["from"] = (Json::Int64)from;
+    data["to"] = (Json::Int64)to;
+    data["query_us"] = queryUs;
+    Json::Value list(Json::arrayValue);
+    for (const auto& point : points) {
+        Json::Value item;
+        item["time"] = (Json::Int64)point.time;
+        item["min"] = point.min;
+        item["max"] = point.max;
+        item["mean"] = point.mean;
+        item["count"] = point.count;
+        list.append(item);
+    }
+    data["points"] = list;
+    root["success"] = true;
+    root["data"] = data;
+
+    Json::StreamWriterBuilder builder;
+    return Json::writeString(builder, root);
 }
 
 std::string FishAPI::GETHandler::getJSONString() {
+    // A pointer load and a copy, the JSON was built when the state changed
+    int64_t startNs = nowNs();
+    std::shared_ptr<const StatusSnapshot> snapshot = m_api->m_snapshot.load();
+    if (!snapshot) {
+        m_api->publishSnapshot();
+        snapshot = m_api->m_snapshot.load();
+    }
+    std::string json = snapshot->json;
+    m_api->m_snapshotServes++;
+    m_api->m_snapshotServeNs += nowNs() - startNs;
+    return json;
+}
+
+void FishAPI::invalidate() {
+    // Any number of changes before the job runs share one build
+    if (m_snapshotPending.exchange(true)) {
+        return;
+    }
+    if (!m_pool.submit([this]() {
+            m_snapshotPending = false;
+            publishSnapshot();
+        }, WorkerPool::Lane::Analytics)) {
+        m_snapshotPending = false;
+    }
+}
+
+void FishAPI::publishSnapshot() {
+    std::lock_guard<std::mutex> lock(m_snapshotMutex);
+    int64_t startNs = nowNs();
+    Json::Value root = statusJSON();
+    // A new version only when something other than the clock and counters moved
+    Json::Value stable = stableState(root["data"]);
+    Json::StreamWriterBuilder compact;
+    compact["indentation"] = "";
+    std::string state = Json::writeString(compact, stable);
+    if (state != m_snapshotState) {
+        ++m_snapshotVersion;
+        m_snapshotState = std::move(state);
+    }
+    root["version"] = (Json::UInt64)m_snapshotVersion;
+
+    auto snapshot = std::make_shared<StatusSnapshot>();
+    snapshot->version = m_snapshotVersion;
+    snapshot->builtNs = startNs;
+    Json::StreamWriterBuilder builder;
+    snapshot->json = Json::writeString(builder, root);
+    // Swapped in before the delta goes out, a client greeted in between only sees it twice
+    m_snapshot.store(std::move(snapshot));
+    m_snapshotBuilds++;
+    m_snapshotBuildNs += nowNs() - startNs;
+    pushStatusDelta(root, stable);
+}
+
+void FishAPI::pushStatusDelta(const Json::Value& root, const Json::Value& stable) {
+    if (!m_events.hasClients()) {
+        // The next client's first delta then carries every section
+        m_statusSections.clear();
+        return;
+    }
+    // Compared without the volatile fields, so the clock and the counters,
+    // the stream's own byte count among them, never send a delta by
+    // themselves. A section that did change goes out whole.
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    const Json::Value& data = root["data"];
+    Json::Value changed(Json::objectValue);
+    for (const auto& key : stable.getMemberNames()) {
+        std::string section = Json::writeString(builder, stable[key]);
+        std::string& last = m_statusSections[key];
+        if (section != last) {
+            changed[key] = data[key];
+            last = std::move(section);
+        }
+    }
+    if (changed.empty()) {
+        return;
+    }
+    Json::Value delta;
+    delta["version"] = root["version"];
+    delta["changed"] = changed;
+    m_events.publish("status", Json::writeString(builder, delta));
+}
+
+std::string FishAPI::greeting() const {
+    std::shared_ptr<const StatusSnapshot> snapshot = m_snapshot.load();
+    return snapshot ? EventStream::format("status", 0, snapshot->json) : std::string();
+}
+
+void FishAPI::push(const char* event, const Json::Value& data) {
+    if (!m_events.hasClients()) {
+        return;
+    }
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    m_events.publish(event, Json::writeString(builder, data));
+}
+
+Json::Value FishAPI::statusJSON() {
     Json::Value root;
     Json::Value data;
-    
-    data["motor_initialized"] = (m_api->m_motor != nullptr && m_api->m_motor->isInitialized());
-    data["ph_sensor_initialized"] = (m_api->m_phSensor != nullptr && m_api->m_phSensor->isInitialized());
-    data["feed_count"] = m_api->m_feedCount.load();
-    data["auto_feed_count"] = m_api->m_autoFeedCount.load();
-    data["fish_detected"] = m_api->m_fishDetected.load();
-    data["last_image"] = m_api->m_lastImagePath;
-    data["auto_mode_enabled"] = m_api->m_autoModeEnabled.load();
-
-    data["current_time"] = (long)time(NULL);
-    if (m_api->m_lastFeedTime > 0) {
-        char timeBuffer[100];
-        std::strftime(timeBuffer, sizeof(timeBuffer), "%Y-%m-%d %H:%M:%S", 
-                      std::localtime(&m_api->m_lastFeedTime));
-        data["last_feed_time"] = timeBuffer;
-    } else {
-        data["last_feed_time"] = "Never";
+
+    // The fields feed handlers write, copied out in one go
+    std::string lastImagePath;
+    std::time_t lastFeedTime;
+    std::time_t autoLastFeedTime;
+    {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        lastImagePath = m_lastImagePath;
+        lastFeedTime = m_lastFeedTime;
+        autoLastFeedTime = m_AutolastFeedTime;
     }
     
-    if (m_api->m_AutolastFeedTime > 0) {
-        char timeBuffer[100];
-        std::strftime(timeBuffer, sizeof(timeBuffer), "%Y-%m-%d %H:%M:%S", 
-                      std::localtime(&m_api->m_AutolastFeedTime));
-        data["auto_last_feed_time"] = timeBuffer;
-    } else {
-        data["auto_last_feed_time"] = "Never";
+    data["motor_initialized"] = (m_feeders != nullptr && m_feeders->isInitialized());
+    data["ph_sensor_initialized"] = (m_phSensor != nullptr && m_phSensor->isInitialized());
+    data["feed_count"] = m_feedCount.load();
+    // Detection-driven feeds run in the feed flow, feed_fish without override counts too
+    FeedFlow::Stats flowStats = m_flow ? m_flow->stats() : FeedFlow::Stats();
+    data["auto_feed_count"] = (Json::UInt64)(m_autoFeedCount.load() + flowStats.fed);
+    data["scheduled_feed_count"] = m_scheduledFeedCount.load();
+    data["fish_detected"] = m_fishDetected.load();
+    data["last_image"] = lastImagePath;
+    data["auto_mode_enabled"] = m_autoModeEnabled.load();
+    if (m_profiles) {
+        Json::Value profiles(Json::arrayValue);
+        for (const auto& name : m_profiles->names()) {
+            profiles.append(name);
+        }
+        data["feed_profiles"] = profiles;
+        data["default_feed_profile"] = m_profiles->defaultProfile();
+    }
+
+    if (m_feeders) {
+        Json::Value feeders(Json::arrayValue);
+        for (const auto& stats : m_feeders->stats()) {
+            Json::Value feeder;
+            feeder["name"] = stats.name;
+            feeder["pin"] = stats.pin;
+            feeder["feed_count"] = stats.feedCount;
+            feeder["last_feed_time"] = (Json::Int64)stats.lastFeedTime;
+            feeder["run_time_ms"] = (Json::Int64)stats.runTimeMs;
+            feeder["running"] = stats.running;
+            feeders.append(feeder);
+        }
+        data["feeders"] = feeders;
+    }
+
+    if (m_phSensor) {
+        PHSensor::Stats stats = m_phSensor->stats();
+        Json::Value ph;
+        ph["continuous"] = stats.continuous;
+        ph["conversions"] = (Json::UInt64)stats.conversions;
+        ph["missed"] = (Json::UInt64)stats.missed;
+        ph["i2c_errors"] = (Json::UInt64)stats.i2cErrors;
+        ph["readings"] = (Json::UInt64)stats.readings;
+        ph["conversions_per_second"] = stats.conversionsPerSecond;
+        Json::Value channels(Json::arrayValue);
+        for (const auto& reading : stats.channels) {
+            Json::Value channel;
+            channel["name"] = reading.name;
+            channel["channel"] = reading.channel;
+            channel["valid"] = reading.valid;
+            channel["voltage"] = reading.voltage;
+            channels.append(channel);
+        }
+        ph["channels"] = channels;
+        data["ph_sensor"] = ph;
+
+        PHSensor::AlarmState alarmState = m_phSensor->alarm();
+        Json::Value alarm;
+        alarm["enabled"] = alarmState.enabled;
+        alarm["hardware"] = alarmState.hardware;
+        alarm["active"] = alarmState.active;
+        alarm["low"] = alarmState.low;
+        alarm["high"] = alarmState.high;
+        alarm["changes"] = (Json::UInt64)alarmState.changes;
+        alarm["last_change"] = formatTime(alarmState.lastChange);
+        data["ph_alarm"] = alarm;
+
+        const I2cBus& bus = m_phSensor->i2c();
+        Json::Value i2c;
+        i2c["device"] = bus.device();
+        Json::Value devices(Json::arrayValue);
+        for (const auto& device : bus.stats()) {
+            char address[8];
+            std::snprintf(address, sizeof(address), "0x%02x", device.address);
+            Json::Value entry;
+            entry["address"] = address;
+            entry["transactions"] = (Json::UInt64)device.transactions;
+            entry["retries"] = (Json::UInt64)device.retries;
+            entry["failures"] = (Json::UInt64)device.failures;
+            entry["avg_us"] = device.avgUs;
+            entry["max_us"] = device.maxUs;
+            devices.append(entry);
+        }
+        i2c["devices"] = devices;
+        data["i2c"] = i2c;
+    }
+
+    if (m_pirSensor) {
+        PirSensor::Stats stats = m_pirSensor->stats();
+        Json::Value pir;
+        pir["edges"] = (Json::UInt64)stats.edges;
+        pir["rising_edges"] = (Json::UInt64)stats.risingEdges;
+        pir["glitches"] = (Json::UInt64)stats.glitches;
+        pir["coalesced"] = (Json::UInt64)stats.coalesced;
+        pir["absorbed"] = (Json::UInt64)(stats.risingEdges - stats.motions);
+        pir["motions"] = (Json::UInt64)stats.motions;
+        pir["reads"] = (Json::UInt64)stats.reads;
+        pir["kernel_debounce"] = stats.kernelDebounce;
+        pir["hardware_timestamps"] = stats.hardwareTimestamps;
+        data["pir"] = pir;
+    }
+
+    if (m_trigger) {
+        MotionTrigger::Stats stats = m_trigger->stats();
+        Json::Value trigger;
+        trigger["mode"] = MotionTrigger::modeName(stats.mode);
+        trigger["pir_reports"] = (Json::UInt64)stats.pirReports;
+        trigger["video_reports"] = (Json::UInt64)stats.videoReports;
+        trigger["triggers"] = (Json::UInt64)stats.triggers;
+        trigger["unconfirmed"] = (Json::UInt64)stats.unconfirmed;
+        trigger["ignored"] = (Json::UInt64)stats.ignored;
+
+        VideoMotionDetector::Stats videoStats = m_trigger->video().stats();
+        Json::Value video;
+        video["running"] = videoStats.running;
+        video["frames"] = (Json::UInt64)videoStats.frames;
+        video["motions"] = (Json::UInt64)videoStats.motions;
+        video["coalesced"] = (Json::UInt64)videoStats.coalesced;
+        video["read_failures"] = (Json::UInt64)videoStats.readFailures;
+        video["noise"] = videoStats.noise;
+        video["threshold"] = videoStats.threshold;
+        video["avg_frame_ms"] = videoStats.avgFrameMs;
+        video["cpu_percent"] = videoStats.cpuPercent;
+        trigger["video"] = video;
+        data["trigger"] = trigger;
+    }
+
+    Json::Value reactor;
+    reactor["wakeups"] = (Json::UInt64)m_loop.wakeups();
+    reactor["watched_fds"] = (Json::UInt64)m_loop.watchCount();
+    reactor["workers"] = (Json::UInt64)m_pool.size();
+    reactor["queued_jobs"] = (Json::UInt64)m_pool.queued();
+    reactor["completed_jobs"] = (Json::UInt64)m_pool.completed();
+    Json::Value lanes(Json::arrayValue);
+    for (const auto& stats : m_pool.laneStats()) {
+        Json::Value lane;
+        lane["lane"] = WorkerPool::laneName(stats.lane);
+        lane["submitted"] = (Json::UInt64)stats.submitted;
+        lane["completed"] = (Json::UInt64)stats.completed;
+        lane["stolen"] = (Json::UInt64)stats.stolen;
+        lane["queued"] = (Json::UInt64)stats.queued;
+        lane["busy_seconds"] = stats.busySeconds;
+        lane["utilisation"] = stats.utilisation;
+        lane["avg_wait_ms"] = stats.avgWaitMs;
+        lanes.append(lane);
+    }
+    reactor["lanes"] = lanes;
+    reactor["requests"] = (Json::UInt64)m_server.requests();
+    data["reactor"] = reactor;
+
+    if (m_capture) {
+        Camera::Stats stats = m_capture->camera().stats();
+        Json::Value camera;
+        camera["captures"] = (Json::UInt64)stats.captures;
+        camera["failures"] = (Json::UInt64)stats.failures;
+
+        CaptureAdmission::Stats admission = m_capture->stats();
+        Json::Value admissionJson;
+        admissionJson["policy"] = CaptureAdmission::policyName(admission.policy);
+        admissionJson["queued"] = (Json::UInt64)admission.queued;
+        admissionJson["requests"] = (Json::UInt64)admission.requests;
+        admissionJson["avg_wait_ms"] = admission.avgWaitMs;
+        admissionJson["max_wait_ms"] = admission.maxWaitMs;
+        Json::Value policies;
+        for (const auto& policy : admission.policies) {
+            Json::Value counters;
+            counters["captured"] = (Json::UInt64)policy.captured;
+            counters["coalesced"] = (Json::UInt64)policy.coalesced;
+            counters["shed"] = (Json::UInt64)policy.shed;
+            policies[CaptureAdmission::policyName(policy.policy)] = counters;
+        }
+        admissionJson["policies"] = policies;
+        camera["admission"] = admissionJson;
+        data["camera"] = camera;
+    }
+
+    if (m_flow) {
+        const FeedFlow::Stats& stats = flowStats;
+        Json::Value flow;
+        flow["triggered"] = (Json::UInt64)stats.triggered;
+        flow["rejected"] = (Json::UInt64)stats.rejected;
+        flow["in_flight"] = (Json::UInt64)stats.inFlight;
+        flow["fed"] = (Json::UInt64)stats.fed;
+        flow["no_fish"] = (Json::UInt64)stats.noFish;
+        flow["windowed"] = (Json::UInt64)stats.windowed;
+        Json::Value steps;
+        for (const auto& step : stats.steps) {
+            Json::Value item;
+            item["ok"] = (Json::UInt64)step.ok;
+            item["failed"] = (Json::UInt64)step.failed;
+            item["timed_out"] = (Json::UInt64)step.timedOut;
+            item["cancelled"] = (Json::UInt64)step.cancelled;
+            steps[step.name] = item;
+        }
+        flow["steps"] = steps;
+        data["feed_flow"] = flow;
+    }
+
+    if (m_pipeline) {
+        Json::Value pipeline(Json::arrayValue);
+        for (const auto& stage : m_pipeline->stats()) {
+            Json::Value item;
+            item["stage"] = stage.name;
+            item["queued"] = (Json::UInt64)stage.queued;
+            item["capacity"] = (Json::UInt64)stage.capacity;
+            item["peak"] = (Json::UInt64)stage.peak;
+            item["processed"] = (Json::UInt64)stage.processed;
+            item["dropped"] = (Json::UInt64)stage.dropped;
+            item["failed"] = (Json::UInt64)stage.failed;
+            item["utilisation"] = stage.utilisation;
+            item["avg_ms"] = stage.avgMs;
+            pipeline.append(item);
+        }
+        data["pipeline"] = pipeline;
+    }
+
+    Json::Value bus(Json::arrayValue);
+    for (const auto& topic : m_bus.stats()) {
+        Json::Value item;
+        item["topic"] = topic.name;
+        item["published"] = (Json::UInt64)topic.published;
+        item["dropped"] = (Json::UInt64)topic.dropped;
+        item["depth"] = (Json::UInt64)topic.depth;
+        item["avg_latency_us"] = topic.avgLatencyUs;
+        item["max_latency_us"] = topic.maxLatencyUs;
+        Json::Value subscribers(Json::arrayValue);
+        for (const auto& subscriber : topic.subscribers) {
+            Json::Value sub;
+            sub["name"] = subscriber.name;
+            sub["delivery"] = deliveryName(subscriber.delivery);
+            if (subscriber.delivery == Delivery::Pool) {
+                sub["lane"] = WorkerPool::laneName(subscriber.lane);
+            }
+            sub["delivered"] = (Json::UInt64)subscriber.delivered;
+            sub["depth"] = (Json::UInt64)subscriber.depth;
+            sub["max_depth"] = (Json::UInt64)subscriber.maxDepth;
+            sub["avg_latency_us"] = subscriber.avgLatencyUs;
+            sub["max_latency_us"] = subscriber.maxLatencyUs;
+            subscribers.append(sub);
+        }
+        item["subscribers"] = subscribers;
+        bus.append(item);
     }
+    data["event_bus"] = bus;
+
+    if (m_scheduler) {
+        Json::Value schedule(Json::arrayValue);
+        for (const auto& entry : m_scheduler->entries()) {
+            Json::Value item;
+            item["id"] = entry.id;
+            item["type"] = FeedScheduler::kindName(entry.kind);
+            item["cron"] = entry.cron;
+            item["next_time"] = (Json::Int64)entry.fireAt;
+            item["window_minutes"] = entry.windowMinutes;
+            item["window_open"] = entry.windowOpen;
+            item["profile"] = entry.profile;
+            schedule.append(item);
+        }
+        data["schedule"] = schedule;
+    }
+
+    data["current_time"] = (long)time(NULL); // When this snapshot was built
+    data["last_feed_time"] = formatTime(lastFeedTime);
+    data["auto_last_feed_time"] = formatTime(std::max(autoLastFeedTime, flowStats.lastFedTime));
     
-    data["current_ph"] = m_api->m_currentPH.load();
-    data["current_ph_voltage"] = m_api->m_currentPHVoltage.load();
-    data["current_ph_adc_value"] = m_api->m_currentPHAdcValue.load();
+    // One consistent copy of the sampler's reading, no lock and no I2C
+    PHSampler::Reading reading = m_phSampler ? m_phSampler->latest() : PHSampler::Reading();
+    data["current_ph"] = reading.valid ? reading.pH : 0.0f;
+    data["current_ph_voltage"] = reading.valid ? reading.voltage : 0.0f;
+    data["current_ph_adc_value"] = reading.valid ? reading.adcValue : 0;
+    data["ph_fresh"] = m_phSampler != nullptr && m_phSampler->isFresh(reading);
     
-    if (m_api->m_lastPHReadTime > 0) {
-        char phTimeBuffer[100];
-        std::strftime(phTimeBuffer, sizeof(phTimeBuffer), "%Y-%m-%d %H:%M:%S", 
-                      std::localtime(&m_api->m_lastPHReadTime));
-        data["last_ph_read_time"] = phTimeBuffer;
-    } else {
-        data["last_ph_read_time"] = "Never";
+    data["last_ph_read_time"] = formatTime(reading.valid ? reading.time : 0);
+    
+    if (m_phSampler) {
+        PHSampler::Stats stats = m_phSampler->stats();
+        Json::Value sampler;
+        sampler["bursts"] = (Json::UInt64)stats.bursts;
+        sampler["failures"] = (Json::UInt64)stats.failures;
+        sampler["samples"] = (Json::UInt64)stats.samples;
+        sampler["outliers"] = (Json::UInt64)stats.outliers;
+        sampler["cached"] = (Json::UInt64)stats.cached;
+        sampler["refreshes"] = (Json::UInt64)stats.refreshes;
+        sampler["collapsed"] = (Json::UInt64)stats.collapsed;
+        sampler["avg_burst_ms"] = stats.avgBurstMs;
+        sampler["age_ms"] = stats.ageMs;
+        sampler["last_samples"] = reading.samples;
+        sampler["last_outliers"] = reading.outliers;
+        sampler["last_noise"] = reading.noise;
+        sampler["interval_ms"] = stats.intervalMs;
+        sampler["boosted"] = stats.boosted;
+        sampler["boosts"] = (Json::UInt64)stats.boosts;
+        sampler["changes"] = (Json::UInt64)stats.changes;
+        sampler["duty_percent"] = stats.dutyPercent;
+        sampler["samples_saved"] = (Json::UInt64)stats.samplesSaved;
+        data["ph_sampler"] = sampler;
     }
     
+    if (m_phHistory) {
+        PHHistory::Stats stats = m_phHistory->stats();
+        Json::Value history;
+        history["open"] = stats.open;
+        history["appended"] = (Json::UInt64)stats.appended;
+        history["out_of_order"] = (Json::UInt64)stats.outOfOrder;
+        history["syncs"] = (Json::UInt64)stats.syncs;
+        history["queries"] = (Json::UInt64)stats.queries;
+        history["file_bytes"] = (Json::UInt64)stats.fileBytes;
+        Json::Value records;
+        for (size_t r = 0; r < PHHistory::RESOLUTIONS; ++r) {
+            records[PHHistory::resolutionName(static_cast<PHHistory::Resolution>(r))] = (Json::UInt64)stats.records[r];
+        }
+        history["records"] = records;
+        data["ph_history"] = history;
+    }
+    
+    Json::Value snapshot;
+    snapshot["builds"] = (Json::UInt64)m_snapshotBuilds.load();
+    snapshot["avg_build_us"] = m_snapshotBuilds ? m_snapshotBuildNs / 1e3 / m_snapshotBuilds : 0.0;
+    snapshot["serves"] = (Json::UInt64)m_snapshotServes.load();
+    snapshot["avg_serve_us"] = m_snapshotServes ? m_snapshotServeNs / 1e3 / m_snapshotServes : 0.0;
+    data["snapshot"] = snapshot;
+
+    EventStream::Stats streamStats = m_events.stats();
+    Json::Value events;
+    events["clients"] = (Json::UInt64)streamStats.clients;
+    events["accepted"] = (Json::UInt64)streamStats.accepted;
+    events["rejected"] = (Json::UInt64)streamStats.rejected;
+    events["dropped"] = (Json::UInt64)streamStats.dropped;
+    events["events"] = (Json::UInt64)streamStats.events;
+    events["bytes"] = (Json::UInt64)streamStats.bytes;
+    data["events"] = events;
+
+    CommandQueue::Stats commandStats = m_commands.stats();
+    Json::Value commands;
+    commands["queued"] = (Json::UInt64)commandStats.queued;
+    commands["running"] = (Json::UInt64)commandStats.running;
+    commands["submitted"] = (Json::UInt64)commandStats.submitted;
+    commands["rejected"] = (Json::UInt64)commandStats.rejected;
+    commands["done"] = (Json::UInt64)commandStats.done;
+    commands["failed"] = (Json::UInt64)commandStats.failed;
+    commands["avg_wait_ms"] = commandStats.avgWaitMs;
+    commands["avg_run_ms"] = commandStats.avgRunMs;
+    data["commands"] = commands;
+    
     root["success"] = true;
     root["data"] = data;
-    
-    Json::StreamWriterBuilder builder;
-    return Json::writeString(builder, root);
+    return root;
 }
 
 // POST Handler implementation
 FishAPI::POSTHandler::POSTHandler(FishAPI* api) : m_api(api) {
 }
 
-void FishAPI::POSTHandler::postString(std::string postArg) {
+std::string FishAPI::POSTHandler::postString(std::string postArg) {
     std::cout << "Received POST data: " << postArg << std::endl;
     
     Json::Value root;
@@ -252,16 +1094,57 @@ void FishAPI::POSTHandler::postString(std::string postArg) {
     
     if (!reader->parse(postArg.c_str(), postArg.c_str() + postArg.length(), &root, &err)) {
         std::cerr << "Error parsing JSON: " << err << std::endl;
-        return;
+        return failureReply("Error parsing JSON: " + err);
     }
     
-    if (!root.isMember("command")) {
+    if (!root.isObject() || !root.isMember("command") || !root["command"].isString()) {
         std::cerr << "No command specified" << std::endl;
-        return;
+        return failureReply("No command specified");
     }
     
     std::string command = root["command"].asString();
-    
+    CommandQueue::Lane lane;
+    if (!commandLane(command, lane)) {
+        std::cerr << "Unknown command: " << command << std::endl;
+        return failureReply("Unknown command: " + command);
+    }
+
+    // Answered now, the command runs on its lane and reports through ?command=<id> and the stream
+    FishAPI* api = m_api;
+    uint64_t id = api->m_commands.submit(command, lane,
+        [api, command, root](std::string& error, std::string& result) {
+            return api->runCommand(command, root, error, result);
+        });
+    if (id == 0) {
+        return failureReply(std::string("Too many ") + CommandQueue::laneName(lane) + " commands queued");
+    }
+
+    Json::Value reply;
+    reply["success"] = true;
+    reply["command_id"] = (Json::UInt64)id;
+    CommandQueue::Command queued;
+    reply["state"] = api->m_commands.find(id, queued) ? CommandQueue::stateName(queued.state) : "queued";
+    Json::StreamWriterBuilder writer;
+    return Json::writeString(writer, reply);
+}
+
+bool FishAPI::runCommand(const std::string& command, const Json::Value& root, std::string& error,
+                         std::string& result) {
+    if (!checkFieldTypes(root, error)) {
+        return false;
+    }
+    // A misspelt feeder fails the command, it never falls back to another one
+    std::vector<int> feeders;
+    if (root.isMember("feeder") && !parseFeeders(root["feeder"], feeders, error)) {
+        return false;
+    }
+    if (command == "run_motor" && root.isMember("profile")) {
+        if (!runProfile(root["profile"].asString(), feeders.empty() ? 0 : feeders.front())) {
+            error = "Feed profile failed or motor not initialized";
+            return false;
+        }
+        return true;
+    }
     if (command == "run_motor") {
         int dutyCycle = root.get("duty_cycle", 100).asInt();
         int duration = root.get("duration", 1000).asInt();
@@ -275,51 +1158,119 @@ void FishAPI::POSTHandler::postString(std::string postArg) {
                   << ", duration=" << duration 
                   << ", period=" << period << std::endl;
                   
-        if (m_api->m_motor && m_api->m_motor->isInitialized()) {
-            m_api->m_motor->run(dutyCycle, period, duration);
-        } else {
-            std::cerr << "Motor not initialized" << std::endl;
+        if (!m_feeders || !m_feeders->isInitialized()) {
+            error = "Motor not initialized";
+            return false;
+        }
+        if (!m_feeders->play(feeders.empty() ? 0 : feeders.front(),
+                             MotorProfileLibrary::compile({{dutyCycle, period, duration}}))) {
+            error = "Motor run failed";
+            return false;
         }
+        return true;
     }
-    else if (command == "feed_fish") {
+    if (command == "feed_fish") {
         bool override = root.get("override", false).asBool();
-        m_api->feedFish(override); 
+        bool staggered = root.get("mode", m_feeders && m_feeders->isStaggered()
+                                              ? "staggered" : "concurrent").asString() == "staggered";
+        if (!feedFish(override, root.get("profile", "").asString(), feeders, staggered)) {
+            error = "Feed failed, or ignored without override while auto mode is off or no fish is seen";
+            return false;
+        }
+        return true;
     }
-    else if (command == "read_ph") {
-        std::cout << "On-demand pH reading requested" << std::endl;
-        float ph = m_api->requestPHReading();
-        if (ph >= 0) {
-            std::cout << "pH reading successful: " << ph << std::endl;
-        } else {
-            std::cerr << "pH reading failed" << std::endl;
+    if (command == "schedule_feed" || command == "cancel_schedule") {
+        return scheduleCommand(command, root, error);
+    }
+    if (command == "read_ph") {
+        // Served from the sampler, a stale reading is refreshed in the background
+        float ph = requestPHReading();
+        if (ph < 0) {
+            error = "No pH reading yet";
+            return false;
         }
+        std::cout << "pH reading: " << ph << std::endl;
+        char reading[16];
+        std::snprintf(reading, sizeof(reading), "%.2f", ph);
+        result = reading;
+        return true;
     }
-    else if (command == "init_ph_sensor") {
+    if (command == "set_ph_alarm") {
+        if (!root.isMember("low") || !root.isMember("high")) {
+            error = "Missing 'low' or 'high' parameter for set_ph_alarm command";
+            return false;
+        }
+        if (!m_phSensor || !m_phSensor->setAlarm(root["low"].asFloat(), root["high"].asFloat())) {
+            error = "pH alarm not set";
+            return false;
+        }
+        return true;
+    }
+    if (command == "init_ph_sensor") {
         std::cout << "Manual pH sensor initialization requested" << std::endl;
-        if (m_api->m_phSensor) {
-            bool success = m_api->m_phSensor->initialize();
-            std::cout << "pH sensor initialization " << (success ? "successful" : "failed") << std::endl;
-        } else {
-            std::cerr << "pH sensor is NULL" << std::endl;
+        if (!m_phSensor) {
+            error = "pH sensor is NULL";
+            return false;
+        }
+        bool success = m_phSensor->initialize();
+        std::cout << "pH sensor initialization " << (success ? "successful" : "failed") << std::endl;
+        if (!success) {
+            error = "pH sensor initialization failed";
         }
+        return success;
     }
-    else if (command == "set_auto_mode") {
-        if (root.isMember("enabled")) {
-            bool enabled = root["enabled"].asBool();
-            m_api->m_autoModeEnabled = enabled;
-            if (enabled) {
-                m_api->m_pirSensor->start();
-                m_api->m_camera.start();
-            } else {
-                m_api->m_pirSensor->stop();
-                m_api->m_camera.stop();
-            }
-            std::cout << "Auto mode set to: " << (enabled ? "enabled" : "disabled") << std::endl;
+    if (command == "set_auto_mode") {
+        if (!root.isMember("enabled")) {
+            error = "Missing 'enabled' parameter for set_auto_mode command";
+            return false;
+        }
+        bool enabled = root["enabled"].asBool();
+        m_autoModeEnabled = enabled;
+        if (enabled) {
+            m_pirSensor->start();
+            m_capture->camera().start();
+            m_trigger->start();
         } else {
-            std::cerr << "Missing 'enabled' parameter for set_auto_mode command" << std::endl;
+            m_pirSensor->stop();
+            m_trigger->stop();
+            m_capture->camera().stop();
         }
+        std::cout << "Auto mode set to: " << (enabled ? "enabled" : "disabled") << std::endl;
+        return true;
     }
-    else {
-        std::cerr << "Unknown command: " << command << std::endl;
+    if (command == "set_trigger_mode") {
+        MotionTrigger::Mode mode;
+        if (!root.isMember("mode") || !MotionTrigger::parseMode(root["mode"].asString(), mode)) {
+            error = "Missing or unknown 'mode' for set_trigger_mode command";
+            return false;
+        }
+        if (m_trigger) {
+            m_trigger->setMode(mode);
+        }
+        return true;
+    }
+    if (command == "set_capture_policy") {
+        CaptureAdmission::Policy policy;
+        if (!root.isMember("policy") || !CaptureAdmission::parsePolicy(root["policy"].asString(), policy)) {
+            error = "Missing or unknown 'policy' for set_capture_policy command";
+            return false;
+        }
+        if (m_capture) {
+            m_capture->setPolicy(policy, root.get("min_interval_ms", -1).asInt());
+            std::cout << "Capture policy set to: " << CaptureAdmission::policyName(policy) << std::endl;
+        }
+        return true;
+    }
+    error = "Unknown command: " + command;
+    return false;
+}
+
+void FishAPI::commandChanged(const CommandQueue::Command& command) {
+    if (command.state == CommandQueue::State::Done || command.state == CommandQueue::State::Failed) {
+        // The status goes out with the command's effect before the command is reported finished
+        publishSnapshot();
+    } else {
+        invalidate();
     }
+    push("command", commandJSON(command));
 }
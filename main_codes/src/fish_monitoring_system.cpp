@@ -1,68 +1,147 @@
 #include "fish_monitoring_system.h"
+#include "opencv_parallel.h"
+#include <csignal>
 #include <filesystem>
 #include <iostream>
+#include <sys/epoll.h>
+#include <unistd.h>
 
 namespace fs = std::filesystem;
 
-class FishAPICallback : public ImageProcessor::FishDetectionCallbackInterface {
-private:
-    FishAPI* m_api;
-    
-public:
-    FishAPICallback(FishAPI* api) : m_api(api) {}
-    
-    void fishDetected(const cv::Mat& image) override {
-        m_api->setFishDetected(true);
-        m_api->setLastImagePath("fish_detected.jpg");
-    }
-    
-    void noFishDetected(const cv::Mat& image) override {
-        m_api->setFishDetected(false);
-        m_api->setLastImagePath("no_fish.jpg");
-    }
-};
-
 FishMonitoringSystem::FishMonitoringSystem() {
     // Clear archive
     clearArchive();
     
+    // One loop thread for all fds and timers, blocking and CPU-heavy work
+    // (OpenCV's parallel loops included) on one shared pool
+    m_loop = std::make_unique<EventLoop>();
+    m_pool = std::make_unique<WorkerPool>(WorkerPool::defaultSize());
+    installOpenCVBackend(*m_pool);
+    m_bus = std::make_unique<EventBus>(*m_pool);
+    
     // Create components
+    std::cout << "Loading feed profiles..." << std::endl;
+    m_profiles = std::make_unique<MotorProfileLibrary>();
+    if (!m_profiles->load("../config/feed_profiles.json")) {
+        std::cerr << "Using built-in feed profiles" << std::endl;
+    }
+    
     std::cout << "Initializing PIR sensor..." << std::endl;
-    m_pirSensor = std::make_unique<PirSensor>();  
+    PirSensorConfig pirConfig; // GPIO pin 17, 50 ms debounce, 3 s hold-off
+    if (!pirConfig.load("../config/pir.json")) {
+        std::cerr << "Using default PIR settings" << std::endl;
+    }
+    m_pirSensor = std::make_unique<PirSensor>(*m_loop, *m_bus, pirConfig);
     
     std::cout << "Initializing camera module..." << std::endl;
-    m_camera = std::make_unique<Camera>("fish_detection.jpg", 640, 480);
+    m_camera = std::make_unique<Camera>(*m_bus, "image", "fish_detection.jpg", 640, 480);
+    
+    std::cout << "Initializing motion trigger..." << std::endl;
+    VideoMotionConfig videoConfig; // 160x120 at 4 fps
+    if (!videoConfig.load("../config/video_motion.json")) {
+        std::cerr << "Using default video motion settings" << std::endl;
+    }
+    m_videoMotion = std::make_unique<VideoMotionDetector>(*m_camera, *m_bus, videoConfig);
+    MotionTriggerConfig triggerConfig; // PIR only
+    if (!triggerConfig.load("../config/trigger.json")) {
+        std::cerr << "Using the PIR sensor as the trigger" << std::endl;
+    }
+    m_trigger = std::make_unique<MotionTrigger>(*m_bus, *m_videoMotion, triggerConfig);
     
     std::cout << "Initializing image processor..." << std::endl;
-    m_imageProcessor = std::make_unique<ImageProcessor>();
+    m_imageProcessor = std::make_unique<ImageProcessor>(*m_bus, "", "detection"); // Driven by the feed flow
+    
+    std::cout << "Initializing feeding mechanism..." << std::endl;
+    FeederBankConfig feederConfig; // One feeder, motor on GPIO pin 4
+    if (!feederConfig.load("../config/feeders.json")) {
+        std::cerr << "Using a single feeder on GPIO pin 4" << std::endl;
+    }
+    m_feeder = std::make_unique<Feeder>(*m_bus, feederConfig, m_profiles.get());
+    
+    std::cout << "Initializing frame pipeline..." << std::endl;
+    FramePipelineConfig pipelineConfig; // Two frames before decode and detect, eight before archive
+    if (!pipelineConfig.load("../config/pipeline.json")) {
+        std::cerr << "Using default pipeline queues" << std::endl;
+    }
+    m_pipeline = std::make_unique<FramePipeline>(*m_camera, *m_imageProcessor, *m_feeder, pipelineConfig);
+    CaptureAdmissionConfig captureConfig; // latest_wins, one capture queued
+    if (!captureConfig.load("../config/capture.json")) {
+        std::cerr << "Using default capture admission" << std::endl;
+    }
+    m_capture = std::make_unique<CaptureAdmission>(*m_camera, *m_pipeline, *m_pool, captureConfig);
     
-    std::cout << "Initializing feeding mechanism with motor on GPIO pin 4..." << std::endl;
-    m_feeder = std::make_unique<Feeder>(4); // Motor on GPIO pin 4
+    std::cout << "Initializing feed flow..." << std::endl;
+    FeedFlowConfig flowConfig; // 15 s capture, 5 s detection, 60 s feed
+    if (!flowConfig.load("../config/feed_flow.json")) {
+        std::cerr << "Using default feed flow deadlines" << std::endl;
+    }
+    std::cout << "Initializing feed scheduler..." << std::endl;
+    m_scheduler = std::make_unique<FeedScheduler>(*m_loop, *m_bus, "../data/feed_schedule.json");
+    m_flow = std::make_unique<FeedFlow>(*m_loop, *m_pool, *m_capture, *m_pipeline, *m_feeder,
+                                        m_scheduler.get(), flowConfig);
     
     std::cout << "Initializing pH sensor..." << std::endl;
-    m_phSensor = std::make_unique<PHSensor>();
+    PHSensorConfig phConfig; // Continuous at 860 SPS, ALERT/RDY on GPIO 27, 64 conversions per reading
+    if (!phConfig.load("../config/ph.json")) {
+        std::cerr << "Using default pH sensor settings" << std::endl;
+    }
+    I2cBusConfig i2cConfig; // /dev/i2c-1, 3 retries from 200 us
+    if (!i2cConfig.load("../config/i2c.json")) {
+        std::cerr << "Using default I2C bus settings" << std::endl;
+    }
+    m_i2cBus = std::make_unique<I2cBus>(i2cConfig);
+    if (i2cConfig.device == "emulated") {
+        // No adapter, the ADC is simulated. It has no ALERT/RDY line to wait on.
+        Ads1115EmulatorConfig emulatorConfig; // pH 7.2 to 6.8 and back over 20 minutes
+        if (!emulatorConfig.load("../config/ads1115_emulator.json")) {
+            std::cerr << "Using the default emulated pH curve" << std::endl;
+        }
+        m_phEmulator = std::make_unique<Ads1115Emulator>(emulatorConfig);
+        m_i2cBus->attach(m_phEmulator->address(), m_phEmulator.get());
+        phConfig.mode = "single_shot";
+        std::cout << "pH sensor on an emulated ADS1115" << std::endl;
+    }
+    m_phSensor = std::make_unique<PHSensor>(*m_bus, *m_i2cBus, phConfig);
     if (m_phSensor->initialize()) {
          std::cout << "pH sensor initialized successfully" << std::endl;
     } else {
         std::cerr << "Failed to initialize pH sensor" << std::endl;
     }
+    PHHistoryConfig historyConfig; // A week raw, 31 days of minutes, 400 of hours, 10 years of days
+    if (!historyConfig.load("../config/ph_history.json")) {
+        std::cerr << "Using default pH history retention" << std::endl;
+    }
+    m_phHistory = std::make_unique<PHHistory>(*m_bus, historyConfig);
+    PHSamplerConfig samplerConfig; // Burst of 9, every 2 s to 5 min as pH moves, Hampel k = 3
+    if (!samplerConfig.load("../config/ph_sampler.json")) {
+        std::cerr << "Using default pH sampling" << std::endl;
+    }
+    m_phSampler = std::make_unique<PHSampler>(*m_loop, *m_pool, *m_phSensor, *m_bus, samplerConfig);
     
-    // Create API with pointer to the same motor, pH sensor, and PIR sensor
+    // Create API with pointer to the same motor, pH sensor, PIR sensor and camera
     std::cout << "Initializing API..." << std::endl;
-    m_api = std::make_unique<FishAPI>(m_feeder->getMotor(), m_phSensor.get(), m_pirSensor.get()); // Add PirSensor*
-    
-    // Setting up callback chain
-    std::cout << "Setting up event callback chain..." << std::endl;
-    m_pirSensor->registerCallback(this);
-    m_camera->registerCallback(m_imageProcessor.get());
-    m_imageProcessor->registerCallback(m_feeder.get());
-    
-    // Also setting up a callback to update the API when fish is detected
-    m_imageProcessor->registerCallback(new FishAPICallback(m_api.get()));
+    EventStreamConfig eventsConfig; // /tmp/fish_events.socket, 32 clients, 256 KiB behind at most
+    if (!eventsConfig.load("../config/events.json")) {
+        std::cerr << "Using default event stream settings" << std::endl;
+    }
+    m_api = std::make_unique<FishAPI>(m_feeder->getBank(), m_phSensor.get(), m_phSampler.get(), m_phHistory.get(),
+                                      m_pirSensor.get(), m_trigger.get(), m_capture.get(), m_profiles.get(),
+                                      m_scheduler.get(), m_flow.get(), m_pipeline.get(), *m_loop, *m_bus,
+                                      eventsConfig);
     
-    // Register pH sensor callback to API
-    m_phSensor->registerCallback(m_api.get());
-    m_phSensor->registerCallback(this);
+    // Subscribing to events, producers publish on the bus. The motion trigger
+    // (PIR, camera motion or both) is the only trigger of the one capture
+    // graph: flow -> admission -> pipeline (capture, decode, detect, archive),
+    // detections fan out to the API on "detection"
+    std::cout << "Subscribing to events..." << std::endl;
+    m_subscriptions.add(m_bus->topic<MotionTrigger::TriggerEvent>("trigger"), "system", Delivery::Inline,
+                        [this](const MotionTrigger::TriggerEvent& event) { motionDetected(event); });
+    m_subscriptions.add(m_bus->topic<PHSensor::Sample>("ph"), "system", Delivery::Inline,
+                        [this](const PHSensor::Sample& sample) {
+                            onPHSample(sample.pH, sample.voltage, sample.adcValue);
+                        });
+    m_subscriptions.add(m_bus->topic<PHSensor::AlarmEvent>("ph_alarm"), "system", Delivery::Inline,
+                        [this](const PHSensor::AlarmEvent& event) { onPHAlarm(event); });
 }
 
 FishMonitoringSystem::~FishMonitoringSystem() {
@@ -75,21 +154,49 @@ void FishMonitoringSystem::start() {
     // m_pirSensor->start();
     // m_phSensor->start();  
     m_api->start();  // Start the API
+    m_scheduler->start();  // Timed feeds go through the API
+    m_phSampler->start();  // Bursts on the pool, the API serves its cached reading
     std::cout << "System started and ready." << std::endl;
 }
 
+void FishMonitoringSystem::run() {
+    m_loop->addSignals({SIGINT, SIGTERM}, [this](int signal) {
+        std::cout << "Received signal " << signal << ", shutting down..." << std::endl;
+        m_loop->stop();
+    });
+    m_loop->add(STDIN_FILENO, EPOLLIN, [this](uint32_t) {
+        char buffer[256];
+        if (read(STDIN_FILENO, buffer, sizeof(buffer)) > 0) {
+            m_loop->stop();
+        } else {
+            m_loop->remove(STDIN_FILENO); // No terminal, e.g. started as a service
+        }
+    });
+    m_loop->run();
+    m_loop->remove(STDIN_FILENO);
+}
+
 void FishMonitoringSystem::stop() {
     std::cout << "Stopping Fish Monitoring System..." << std::endl;
+    m_phSampler->stop();
+    m_scheduler->stop();
     m_api->stop();  // Stop the API
+    m_flow->stop();  // Cancel trigger flows in flight, stops a running feed
+    m_pool->stop();  // Finish running captures, feeds and requests
+    m_pipeline->stop();  // Decode, detect and archive what was captured
+    m_bus->stop();
+    removeOpenCVBackend();
     // m_pirSensor->stop();
     m_phSensor->cleanup();  // Stop pH sensor
     // m_camera->stop();
     std::cout << "System stopped." << std::endl;
 }
 
-void FishMonitoringSystem::motionDetected(gpiod_line_event e) {
-    std::cout << "Motion event triggered camera capture!" << std::endl;
-    m_camera->captureImage();
+void FishMonitoringSystem::motionDetected(const MotionTrigger::TriggerEvent& event) {
+    std::cout << "Motion (" << MotionTrigger::sourceName(event.source) << ") triggered camera capture!" << std::endl;
+    if (!m_flow->trigger()) {
+        std::cout << "Feed flow busy, trigger dropped" << std::endl;
+    }
 }
 
 void FishMonitoringSystem::onPHSample(float pH, float voltage, int16_t adcValue) {
@@ -98,6 +205,15 @@ void FishMonitoringSystem::onPHSample(float pH, float voltage, int16_t adcValue)
               << ", ADC Value: " << adcValue << std::endl;
 }
 
+void FishMonitoringSystem::onPHAlarm(const PHSensor::AlarmEvent& event) {
+    if (event.active) {
+        std::cerr << "pH ALARM: " << event.pH << " outside " << event.low << " - " << event.high
+                  << (event.hardware ? " (comparator)" : "") << std::endl;
+    } else {
+        std::cout << "pH back within " << event.low << " - " << event.high << ": " << event.pH << std::endl;
+    }
+}
+
 void FishMonitoringSystem::clearArchive() {
     if (fs::exists("../archive")) {
         for (const auto& entry : fs::directory_iterator("../archive")) {
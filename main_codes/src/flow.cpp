@@ -0,0 +1,50 @@
+#include "flow.h"
+
+void Cancellation::cancel() {
+    std::map<int, std::function<void()>> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_cancelled.exchange(true)) {
+            return;
+        }
+        callbacks.swap(m_callbacks);
+    }
+    for (auto& callback : callbacks) {
+        callback.second();
+    }
+}
+
+int Cancellation::onCancel(std::function<void()> callback) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_cancelled) {
+            int id = m_nextId++;
+            m_callbacks.emplace(id, std::move(callback));
+            return id;
+        }
+    }
+    callback();
+    return -1;
+}
+
+void Cancellation::remove(int id) {
+    if (id < 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_callbacks.erase(id);
+}
+
+const char* stepStatusName(StepStatus status) {
+    switch (status) {
+    case StepStatus::Ok:
+        return "ok";
+    case StepStatus::Failed:
+        return "failed";
+    case StepStatus::TimedOut:
+        return "timed_out";
+    case StepStatus::Cancelled:
+        return "cancelled";
+    }
+    return "unknown";
+}
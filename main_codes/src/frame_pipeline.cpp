@@ -0,0 +1,239 @@
+#include "frame_pipeline.h"
+#include "realtime.h"
+#include <jsoncpp/json/json.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+static const char* STAGE_NAMES[] = { "capture", "decode", "detect", "archive" };
+
+// Results kept for waiters that ask after their frame was detected
+static const size_t RECENT_RESULTS = 16;
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool FramePipelineConfig::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Cannot open pipeline config " << path << std::endl;
+        return false;
+    }
+
+    Json::Value root;
+    Json::CharReaderBuilder builder;
+    JSONCPP_STRING err;
+    if (!Json::parseFromStream(builder, file, &root, &err)) {
+        std::cerr << "Error parsing pipeline config: " << err << std::endl;
+        return false;
+    }
+
+    decodeQueue = std::max(1, root.get("decode_queue", decodeQueue).asInt());
+    detectQueue = std::max(1, root.get("detect_queue", detectQueue).asInt());
+    archiveQueue = std::max(1, root.get("archive_queue", archiveQueue).asInt());
+    return true;
+}
+
+FramePipeline::FramePipeline(Camera& camera, ImageProcessor& processor, Feeder& feeder,
+                             const FramePipelineConfig& config)
+    : m_camera(camera),
+      m_processor(processor),
+      m_feeder(feeder),
+      m_startNs(nowNs()),
+      m_nextFrame(1),
+      m_decodeRing(config.decodeQueue),
+      m_detectRing(config.detectQueue),
+      m_archiveRing(config.archiveQueue) {
+    m_decodeThread = std::thread(&FramePipeline::decodeStage, this);
+    m_detectThread = std::thread(&FramePipeline::detectStage, this);
+    m_archiveThread = std::thread(&FramePipeline::archiveStage, this);
+}
+
+FramePipeline::~FramePipeline() {
+    stop();
+}
+
+void FramePipeline::capture(std::vector<CaptureCallback> waiters) {
+    Frame frame;
+    frame.id = m_nextFrame++;
+    frame.waiters = std::move(waiters);
+
+    int64_t start = nowNs();
+    frame.path = m_camera.captureFile(frame.id);
+    record(CAPTURE, start, !frame.path.empty());
+    if (frame.path.empty()) {
+        failCapture(frame);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_inFlight[frame.id];
+    }
+    Frame dropped;
+    if (m_decodeRing.push(std::move(frame), dropped)) {
+        m_stages[DECODE].dropped++;
+        failCapture(dropped);
+        resolve(dropped.id, false, {});
+    }
+    updatePeak(DECODE, m_decodeRing.size());
+}
+
+void FramePipeline::awaitDetection(uint64_t frame, DetectCallback done) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto waiting = m_inFlight.find(frame);
+    if (waiting != m_inFlight.end()) {
+        waiting->second.push_back(std::move(done));
+        return;
+    }
+
+    auto recent = std::find_if(m_recent.begin(), m_recent.end(),
+                               [frame](const Result& result) { return result.id == frame; });
+    if (recent == m_recent.end()) {
+        lock.unlock();
+        done(false, {}); // Unknown or too old
+        return;
+    }
+    Result result = *recent;
+    lock.unlock();
+    done(result.ok, result.event);
+}
+
+void FramePipeline::stop() {
+    // Each stage drains its ring into the next before that one is closed
+    std::call_once(m_stopped, [this]() {
+        m_decodeRing.close();
+        m_decodeThread.join();
+        m_detectRing.close();
+        m_detectThread.join();
+        m_archiveRing.close();
+        m_archiveThread.join();
+    });
+}
+
+std::vector<FramePipeline::StageStats> FramePipeline::stats() const {
+    double elapsedNs = static_cast<double>(nowNs() - m_startNs);
+    const size_t queued[] = { 0, m_decodeRing.size(), m_detectRing.size(), m_archiveRing.size() };
+    const size_t capacity[] = { 0, m_decodeRing.capacity(), m_detectRing.capacity(), m_archiveRing.capacity() };
+
+    std::vector<StageStats> stats;
+    for (int stage = 0; stage < STAGES; ++stage) {
+        const StageCounters& counters = m_stages[stage];
+        StageStats entry;
+        entry.name = STAGE_NAMES[stage];
+        entry.queued = queued[stage];
+        entry.capacity = capacity[stage];
+        entry.peak = counters.peak;
+        entry.processed = counters.processed;
+        entry.dropped = counters.dropped;
+        entry.failed = counters.failed;
+        entry.utilisation = elapsedNs > 0 ? counters.busyNs / elapsedNs : 0.0;
+        entry.avgMs = entry.processed ? counters.busyNs / 1e6 / entry.processed : 0.0;
+        stats.push_back(entry);
+    }
+    return stats;
+}
+
+void FramePipeline::decodeStage() {
+    realtime::applyThreadPolicy(realtime::ThreadRole::Camera);
+    Frame frame;
+    while (m_decodeRing.pop(frame)) {
+        int64_t start = nowNs();
+        frame.image = m_camera.decode(frame.path);
+        record(DECODE, start, !frame.image.empty());
+        if (frame.image.empty()) {
+            failCapture(frame);
+            resolve(frame.id, false, {});
+            continue;
+        }
+
+        for (auto& waiter : frame.waiters) {
+            waiter(true, frame.id);
+        }
+        frame.waiters.clear();
+
+        Frame dropped;
+        if (m_detectRing.push(std::move(frame), dropped)) {
+            m_stages[DETECT].dropped++;
+            resolve(dropped.id, false, {});
+        }
+        updatePeak(DETECT, m_detectRing.size());
+        frame = Frame();
+    }
+}
+
+void FramePipeline::detectStage() {
+    realtime::applyThreadPolicy(realtime::ThreadRole::Detection);
+    Frame frame;
+    while (m_detectRing.pop(frame)) {
+        int64_t start = nowNs();
+        Detected detected;
+        detected.id = frame.id;
+        detected.event = m_processor.process(frame.image);
+        record(DETECT, start, true);
+        resolve(detected.id, true, detected.event);
+
+        Detected dropped;
+        if (m_archiveRing.push(std::move(detected), dropped)) {
+            m_stages[ARCHIVE].dropped++;
+        }
+        updatePeak(ARCHIVE, m_archiveRing.size());
+        frame = Frame();
+    }
+}
+
+void FramePipeline::archiveStage() {
+    realtime::applyThreadPolicy(realtime::ThreadRole::Main);
+    Detected detected;
+    while (m_archiveRing.pop(detected)) {
+        int64_t start = nowNs();
+        bool saved = m_feeder.saveImage(detected.event.image, detected.event.fishDetected);
+        record(ARCHIVE, start, saved);
+        detected = Detected();
+    }
+}
+
+void FramePipeline::failCapture(Frame& frame) {
+    for (auto& waiter : frame.waiters) {
+        waiter(false, frame.id);
+    }
+    frame.waiters.clear();
+}
+
+void FramePipeline::resolve(uint64_t frame, bool ok, const ImageProcessor::DetectionEvent& event) {
+    std::vector<DetectCallback> waiters;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto waiting = m_inFlight.find(frame);
+        if (waiting != m_inFlight.end()) {
+            waiters = std::move(waiting->second);
+            m_inFlight.erase(waiting);
+        }
+        m_recent.push_back({ frame, ok, event });
+        if (m_recent.size() > RECENT_RESULTS) {
+            m_recent.pop_front();
+        }
+    }
+    for (auto& waiter : waiters) {
+        waiter(ok, event);
+    }
+}
+
+void FramePipeline::record(Stage stage, int64_t startNs, bool ok) {
+    StageCounters& counters = m_stages[stage];
+    counters.busyNs += nowNs() - startNs;
+    counters.processed++;
+    if (!ok) {
+        counters.failed++;
+    }
+}
+
+void FramePipeline::updatePeak(Stage stage, size_t queued) {
+    // Only the stage's producer updates it
+    if (queued > m_stages[stage].peak) {
+        m_stages[stage].peak = queued;
+    }
+}
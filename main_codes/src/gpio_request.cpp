@@ -0,0 +1,109 @@
+#include "gpio_request.h"
+#include <cerrno>
+#include <cstdint>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace gpio {
+
+std::string chipPath(int chipNumber) {
+    return "/dev/gpiochip" + std::to_string(chipNumber);
+}
+
+gpiod_line_request* requestLines(const std::string& chipPath, const std::vector<unsigned int>& offsets,
+                                 const LineSettings& settings, const char* consumer) {
+    gpiod_chip* chip = gpiod_chip_open(chipPath.c_str());
+    if (!chip) {
+        return nullptr;
+    }
+
+    gpiod_line_settings* lineSettings = gpiod_line_settings_new();
+    gpiod_line_config* lineConfig = gpiod_line_config_new();
+    gpiod_request_config* requestConfig = gpiod_request_config_new();
+    gpiod_line_request* request = nullptr;
+
+    if (lineSettings && lineConfig && requestConfig) {
+        bool ok;
+        if (settings.output) {
+            ok = gpiod_line_settings_set_direction(lineSettings, GPIOD_LINE_DIRECTION_OUTPUT) == 0 &&
+                 gpiod_line_settings_set_output_value(lineSettings, settings.initialValue ?
+                     GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE) == 0;
+        } else {
+            ok = gpiod_line_settings_set_direction(lineSettings, GPIOD_LINE_DIRECTION_INPUT) == 0 &&
+                 gpiod_line_settings_set_edge_detection(lineSettings, settings.bothEdges ?
+                     GPIOD_LINE_EDGE_BOTH : (settings.fallingEdge ?
+                     GPIOD_LINE_EDGE_FALLING : GPIOD_LINE_EDGE_NONE)) == 0 &&
+                 gpiod_line_settings_set_event_clock(lineSettings, settings.eventClock) == 0;
+            gpiod_line_settings_set_debounce_period_us(lineSettings, settings.debounceUs);
+        }
+
+        if (ok && gpiod_line_config_add_line_settings(lineConfig, offsets.data(), offsets.size(), lineSettings) == 0) {
+            gpiod_request_config_set_consumer(requestConfig, consumer);
+            if (settings.eventBufferSize > 0) {
+                gpiod_request_config_set_event_buffer_size(requestConfig, settings.eventBufferSize);
+            }
+            request = gpiod_chip_request_lines(chip, requestConfig, lineConfig);
+        }
+    }
+
+    // The request keeps its own file descriptor, none of these are needed any more
+    if (requestConfig) {
+        gpiod_request_config_free(requestConfig);
+    }
+    if (lineConfig) {
+        gpiod_line_config_free(lineConfig);
+    }
+    if (lineSettings) {
+        gpiod_line_settings_free(lineSettings);
+    }
+    gpiod_chip_close(chip);
+    return request;
+}
+
+Wakeup::Wakeup() : m_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+    if (m_fd < 0) {
+        throw std::runtime_error("Failed to create eventfd");
+    }
+}
+
+Wakeup::~Wakeup() {
+    close(m_fd);
+}
+
+void Wakeup::signal() {
+    uint64_t one = 1;
+    ssize_t r = write(m_fd, &one, sizeof(one));
+    (void)r; // Only fails if the counter is saturated, still readable then
+}
+
+void Wakeup::clear() {
+    uint64_t value;
+    ssize_t r = read(m_fd, &value, sizeof(value));
+    (void)r; // EAGAIN when nothing was signalled
+}
+
+int waitEdgeEvents(gpiod_line_request* request, const Wakeup& wakeup, int64_t timeoutNs) {
+    pollfd fds[2] = {
+        { gpiod_line_request_get_fd(request), POLLIN, 0 },
+        { wakeup.fd(), POLLIN, 0 },
+    };
+    timespec ts;
+    timespec* timeout = nullptr;
+    if (timeoutNs >= 0) {
+        ts = { static_cast<time_t>(timeoutNs / 1000000000), static_cast<long>(timeoutNs % 1000000000) };
+        timeout = &ts;
+    }
+
+    int r;
+    do {
+        r = ppoll(fds, 2, timeout, nullptr);
+    } while (r < 0 && errno == EINTR);
+    if (r < 0) {
+        return -1;
+    }
+    return (fds[0].revents & POLLIN) ? 1 : 0;
+}
+
+} // namespace gpio
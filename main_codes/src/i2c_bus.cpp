@@ -0,0 +1,220 @@
+#include "i2c_bus.h"
+#include <jsoncpp/json/json.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include <sys/ioctl.h>
+#include <thread>
+#include <unistd.h>
+
+// Device name that opens the bus without an adapter
+static const char* EMULATED_DEVICE = "emulated";
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// NAK, arbitration loss or a stretched clock, worth another attempt
+static bool isTransient(int error) {
+    return error == EREMOTEIO || error == ENXIO || error == EIO ||
+           error == ETIMEDOUT || error == EAGAIN;
+}
+
+bool I2cBusConfig::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Cannot open I2C config " << path << std::endl;
+        return false;
+    }
+
+    Json::Value root;
+    Json::CharReaderBuilder builder;
+    JSONCPP_STRING err;
+    if (!Json::parseFromStream(builder, file, &root, &err)) {
+        std::cerr << "Error parsing I2C config: " << err << std::endl;
+        return false;
+    }
+
+    device = root.get("device", device).asString();
+    retries = std::max(0, root.get("retries", retries).asInt());
+    backoffUs = std::max(0, root.get("backoff_us", backoffUs).asInt());
+    return true;
+}
+
+I2cBus::I2cBus(const I2cBusConfig& config)
+    : m_config(config),
+      m_fd(-1),
+      m_emulated(false) {
+}
+
+I2cBus::~I2cBus() {
+    close();
+}
+
+bool I2cBus::open() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_fd >= 0 || m_emulated) {
+        return true;
+    }
+    if (m_config.device == EMULATED_DEVICE) {
+        m_emulated = true;
+        return true;
+    }
+    m_fd = ::open(m_config.device.c_str(), O_RDWR | O_CLOEXEC);
+    if (m_fd < 0) {
+        std::cerr << "Failed to open I2C device " << m_config.device << std::endl;
+        return false;
+    }
+
+    unsigned long functions = 0;
+    if (ioctl(m_fd, I2C_FUNCS, &functions) < 0 || !(functions & I2C_FUNC_I2C)) {
+        std::cerr << "I2C adapter " << m_config.device << " has no combined transfers" << std::endl;
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    return true;
+}
+
+void I2cBus::close() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    m_emulated = false;
+}
+
+bool I2cBus::isOpen() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_fd >= 0 || m_emulated;
+}
+
+void I2cBus::attach(uint8_t address, I2cDevice* device) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (device) {
+        m_devices[address] = device;
+    } else {
+        m_devices.erase(address);
+    }
+}
+
+bool I2cBus::writeRegister(uint8_t address, uint8_t reg, uint16_t value) {
+    uint8_t bytes[3] = {
+        reg,
+        static_cast<uint8_t>((value >> 8) & 0xFF),
+        static_cast<uint8_t>(value & 0xFF)
+    };
+    return write(address, bytes, sizeof(bytes));
+}
+
+bool I2cBus::readRegister(uint8_t address, uint8_t reg, uint16_t& value) {
+    uint8_t data[2];
+    if (!writeRead(address, &reg, 1, data, sizeof(data))) {
+        return false;
+    }
+    value = static_cast<uint16_t>((data[0] << 8) | data[1]);
+    return true;
+}
+
+bool I2cBus::write(uint8_t address, const uint8_t* data, size_t length) {
+    return writeRead(address, data, length, nullptr, 0);
+}
+
+bool I2cBus::read(uint8_t address, uint8_t* data, size_t length) {
+    return writeRead(address, nullptr, 0, data, length);
+}
+
+bool I2cBus::writeRead(uint8_t address, const uint8_t* out, size_t outLength, uint8_t* in, size_t inLength) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Counters& counters = m_counters[address];
+    counters.transactions++;
+    if (m_fd < 0 && !m_emulated) {
+        counters.failures++;
+        return false;
+    }
+
+    int64_t startNs = nowNs();
+    int backoffUs = m_config.backoffUs;
+    bool ok = transfer(address, out, outLength, in, inLength);
+    int error = ok ? 0 : errno;
+    for (int attempt = 0; !ok && attempt < m_config.retries && isTransient(error); ++attempt) {
+        // The bus stays ours while backing off, the retry keeps its place in line
+        counters.retries++;
+        std::this_thread::sleep_for(std::chrono::microseconds(backoffUs));
+        backoffUs *= 2;
+        ok = transfer(address, out, outLength, in, inLength);
+        error = ok ? 0 : errno;
+    }
+
+    int64_t elapsedNs = nowNs() - startNs;
+    counters.totalNs += elapsedNs;
+    counters.maxNs = std::max(counters.maxNs, elapsedNs);
+    if (!ok) {
+        counters.failures++;
+        std::cerr << "I2C transfer to 0x" << std::hex << static_cast<int>(address) << std::dec
+                  << " failed: " << strerror(error) << std::endl;
+    }
+    return ok;
+}
+
+std::vector<I2cBus::DeviceStats> I2cBus::stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<DeviceStats> stats;
+    for (const auto& entry : m_counters) {
+        const Counters& counters = entry.second;
+        DeviceStats device;
+        device.address = entry.first;
+        device.transactions = counters.transactions;
+        device.retries = counters.retries;
+        device.failures = counters.failures;
+        device.avgUs = counters.transactions ? counters.totalNs / 1e3 / counters.transactions : 0.0;
+        device.maxUs = counters.maxNs / 1e3;
+        stats.push_back(device);
+    }
+    return stats;
+}
+
+bool I2cBus::transfer(uint8_t address, const uint8_t* out, size_t outLength, uint8_t* in, size_t inLength) {
+    auto device = m_devices.find(address);
+    if (device != m_devices.end()) {
+        return device->second->transfer(out, outLength, in, inLength);
+    }
+    if (m_fd < 0) {
+        // Nothing at this address on an emulated bus
+        errno = ENXIO;
+        return false;
+    }
+
+    struct i2c_msg messages[2];
+    int count = 0;
+    if (outLength > 0) {
+        messages[count].addr = address;
+        messages[count].flags = 0;
+        messages[count].len = static_cast<uint16_t>(outLength);
+        messages[count].buf = const_cast<uint8_t*>(out);
+        count++;
+    }
+    if (inLength > 0) {
+        messages[count].addr = address;
+        messages[count].flags = I2C_M_RD;
+        messages[count].len = static_cast<uint16_t>(inLength);
+        messages[count].buf = in;
+        count++;
+    }
+    if (count == 0) {
+        return true;
+    }
+
+    struct i2c_rdwr_ioctl_data transaction;
+    transaction.msgs = messages;
+    transaction.nmsgs = count;
+    return ioctl(m_fd, I2C_RDWR, &transaction) == count;
+}
@@ -1,28 +1,32 @@
 #include "image_processor.h"
 #include <iostream>
 
-ImageProcessor::ImageProcessor() {}
-
-void ImageProcessor::registerCallback(FishDetectionCallbackInterface* callback) {
-    m_callbacks.push_back(callback);
+ImageProcessor::ImageProcessor(EventBus& bus, const std::string& imageTopic, const std::string& detectionTopic)
+    : m_detectionTopic(bus.topic<DetectionEvent>(detectionTopic)) {
+    // CPU-heavy, so off the camera job and onto the pool
+    if (!imageTopic.empty()) {
+        m_subscriptions.add(bus.topic<Camera::ImageEvent>(imageTopic), "image_processor", Delivery::Pool,
+                            [this](const Camera::ImageEvent& event) { imageReady(event.image); });
+    }
 }
 
 void ImageProcessor::imageReady(const cv::Mat& image) {
+    process(image);
+}
+
+ImageProcessor::DetectionEvent ImageProcessor::process(const cv::Mat& image) {
     std::cout << "Processing image for fish detection..." << std::endl;
     cv::Mat processedImage = image.clone();
     bool fishDetected = detectFish(processedImage);
     
     if (fishDetected) {
         std::cout << "Fish detected!" << std::endl;
-        for (auto& callback : m_callbacks) {
-            callback->fishDetected(processedImage);
-        }
     } else {
         std::cout << "No fish detected." << std::endl;
-        for (auto& callback : m_callbacks) {
-            callback->noFishDetected(processedImage);
-        }
     }
+    DetectionEvent event = {fishDetected, processedImage};
+    m_detectionTopic.publish(event);
+    return event;
 }
 
 
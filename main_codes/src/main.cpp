@@ -1,14 +1,42 @@
+#include "event_loop.h"
 #include "fish_monitoring_system.h"
+#include "realtime.h"
+#include <csignal>
+#include <cstdlib>
 #include <iostream>
+#include <string>
 
-int main() {
+int main(int argc, char* argv[]) {
+    // Real-time mode is opt-in: --realtime [--rt-core N] or AQUA_REALTIME=1
+    realtime::Config rtConfig;
+    const char* rtEnv = std::getenv("AQUA_REALTIME");
+    rtConfig.enabled = rtEnv && std::string(rtEnv) == "1";
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--realtime") {
+            rtConfig.enabled = true;
+        } else if (arg == "--rt-core" && i + 1 < argc) {
+            rtConfig.rtCore = std::atoi(argv[++i]);
+        } else {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            return 1;
+        }
+    }
+    
+    // Must happen before any thread exists so they all inherit the confinement
+    // and the blocked signals, which are then read from the event loop's signalfd
+    EventLoop::blockSignals({SIGINT, SIGTERM});
+    realtime::configure(rtConfig);
+    realtime::applyThreadPolicy(realtime::ThreadRole::Main);
+    
     try {
         // Create and start system
         FishMonitoringSystem system;
         system.start();
+        std::cout << realtime::report() << std::endl;
         
-        std::cout << "System is running. Press Enter to exit." << std::endl;
-        std::cin.get();
+        std::cout << "System is running. Press Enter or Ctrl+C to exit." << std::endl;
+        system.run();
         
         system.stop();
         std::cout << "System shut down. Goodbye!" << std::endl;
@@ -0,0 +1,201 @@
+#include "motion_trigger.h"
+#include <jsoncpp/json/json.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+static const int64_t NS_PER_MS = 1000000LL;
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool MotionTriggerConfig::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Cannot open trigger config " << path << std::endl;
+        return false;
+    }
+
+    Json::Value root;
+    Json::CharReaderBuilder builder;
+    JSONCPP_STRING err;
+    if (!Json::parseFromStream(builder, file, &root, &err)) {
+        std::cerr << "Error parsing trigger config: " << err << std::endl;
+        return false;
+    }
+
+    mode = root.get("mode", mode).asString();
+    fuseWindowMs = std::max(0, root.get("fuse_window_ms", fuseWindowMs).asInt());
+    return true;
+}
+
+MotionTrigger::MotionTrigger(EventBus& bus, VideoMotionDetector& video, const MotionTriggerConfig& config)
+    : m_video(video),
+      m_triggerTopic(bus.topic<TriggerEvent>("trigger")),
+      m_fuseWindowNs(config.fuseWindowMs * NS_PER_MS),
+      m_mode(Mode::Pir),
+      m_running(false),
+      m_lastPirNs(0),
+      m_lastVideoNs(0),
+      m_stats() {
+    if (!parseMode(config.mode, m_mode)) {
+        std::cerr << "Unknown trigger mode " << config.mode << ", using pir" << std::endl;
+    }
+
+    m_subscriptions.add(bus.topic<PirSensor::MotionEvent>("motion"), "trigger", Delivery::Inline,
+                        [this](const PirSensor::MotionEvent&) { pirMotion(); });
+    m_subscriptions.add(bus.topic<VideoMotionDetector::MotionEvent>("video_motion"), "trigger", Delivery::Inline,
+                        [this](const VideoMotionDetector::MotionEvent&) { videoMotion(); });
+}
+
+MotionTrigger::~MotionTrigger() {
+    stop();
+}
+
+void MotionTrigger::start() {
+    bool video;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = true;
+        video = m_mode != Mode::Pir;
+    }
+    if (video) {
+        m_video.start();
+    }
+}
+
+void MotionTrigger::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_video.stop();
+}
+
+void MotionTrigger::setMode(Mode mode) {
+    bool running;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_mode = mode;
+        m_lastPirNs = 0;
+        m_lastVideoNs = 0;
+        running = m_running;
+    }
+    std::cout << "Trigger mode set to: " << modeName(mode) << std::endl;
+    if (running && mode != Mode::Pir) {
+        m_video.start();
+    } else {
+        m_video.stop();
+    }
+}
+
+MotionTrigger::Mode MotionTrigger::mode() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_mode;
+}
+
+MotionTrigger::Stats MotionTrigger::stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats stats = m_stats;
+    stats.mode = m_mode;
+    return stats;
+}
+
+const char* MotionTrigger::modeName(Mode mode) {
+    switch (mode) {
+    case Mode::Pir:
+        return "pir";
+    case Mode::Camera:
+        return "camera";
+    case Mode::Fused:
+        return "fused";
+    }
+    return "unknown";
+}
+
+const char* MotionTrigger::sourceName(Source source) {
+    switch (source) {
+    case Source::Pir:
+        return "pir";
+    case Source::Camera:
+        return "camera";
+    case Source::Fused:
+        return "fused";
+    }
+    return "unknown";
+}
+
+bool MotionTrigger::parseMode(const std::string& name, Mode& mode) {
+    for (Mode candidate : { Mode::Pir, Mode::Camera, Mode::Fused }) {
+        if (name == modeName(candidate)) {
+            mode = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+void MotionTrigger::pirMotion() {
+    TriggerEvent event;
+    bool fire;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.pirReports++;
+        fire = report(Source::Pir, event);
+    }
+    if (fire) {
+        m_triggerTopic.publish(event);
+    }
+}
+
+void MotionTrigger::videoMotion() {
+    TriggerEvent event;
+    bool fire;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.videoReports++;
+        fire = report(Source::Camera, event);
+    }
+    if (fire) {
+        m_triggerTopic.publish(event);
+    }
+}
+
+bool MotionTrigger::report(Source source, TriggerEvent& event) {
+    int64_t now = nowNs();
+    event.timestampNs = static_cast<uint64_t>(now);
+    event.source = source;
+
+    if (m_mode != Mode::Fused) {
+        bool used = (m_mode == Mode::Pir) == (source == Source::Pir);
+        if (!used) {
+            m_stats.ignored++;
+            return false;
+        }
+        m_stats.triggers++;
+        return true;
+    }
+
+    int64_t& own = (source == Source::Pir) ? m_lastPirNs : m_lastVideoNs;
+    int64_t& other = (source == Source::Pir) ? m_lastVideoNs : m_lastPirNs;
+    if (other != 0 && now - other <= m_fuseWindowNs) {
+        // Both agree, the pair is used up
+        other = 0;
+        own = 0;
+        event.source = Source::Fused;
+        m_stats.triggers++;
+        return true;
+    }
+    if (other != 0) {
+        m_stats.unconfirmed++; // The other's report expired alone
+        other = 0;
+    }
+    if (own != 0) {
+        m_stats.unconfirmed++; // Replaced by this one
+    }
+    own = now;
+    return false;
+}
@@ -1,34 +1,27 @@
 #include "motor.h"
+#include "realtime.h"
 #include <iostream>
+#include <algorithm>
 #include <chrono>
-#include <thread>
 
 Motor::Motor(int motorPin, const char* chipPath) 
     : m_motorPin(motorPin), 
-      m_chip(nullptr), 
-      m_motorLine(nullptr), 
-      m_gpioInitialized(false) {
+      m_request(nullptr), 
+      m_gpioInitialized(false),
+      m_simulated(chipPath == nullptr) {
     
-    // Initialize GPIO
-    m_chip = gpiod_chip_open(chipPath);
-    if (!m_chip) {
-        std::cerr << "Failed to open GPIO chip for motor control!" << std::endl;
+    if (m_simulated) {
+        m_gpioInitialized = true;
+        std::cout << "Motor simulated on GPIO pin " << m_motorPin << std::endl;
         return;
     }
     
-    m_motorLine = gpiod_chip_get_line(m_chip, m_motorPin);
-    if (!m_motorLine) {
-        std::cerr << "Failed to get GPIO line for motor control!" << std::endl;
-        gpiod_chip_close(m_chip);
-        m_chip = nullptr;
-        return;
-    }
-    
-    if (gpiod_line_request_output(m_motorLine, "motor_control", 0) < 0) {
+    // Initialize GPIO, output starting low
+    gpio::LineSettings settings;
+    settings.output = true;
+    m_request = gpio::requestLines(chipPath, { static_cast<unsigned int>(m_motorPin) }, settings, "motor_control");
+    if (!m_request) {
         std::cerr << "Failed to request GPIO line as output for motor control!" << std::endl;
-        gpiod_chip_close(m_chip);
-        m_chip = nullptr;
-        m_motorLine = nullptr;
         return;
     }
     
@@ -39,49 +32,62 @@ Motor::Motor(int motorPin, const char* chipPath)
 Motor::~Motor() {
     stop();
     
-    if (m_motorLine) {
-        gpiod_line_release(m_motorLine);
+    if (m_request) {
+        gpiod_line_request_release(m_request);
     }
-    
-    if (m_chip) {
-        gpiod_chip_close(m_chip);
+}
+
+void Motor::registerCallback(EdgeCallbackInterface* callback) {
+    m_callbacks.push_back(callback);
+}
+
+void Motor::setLine(int value) {
+    if (!m_simulated) {
+        gpiod_line_request_set_value(m_request, m_motorPin,
+                                     value ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE);
+    }
+    if (!m_callbacks.empty()) {
+        auto now = std::chrono::steady_clock::now();
+        for (auto& callback : m_callbacks) {
+            callback->motorEdge(value, now);
+        }
     }
 }
 
 bool Motor::run(int dutyCycle, int periodMs, int durationMs) {
-    if (!m_gpioInitialized || !m_motorLine) {
-        std::cerr << "Cannot run motor: GPIO not initialized" << std::endl;
-        return false;
-    }
-    
     // Clamp duty cycle to 0-100 range
     dutyCycle = std::max(0, std::min(100, dutyCycle));
     
     std::cout << "Running motor at " << dutyCycle << "% duty cycle for " 
               << durationMs << "ms..." << std::endl;
     
-    auto startTime = std::chrono::steady_clock::now();
+    return play(MotorProfileLibrary::compile({{dutyCycle, periodMs, durationMs}}));
+}
+
+bool Motor::play(const EdgeTimeline& timeline) {
+    if (!m_gpioInitialized || (!m_request && !m_simulated)) {
+        std::cerr << "Cannot run motor: GPIO not initialized" << std::endl;
+        return false;
+    }
     
-    while (std::chrono::steady_clock::now() - startTime < std::chrono::milliseconds(durationMs)) {
-        if (dutyCycle > 0) {
-            // Turn ON the motor (HIGH)
-            gpiod_line_set_value(m_motorLine, 1);
-            std::this_thread::sleep_for(std::chrono::milliseconds(dutyCycle * periodMs / 100));
-        }
-        
-        if (dutyCycle < 100) {
-            // Turn OFF the motor (LOW)
-            gpiod_line_set_value(m_motorLine, 0);
-            std::this_thread::sleep_for(std::chrono::milliseconds((100 - dutyCycle) * periodMs / 100));
-        }
+    // Runs on the caller's thread, elevated for the duration in real-time mode
+    realtime::ScopedThreadPolicy policy(realtime::ThreadRole::Motor);
+    
+    // Every edge sleeps to an absolute deadline, so wakeup latency never accumulates
+    const int64_t startNs = monotonicNowNs();
+    for (const auto& edge : timeline.edges) {
+        sleepUntilNs(startNs + edge.atNs);
+        setLine(edge.value);
     }
+    sleepUntilNs(startNs + timeline.durationNs);
+    setLine(0);
     
     return true;
 }
 
 void Motor::stop() {
-    if (m_gpioInitialized && m_motorLine) {
-        gpiod_line_set_value(m_motorLine, 0);
+    if (m_gpioInitialized && (m_request || m_simulated)) {
+        setLine(0);
         std::cout << "Motor stopped" << std::endl;
     }
 }
@@ -1,66 +1,482 @@
+#include "gpio_request.h"
 #include "motor.h"
+#include "realtime.h"
+#include <jsoncpp/json/json.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <time.h>
+#include <vector>
+
+/**
+ * Motor characterisation benchmark
+ *
+ * Sweeps duty cycle, PWM period and duration, captures the output waveform
+ * and reports effective duty, edge jitter and CPU cost per profile as CSV or JSON.
+ *
+ * The waveform is taken either from the line writes themselves (simulated line
+ * or real pin) or from a loopback input pin wired to the motor pin.
+ */
+
+namespace {
+
+// One observed line level change (or write) with a monotonic timestamp
+struct Sample {
+    int64_t ns;
+    int value;
+};
+
+struct Options {
+    int motorPin = 4;
+    std::string chipPath = "/dev/gpiochip0";
+    bool simulate = false;
+    bool realtime = false;
+    int loopbackPin = -1;
+    std::vector<int> duties = {25, 50, 75, 100};
+    std::vector<int> periods = {5, 10, 20};
+    std::vector<int> durations = {1000};
+    int restMs = 200;
+    std::string format = "csv";
+    std::string outputPath;
+};
+
+struct Result {
+    int dutyCycle;
+    int periodMs;
+    int durationMs;
+    size_t writes;
+    size_t transitions;
+    double effectiveDuty;
+    double jitterMeanUs;
+    double jitterStddevUs;
+    double jitterMaxUs;
+    double cpuMs;
+    double wallMs;
+    std::string source;
+};
+
+int64_t toNs(const timespec& ts) {
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+int64_t threadCpuNs() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return toNs(ts);
+}
+
+std::vector<int> parseList(const std::string& arg) {
+    std::vector<int> values;
+    std::stringstream ss(arg);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        values.push_back(std::stoi(item));
+    }
+    return values;
+}
+
+/**
+ * Records every write to the motor line
+ */
+class WriteRecorder : public Motor::EdgeCallbackInterface {
+public:
+    void motorEdge(int value, std::chrono::steady_clock::time_point t) override {
+        m_samples.push_back({std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                 t.time_since_epoch()).count(), value});
+    }
+
+    void reset(size_t expected) {
+        m_samples.clear();
+        m_samples.reserve(expected);
+    }
+
+    const std::vector<Sample>& samples() const { return m_samples; }
+
+private:
+    std::vector<Sample> m_samples;
+};
+
+/**
+ * Captures edges on an input pin wired back from the motor pin
+ */
+class LoopbackCapture {
+public:
+    LoopbackCapture(const char* chipPath, int pin) : m_request(nullptr), m_buffer(nullptr), m_running(false) {
+        gpio::LineSettings settings;
+        settings.bothEdges = true;
+        settings.eventBufferSize = EVENT_BUFFER_SIZE;
+        m_request = gpio::requestLines(chipPath, { static_cast<unsigned int>(pin) }, settings, "motor_loopback");
+        if (!m_request) {
+            throw std::runtime_error("Failed to request loopback line events");
+        }
+        m_buffer = gpiod_edge_event_buffer_new(EVENT_BUFFER_SIZE);
+        if (!m_buffer) {
+            gpiod_line_request_release(m_request);
+            throw std::runtime_error("Failed to allocate loopback event buffer");
+        }
+    }
+
+    ~LoopbackCapture() {
+        stop();
+        gpiod_edge_event_buffer_free(m_buffer);
+        gpiod_line_request_release(m_request);
+    }
+
+    void start(size_t expected) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_samples.clear();
+            m_samples.reserve(expected);
+        }
+        m_wakeup.clear();
+        m_running = true;
+        m_thread = std::thread(&LoopbackCapture::worker, this);
+    }
+
+    void stop() {
+        m_running = false;
+        m_wakeup.signal();
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+    }
+
+    std::vector<Sample> samples() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_samples;
+    }
+
+private:
+    void worker() {
+        while (m_running) {
+            int r = gpio::waitEdgeEvents(m_request, m_wakeup, -1);
+            if (r < 0) {
+                std::cerr << "Error while waiting for loopback event" << std::endl;
+                return;
+            }
+            if (r == 1) {
+                // A fast PWM queues many edges per wakeup, drain them together
+                int count = gpiod_line_request_read_edge_events(m_request, m_buffer, EVENT_BUFFER_SIZE);
+                std::lock_guard<std::mutex> lock(m_mutex);
+                for (int i = 0; i < count; ++i) {
+                    gpiod_edge_event* event = gpiod_edge_event_buffer_get_event(m_buffer, i);
+                    int value = gpiod_edge_event_get_event_type(event) == GPIOD_EDGE_EVENT_RISING_EDGE ? 1 : 0;
+                    m_samples.push_back({static_cast<int64_t>(gpiod_edge_event_get_timestamp_ns(event)), value});
+                }
+            }
+        }
+    }
+
+    static const size_t EVENT_BUFFER_SIZE = 256;
+
+    gpiod_line_request* m_request;
+    gpiod_edge_event_buffer* m_buffer;
+    gpio::Wakeup m_wakeup;
+    std::atomic<bool> m_running;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::vector<Sample> m_samples;
+};
+
+/**
+ * Compute effective duty and rising edge jitter from a captured waveform.
+ * The window runs from the first to the last sample, the last one being
+ * the falling edge written by Motor::stop().
+ */
+void analyse(const std::vector<Sample>& samples, Result& result) {
+    result.transitions = 0;
+    result.effectiveDuty = 0.0;
+    result.jitterMeanUs = 0.0;
+    result.jitterStddevUs = 0.0;
+    result.jitterMaxUs = 0.0;
+    if (samples.size() < 2) {
+        return;
+    }
+
+    int64_t highNs = 0;
+    int level = samples.front().value;
+    int64_t levelSince = samples.front().ns;
+    std::vector<int64_t> risingEdges;
+    if (level == 1) {
+        risingEdges.push_back(levelSince);
+    }
+
+    for (size_t i = 1; i < samples.size(); ++i) {
+        if (samples[i].value == level) {
+            continue; // Repeated write of the same level, not an edge
+        }
+        if (level == 1) {
+            highNs += samples[i].ns - levelSince;
+        } else {
+            risingEdges.push_back(samples[i].ns);
+        }
+        level = samples[i].value;
+        levelSince = samples[i].ns;
+        result.transitions++;
+    }
+
+    int64_t windowNs = samples.back().ns - samples.front().ns;
+    if (windowNs > 0) {
+        result.effectiveDuty = 100.0 * highNs / windowNs;
+    }
+
+    if (risingEdges.size() < 2) {
+        return;
+    }
+
+    // Jitter is the deviation of each rising-to-rising interval from the nominal period
+    const double nominalUs = result.periodMs * 1000.0;
+    double sum = 0.0;
+    double sumSq = 0.0;
+    double maxDev = 0.0;
+    for (size_t i = 1; i < risingEdges.size(); ++i) {
+        double dev = (risingEdges[i] - risingEdges[i - 1]) / 1000.0 - nominalUs;
+        sum += dev;
+        sumSq += dev * dev;
+        maxDev = std::max(maxDev, std::fabs(dev));
+    }
+    double n = static_cast<double>(risingEdges.size() - 1);
+    result.jitterMeanUs = sum / n;
+    result.jitterStddevUs = std::sqrt(std::max(0.0, sumSq / n - result.jitterMeanUs * result.jitterMeanUs));
+    result.jitterMaxUs = maxDev;
+}
+
+void printUsage(const char* name) {
+    std::cerr << "Usage: " << name << " [options]\n"
+              << "  --pin N           Motor GPIO pin (default 4)\n"
+              << "  --chip PATH       GPIO chip (default /dev/gpiochip0)\n"
+              << "  --simulate        Drive a simulated line instead of GPIO\n"
+              << "  --realtime        Play profiles with the real-time policy (SCHED_FIFO, pinned)\n"
+              << "  --loopback N      Capture the waveform on input pin N wired to the motor pin\n"
+              << "  --duty LIST       Duty cycles in percent (default 25,50,75,100)\n"
+              << "  --period LIST     PWM periods in ms (default 5,10,20)\n"
+              << "  --duration LIST   Run durations in ms (default 1000)\n"
+              << "  --rest MS         Motor off time between profiles (default 200)\n"
+              << "  --format csv|json Output format (default csv)\n"
+              << "  --output FILE     Write results to FILE instead of stdout\n";
+}
+
+bool parseOptions(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("Missing value for " + arg);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--pin") {
+            options.motorPin = std::stoi(next());
+        } else if (arg == "--chip") {
+            options.chipPath = next();
+        } else if (arg == "--simulate") {
+            options.simulate = true;
+        } else if (arg == "--realtime") {
+            options.realtime = true;
+        } else if (arg == "--loopback") {
+            options.loopbackPin = std::stoi(next());
+        } else if (arg == "--duty") {
+            options.duties = parseList(next());
+        } else if (arg == "--period") {
+            options.periods = parseList(next());
+        } else if (arg == "--duration") {
+            options.durations = parseList(next());
+        } else if (arg == "--rest") {
+            options.restMs = std::stoi(next());
+        } else if (arg == "--format") {
+            options.format = next();
+        } else if (arg == "--output") {
+            options.outputPath = next();
+        } else if (arg == "--help" || arg == "-h") {
+            return false;
+        } else {
+            // Bare number keeps the old "motor_test_program <pin>" form working
+            options.motorPin = std::stoi(arg);
+        }
+    }
+
+    if (options.format != "csv" && options.format != "json") {
+        throw std::invalid_argument("Unknown format: " + options.format);
+    }
+    if (options.simulate && options.loopbackPin >= 0) {
+        throw std::invalid_argument("--loopback needs a real motor line, not --simulate");
+    }
+    return true;
+}
+
+void writeCSV(std::ostream& out, const std::vector<Result>& results) {
+    out << "duty,period_ms,duration_ms,writes,transitions,effective_duty,duty_error,"
+        << "jitter_mean_us,jitter_stddev_us,jitter_max_us,cpu_ms,wall_ms,cpu_percent,source\n";
+    for (const auto& r : results) {
+        out << r.dutyCycle << ',' << r.periodMs << ',' << r.durationMs << ','
+            << r.writes << ',' << r.transitions << ','
+            << r.effectiveDuty << ',' << (r.effectiveDuty - r.dutyCycle) << ','
+            << r.jitterMeanUs << ',' << r.jitterStddevUs << ',' << r.jitterMaxUs << ','
+            << r.cpuMs << ',' << r.wallMs << ',' << (r.wallMs > 0 ? 100.0 * r.cpuMs / r.wallMs : 0.0) << ','
+            << r.source << '\n';
+    }
+}
+
+void writeJSON(std::ostream& out, const std::vector<Result>& results) {
+    Json::Value root(Json::arrayValue);
+    for (const auto& r : results) {
+        Json::Value entry;
+        entry["duty"] = r.dutyCycle;
+        entry["period_ms"] = r.periodMs;
+        entry["duration_ms"] = r.durationMs;
+        entry["writes"] = static_cast<Json::UInt64>(r.writes);
+        entry["transitions"] = static_cast<Json::UInt64>(r.transitions);
+        entry["effective_duty"] = r.effectiveDuty;
+        entry["duty_error"] = r.effectiveDuty - r.dutyCycle;
+        entry["jitter_mean_us"] = r.jitterMeanUs;
+        entry["jitter_stddev_us"] = r.jitterStddevUs;
+        entry["jitter_max_us"] = r.jitterMaxUs;
+        entry["cpu_ms"] = r.cpuMs;
+        entry["wall_ms"] = r.wallMs;
+        entry["cpu_percent"] = r.wallMs > 0 ? 100.0 * r.cpuMs / r.wallMs : 0.0;
+        entry["source"] = r.source;
+        root.append(entry);
+    }
+    Json::StreamWriterBuilder builder;
+    out << Json::writeString(builder, root) << std::endl;
+}
+
+} // namespace
 
 int main(int argc, char* argv[]) {
-    int motorPin = 4;  // Default GPIO pin
-    
-    // Allow pin override via command line
-    if (argc > 1) {
-        try {
-            motorPin = std::stoi(argv[1]);
-        } catch (const std::exception& e) {
-            std::cerr << "Invalid pin number: " << argv[1] << std::endl;
+    Options options;
+    try {
+        if (!parseOptions(argc, argv, options)) {
+            printUsage(argv[0]);
+            return 0;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Invalid arguments: " << e.what() << std::endl;
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    // Results go to stdout (or --output); progress chatter from Motor goes to stderr
+    std::ofstream file;
+    std::ostream results(std::cout.rdbuf());
+    if (!options.outputPath.empty()) {
+        file.open(options.outputPath);
+        if (!file) {
+            std::cerr << "Cannot open output file " << options.outputPath << std::endl;
             return 1;
         }
+        results.rdbuf(file.rdbuf());
     }
-    
-    std::cout << "Motor Test Program" << std::endl;
-    std::cout << "==================" << std::endl;
-    std::cout << "Using GPIO pin: " << motorPin << std::endl;
-    
+    std::cout.rdbuf(std::cerr.rdbuf());
+
+    realtime::Config rtConfig;
+    rtConfig.enabled = options.realtime;
+    realtime::configure(rtConfig);
+
+    std::cerr << "Motor Characterisation" << std::endl;
+    std::cerr << "======================" << std::endl;
+    std::cerr << "Motor pin: " << options.motorPin
+              << (options.simulate ? " (simulated)" : "") << std::endl;
+
     try {
-        // Create motor controller
-        Motor motor(motorPin);
-        
+        Motor motor(options.motorPin, options.simulate ? nullptr : options.chipPath.c_str());
         if (!motor.isInitialized()) {
-            std::cerr << "Failed to initialize motor on pin " << motorPin << std::endl;
+            std::cerr << "Failed to initialize motor on pin " << options.motorPin << std::endl;
             return 1;
         }
-        
-        // Run motor sequence
-        std::cout << "\nMotor Test Sequence:" << std::endl;
-        std::cout << "-------------------" << std::endl;
-        
-        std::cout << "100% duty cycle (Full speed) for 2 seconds" << std::endl;
-        motor.run(100, 10, 2000);
-        
-        std::cout << "50% duty cycle for 2 seconds" << std::endl;
-        motor.run(50, 10, 2000);
-        
-        std::cout << "25% duty cycle for 2 seconds" << std::endl;
-        motor.run(25, 10, 2000);
-        
-        std::cout << "0% duty cycle (OFF) for 2 seconds" << std::endl;
-        motor.run(0, 10, 2000);
-        
-        std::cout << "Ramp up sequence..." << std::endl;
-        for (int i = 0; i <= 100; i += 10) {
-            std::cout << i << "% duty cycle" << std::endl;
-            motor.run(100, 10, 500);
+
+        WriteRecorder recorder;
+        motor.registerCallback(&recorder);
+
+        std::unique_ptr<LoopbackCapture> loopback;
+        if (options.loopbackPin >= 0) {
+            loopback = std::make_unique<LoopbackCapture>(options.chipPath.c_str(), options.loopbackPin);
+            std::cerr << "Loopback capture on pin " << options.loopbackPin << std::endl;
         }
-        
-        
-        
-        std::cout << "Stopping motor..." << std::endl;
-        motor.stop();
-        
-        std::cout << "\nTest complete!" << std::endl;
-        
+
+        std::vector<Result> all;
+        for (int duration : options.durations) {
+            for (int period : options.periods) {
+                for (int duty : options.duties) {
+                    std::cerr << "Profile: duty=" << duty << "% period=" << period
+                              << "ms duration=" << duration << "ms" << std::endl;
+
+                    // Two writes per period plus the final stop
+                    size_t expected = 2 * static_cast<size_t>(duration / std::max(1, period)) + 8;
+                    recorder.reset(expected);
+                    if (loopback) {
+                        loopback->start(expected);
+                    }
+
+                    auto wallStart = std::chrono::steady_clock::now();
+                    int64_t cpuStart = threadCpuNs();
+                    motor.run(duty, period, duration);
+                    motor.stop();
+                    int64_t cpuEnd = threadCpuNs();
+                    auto wallEnd = std::chrono::steady_clock::now();
+
+                    Result result{};
+                    result.dutyCycle = std::max(0, std::min(100, duty));
+                    result.periodMs = period;
+                    result.durationMs = duration;
+                    result.writes = recorder.samples().size();
+                    result.cpuMs = (cpuEnd - cpuStart) / 1e6;
+                    result.wallMs = std::chrono::duration<double, std::milli>(wallEnd - wallStart).count();
+
+                    if (loopback) {
+                        // Give the last edge time to arrive before stopping the capture
+                        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                        loopback->stop();
+                        analyse(loopback->samples(), result);
+                        result.source = "loopback";
+                    } else {
+                        analyse(recorder.samples(), result);
+                        result.source = motor.isSimulated() ? "simulated" : "writes";
+                    }
+                    all.push_back(result);
+
+                    std::this_thread::sleep_for(std::chrono::milliseconds(options.restMs));
+                }
+            }
+        }
+
+        if (options.format == "json") {
+            writeJSON(results, all);
+        } else {
+            writeCSV(results, all);
+        }
+
+        // Cheapest profile per duty cycle, the figure we choose feed profiles by
+        std::cerr << "\nLowest CPU cost per duty cycle:" << std::endl;
+        for (int duty : options.duties) {
+            const Result* best = nullptr;
+            for (const auto& r : all) {
+                if (r.dutyCycle == std::max(0, std::min(100, duty)) &&
+                    (!best || r.cpuMs / r.wallMs < best->cpuMs / best->wallMs)) {
+                    best = &r;
+                }
+            }
+            if (best) {
+                std::cerr << "  " << best->dutyCycle << "%: period " << best->periodMs << "ms, "
+                          << best->cpuMs << "ms CPU over " << best->wallMs << "ms, effective duty "
+                          << best->effectiveDuty << "%" << std::endl;
+            }
+        }
+
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
         return 1;
     }
-    
+
     return 0;
 }
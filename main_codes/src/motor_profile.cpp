@@ -0,0 +1,173 @@
+#include "motor_profile.h"
+#include <jsoncpp/json/json.h>
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <iostream>
+#include <time.h>
+
+namespace {
+
+const int64_t NS_PER_MS = 1000000;
+const int64_t NS_PER_SEC = 1000000000;
+
+/**
+ * Expand one config segment into duty cycle steps
+ * steady: {duty, period, duration}
+ * ramp:   {from, to, step, period, step_duration}
+ * pulse:  {count, on, off, duty, period} - short kicks to clear jammed food
+ */
+bool expandSegment(const Json::Value& segment, std::vector<MotorProfileStep>& steps) {
+    std::string type = segment.get("type", "steady").asString();
+    int period = segment.get("period", 10).asInt();
+
+    if (type == "steady") {
+        steps.push_back({segment.get("duty", 100).asInt(), period,
+                         segment.get("duration", 1000).asInt()});
+    } else if (type == "ramp") {
+        int from = segment.get("from", 0).asInt();
+        int to = segment.get("to", 100).asInt();
+        int step = std::abs(segment.get("step", 10).asInt());
+        int stepDuration = segment.get("step_duration", 500).asInt();
+        if (step == 0) {
+            return false;
+        }
+        int direction = to >= from ? 1 : -1;
+        for (int duty = from; direction * (to - duty) >= 0; duty += direction * step) {
+            steps.push_back({duty, period, stepDuration});
+        }
+    } else if (type == "pulse") {
+        int count = segment.get("count", 3).asInt();
+        int duty = segment.get("duty", 100).asInt();
+        int on = segment.get("on", 200).asInt();
+        int off = segment.get("off", 200).asInt();
+        for (int i = 0; i < count; ++i) {
+            steps.push_back({duty, period, on});
+            steps.push_back({0, period, off});
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+MotorProfileLibrary::MotorProfileLibrary() : m_defaultProfile("default") {
+    // The sequence Feeder and FishAPI always used
+    m_timelines["default"] = compile({{100, 10, 3000}, {50, 10, 500}});
+    // Soft start for light flakes
+    m_timelines["gentle"] = compile({{20, 10, 300}, {40, 10, 300}, {60, 10, 300},
+                                     {80, 10, 300}, {100, 10, 1500}});
+    // Kicks to free jammed pellets, then a normal feed
+    m_timelines["anti_jam"] = compile({{100, 10, 150}, {0, 10, 250},
+                                       {100, 10, 150}, {0, 10, 250},
+                                       {100, 10, 150}, {0, 10, 250},
+                                       {100, 10, 2500}, {50, 10, 500}});
+}
+
+bool MotorProfileLibrary::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Cannot open motor profile config " << path << std::endl;
+        return false;
+    }
+
+    Json::Value root;
+    Json::CharReaderBuilder builder;
+    JSONCPP_STRING err;
+    if (!Json::parseFromStream(builder, file, &root, &err)) {
+        std::cerr << "Error parsing motor profile config: " << err << std::endl;
+        return false;
+    }
+
+    bool ok = true;
+    const Json::Value& profiles = root["profiles"];
+    for (const auto& name : profiles.getMemberNames()) {
+        std::vector<MotorProfileStep> steps;
+        bool valid = profiles[name].isArray();
+        for (const auto& segment : profiles[name]) {
+            valid = valid && expandSegment(segment, steps);
+        }
+        if (!valid || steps.empty()) {
+            std::cerr << "Invalid motor profile: " << name << std::endl;
+            ok = false;
+            continue;
+        }
+        m_timelines[name] = compile(steps);
+    }
+
+    std::string defaultProfile = root.get("default_profile", m_defaultProfile).asString();
+    if (m_timelines.count(defaultProfile)) {
+        m_defaultProfile = defaultProfile;
+    } else {
+        std::cerr << "Unknown default motor profile: " << defaultProfile << std::endl;
+        ok = false;
+    }
+
+    std::cout << "Loaded " << profiles.size() << " motor profiles from " << path << std::endl;
+    return ok;
+}
+
+const EdgeTimeline* MotorProfileLibrary::timeline(const std::string& name) const {
+    auto it = m_timelines.find(name.empty() ? m_defaultProfile : name);
+    return it != m_timelines.end() ? &it->second : nullptr;
+}
+
+std::vector<std::string> MotorProfileLibrary::names() const {
+    std::vector<std::string> result;
+    for (const auto& entry : m_timelines) {
+        result.push_back(entry.first);
+    }
+    return result;
+}
+
+EdgeTimeline MotorProfileLibrary::compile(const std::vector<MotorProfileStep>& steps) {
+    EdgeTimeline timeline;
+    int level = -1; // Unknown, so the first edge is always written
+    int64_t now = 0;
+
+    auto push = [&](int64_t at, int value) {
+        if (value != level) {
+            timeline.edges.push_back({at, value});
+            level = value;
+        }
+    };
+
+    for (const auto& step : steps) {
+        int duty = std::max(0, std::min(100, step.dutyCycle));
+        int64_t periodNs = std::max(1, step.periodMs) * NS_PER_MS;
+        int64_t durationNs = std::max(0, step.durationMs) * NS_PER_MS;
+        int64_t onNs = periodNs * duty / 100;
+        int64_t end = now + durationNs;
+
+        if (duty == 0 || duty == 100) {
+            // Constant level, a single write instead of one per period
+            push(now, duty == 100 ? 1 : 0);
+        } else {
+            for (int64_t start = now; start < end; start += periodNs) {
+                push(start, 1);
+                if (start + onNs < end) {
+                    push(start + onNs, 0);
+                }
+            }
+        }
+        now = end;
+    }
+
+    timeline.durationNs = now;
+    return timeline;
+}
+
+int64_t monotonicNowNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * NS_PER_SEC + ts.tv_nsec;
+}
+
+void sleepUntilNs(int64_t deadlineNs) {
+    timespec deadline = { static_cast<time_t>(deadlineNs / NS_PER_SEC),
+                          static_cast<long>(deadlineNs % NS_PER_SEC) };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR) {
+    }
+}
@@ -0,0 +1,99 @@
+#include "opencv_parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+
+#ifdef HAVE_OPENCV_PARALLEL_BACKEND
+
+namespace {
+
+// Shared with helper jobs that may only start after the loop has finished
+struct ParallelLoop {
+    int tasks;
+    cv::parallel::FN_parallel_for_body_cb_t body;
+    void* data;
+    std::atomic<int> next{0};
+    std::atomic<int> done{0};
+    std::mutex mutex;
+    std::condition_variable finished;
+
+    void work() {
+        int task;
+        while ((task = next++) < tasks) {
+            try {
+                body(task, task + 1, data);
+            } catch (const std::exception& e) {
+                std::cerr << "Exception in OpenCV parallel loop: " << e.what() << std::endl;
+            }
+            // Counted either way, the caller waits for every chunk
+            if (++done == tasks) {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished.notify_all();
+            }
+        }
+    }
+};
+
+} // namespace
+
+void PoolParallelBackend::parallel_for(int tasks, cv::parallel::FN_parallel_for_body_cb_t body, void* data) {
+    if (tasks <= 1) {
+        body(0, tasks, data);
+        return;
+    }
+
+    auto loop = std::make_shared<ParallelLoop>();
+    loop->tasks = tasks;
+    loop->body = body;
+    loop->data = data;
+
+    int helpers = std::min<int>(tasks - 1, static_cast<int>(m_pool.size()));
+    WorkerPool::Lane lane = WorkerPool::currentLane();
+    for (int i = 0; i < helpers; ++i) {
+        if (!m_pool.submit([loop]() { loop->work(); }, lane)) {
+            break; // Stopping, the caller does the rest
+        }
+    }
+    loop->work();
+
+    std::unique_lock<std::mutex> lock(loop->mutex);
+    loop->finished.wait(lock, [&]() { return loop->done == loop->tasks; });
+}
+
+int PoolParallelBackend::getThreadNum() const {
+    return m_pool.currentWorker() + 1;
+}
+
+int PoolParallelBackend::getNumThreads() const {
+    return static_cast<int>(m_pool.size()) + 1;
+}
+
+int PoolParallelBackend::setNumThreads(int /*threads*/) {
+    return getNumThreads();
+}
+
+void installOpenCVBackend(WorkerPool& pool) {
+    cv::parallel::setParallelForBackend(std::make_shared<PoolParallelBackend>(pool));
+    std::cout << "OpenCV parallel loops run on the worker pool (" << pool.size() << " threads)" << std::endl;
+}
+
+void removeOpenCVBackend() {
+    cv::parallel::setParallelForBackend(std::shared_ptr<cv::parallel::ParallelForAPI>(), false);
+}
+
+#else
+
+void installOpenCVBackend(WorkerPool& /*pool*/) {
+    // Stops OpenCV's own pool competing with ours for the same cores
+    cv::setNumThreads(0);
+    std::cout << "OpenCV without pluggable parallel backends, parallel loops run sequentially" << std::endl;
+}
+
+void removeOpenCVBackend() {
+}
+
+#endif
@@ -0,0 +1,210 @@
+#include "ads1115_emulator.h"
+#include "event_bus.h"
+#include "event_loop.h"
+#include "i2c_bus.h"
+#include "ph_sampler.h"
+#include "ph_sensor.h"
+#include "worker_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+ * pH pipeline benchmark
+ *
+ * Runs the real PHSensor and PHSampler against an emulated ADS1115 on an
+ * emulated I2C bus, at each data rate. Measures single-shot read throughput
+ * and the error of raw reads and of filtered burst readings against the
+ * emulator's scripted pH, with spikes injected so the Hampel filter has
+ * something to drop. No hardware is touched.
+ */
+
+namespace {
+
+const int DATA_RATES[] = { 8, 16, 32, 64, 128, 250, 475, 860 };
+
+struct Options {
+    int rate = 0; // 0 for every rate
+    int reads = 100;
+    int bursts = 10;
+    int burst = 9;
+    double hampelK = 3.0;
+    double noiseUv = 15.0;
+    double spikeRate = 0.02;
+    double timeScale = 1.0;
+    std::string config; // Emulator JSON for the script and probe, noise and spikes come from above
+};
+
+struct Error {
+    int count = 0;
+    double sumSquares = 0.0;
+    double max = 0.0;
+
+    void add(double error) {
+        count++;
+        sumSquares += error * error;
+        max = std::max(max, std::fabs(error));
+    }
+    double rms() const { return count ? std::sqrt(sumSquares / count) : 0.0; }
+};
+
+struct Result {
+    int rate;
+    double readsPerSecond;
+    Error raw;
+    double burstMs;
+    Error filtered;
+    uint64_t outliers;
+    uint64_t earlyReads;
+    double busUs;
+};
+
+Result run(const Options& options, int rate) {
+    Result result = { rate, 0.0, Error(), 0.0, Error(), 0, 0, 0.0 };
+
+    Ads1115EmulatorConfig emulatorConfig;
+    if (!options.config.empty() && !emulatorConfig.load(options.config)) {
+        std::cerr << "Using the default emulated pH curve" << std::endl;
+    }
+    emulatorConfig.noiseUv = options.noiseUv;
+    emulatorConfig.spikeRate = options.spikeRate;
+    emulatorConfig.timeScale = options.timeScale;
+    Ads1115Emulator emulator(emulatorConfig);
+
+    I2cBusConfig busConfig;
+    busConfig.device = "emulated";
+    I2cBus i2c(busConfig);
+    i2c.attach(emulator.address(), &emulator);
+
+    WorkerPool pool(2);
+    EventBus bus(pool);
+    EventLoop loop; // Only holds the sampler's timer, never run
+
+    PHSensorConfig sensorConfig;
+    sensorConfig.mode = "single_shot";
+    sensorConfig.dataRate = rate;
+    sensorConfig.alarmEnabled = false;
+    PHSensor sensor(bus, i2c, sensorConfig);
+    if (!sensor.initialize()) {
+        std::cerr << "Emulated pH sensor failed to initialize" << std::endl;
+        return result;
+    }
+
+    // Raw single-shot reads, compared with the script halfway through each
+    double start = emulator.elapsed();
+    for (int i = 0; i < options.reads; ++i) {
+        double before = emulator.elapsed();
+        PHSensor::Sample sample;
+        if (sensor.read(sample)) {
+            result.raw.add(sample.pH - emulator.truePH((before + emulator.elapsed()) / 2.0));
+        }
+    }
+    double seconds = emulator.elapsed() - start;
+    result.readsPerSecond = seconds > 0.0 ? result.raw.count / seconds : 0.0;
+
+    // Filtered bursts, each refresh requested once the last reading is stale
+    PHSamplerConfig samplerConfig;
+    samplerConfig.intervalMs = 3600000;
+    samplerConfig.burst = options.burst;
+    samplerConfig.hampelK = std::max(1.0, options.hampelK);
+    samplerConfig.maxAgeMs = 0;
+    samplerConfig.adaptive = false;
+    PHSampler sampler(loop, pool, sensor, bus, samplerConfig);
+    sampler.start();
+    for (int i = 0; i < options.bursts; ++i) {
+        double before = emulator.elapsed();
+        std::promise<PHSampler::Reading> done;
+        sampler.read([&done](const PHSampler::Reading& reading) { done.set_value(reading); });
+        PHSampler::Reading reading = done.get_future().get();
+        if (reading.valid) {
+            result.filtered.add(reading.pH - emulator.truePH((before + emulator.elapsed()) / 2.0));
+        }
+    }
+    sampler.stop();
+    PHSampler::Stats samplerStats = sampler.stats();
+    result.burstMs = samplerStats.avgBurstMs;
+    result.outliers = samplerStats.outliers;
+    result.earlyReads = emulator.stats().earlyReads;
+    for (const auto& device : i2c.stats()) {
+        if (device.address == emulator.address()) {
+            result.busUs = device.avgUs;
+        }
+    }
+    sensor.cleanup();
+    return result;
+}
+
+void printResult(const Result& r) {
+    std::cout << std::setw(6) << r.rate << std::fixed << std::setprecision(1)
+              << std::setw(10) << r.readsPerSecond << std::setprecision(4)
+              << std::setw(10) << r.raw.rms() << std::setw(10) << r.raw.max
+              << std::setprecision(1) << std::setw(10) << r.burstMs << std::setprecision(4)
+              << std::setw(10) << r.filtered.rms() << std::setw(10) << r.filtered.max
+              << std::setw(10) << r.outliers << std::setw(8) << r.earlyReads
+              << std::setprecision(1) << std::setw(8) << r.busUs << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--rate" && i + 1 < argc) {
+            options.rate = std::atoi(argv[++i]);
+        } else if (arg == "--reads" && i + 1 < argc) {
+            options.reads = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--bursts" && i + 1 < argc) {
+            options.bursts = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--burst" && i + 1 < argc) {
+            options.burst = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--hampel-k" && i + 1 < argc) {
+            options.hampelK = std::atof(argv[++i]);
+        } else if (arg == "--noise-uv" && i + 1 < argc) {
+            options.noiseUv = std::max(0.0, std::atof(argv[++i]));
+        } else if (arg == "--spike-rate" && i + 1 < argc) {
+            options.spikeRate = std::max(0.0, std::min(1.0, std::atof(argv[++i])));
+        } else if (arg == "--time-scale" && i + 1 < argc) {
+            options.timeScale = std::max(0.0, std::atof(argv[++i]));
+        } else if (arg == "--config" && i + 1 < argc) {
+            options.config = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--rate SPS] [--reads N] [--bursts N] [--burst N] [--hampel-k K]"
+                      << " [--noise-uv UV] [--spike-rate P] [--time-scale X] [--config FILE]" << std::endl;
+            return 1;
+        }
+    }
+    if (options.rate != 0 &&
+        std::find(std::begin(DATA_RATES), std::end(DATA_RATES), options.rate) == std::end(DATA_RATES)) {
+        std::cerr << "Unsupported ADS1115 data rate " << options.rate << std::endl;
+        return 1;
+    }
+
+    std::cout << "pH pipeline benchmark: " << options.reads << " raw reads and " << options.bursts
+              << " bursts of " << options.burst << " per rate, " << options.noiseUv << "uV noise, "
+              << options.spikeRate * 100.0 << "% spikes" << std::endl;
+
+    std::vector<Result> results;
+    for (int rate : DATA_RATES) {
+        if (options.rate == 0 || options.rate == rate) {
+            results.push_back(run(options, rate));
+        }
+    }
+
+    std::cout << std::endl << "Error against the scripted pH (pH units)" << std::endl;
+    std::cout << std::setw(6) << "sps" << std::setw(10) << "reads/s" << std::setw(10) << "raw rms"
+              << std::setw(10) << "raw max" << std::setw(10) << "burst ms" << std::setw(10) << "filt rms"
+              << std::setw(10) << "filt max" << std::setw(10) << "dropped" << std::setw(8) << "early"
+              << std::setw(8) << "bus us" << std::endl;
+    for (const auto& result : results) {
+        printResult(result);
+    }
+    return 0;
+}
@@ -0,0 +1,377 @@
+#include "ph_history.h"
+#include <jsoncpp/json/json.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const uint32_t FILE_MAGIC = 0x48504641; // "AFPH"
+static const uint32_t FILE_VERSION = 1;
+static const size_t HEADER_BYTES = 4096;
+
+// Bucket length per resolution, seconds, days are UTC
+static const int64_t BUCKET_SECONDS[] = { 1, 60, 3600, 86400 };
+
+static const int64_t NS_PER_MS = 1000000LL;
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Start of the bucket holding time, also for times before 1970
+static int64_t bucketStart(int64_t time, int64_t bucket) {
+    int64_t remainder = time % bucket;
+    return remainder < 0 ? time - remainder - bucket : time - remainder;
+}
+
+bool PHHistoryConfig::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Cannot open pH history config " << path << std::endl;
+        return false;
+    }
+
+    Json::Value root;
+    Json::CharReaderBuilder builder;
+    JSONCPP_STRING err;
+    if (!Json::parseFromStream(builder, file, &root, &err)) {
+        std::cerr << "Error parsing pH history config: " << err << std::endl;
+        return false;
+    }
+
+    this->path = root.get("path", this->path).asString();
+    rawRecords = std::max(1, root.get("raw_records", rawRecords).asInt());
+    minuteDays = std::max(1, root.get("minute_days", minuteDays).asInt());
+    hourDays = std::max(1, root.get("hour_days", hourDays).asInt());
+    dayDays = std::max(1, root.get("day_days", dayDays).asInt());
+    syncIntervalMs = std::max(1000, root.get("sync_interval_ms", syncIntervalMs).asInt());
+    return true;
+}
+
+PHHistory::PHHistory(EventBus& bus, const PHHistoryConfig& config)
+    : m_config(config),
+      m_fd(-1),
+      m_base(nullptr),
+      m_size(0),
+      m_header(nullptr),
+      m_offsets(),
+      m_lastSyncNs(nowNs()),
+      m_appended(0),
+      m_outOfOrder(0),
+      m_syncs(0),
+      m_queries(0) {
+    if (!open()) {
+        std::cerr << "pH history unavailable, readings are not stored" << std::endl;
+        return;
+    }
+    // A record copy and a few in-place updates, cheap enough for the publisher's thread
+    m_subscriptions.add(bus.topic<PHSensor::Sample>("ph"), "history", Delivery::Inline,
+                        [this](const PHSensor::Sample& sample) {
+                            int64_t timeMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                std::chrono::system_clock::now().time_since_epoch()).count();
+                            append(timeMs, sample);
+                        });
+}
+
+PHHistory::~PHHistory() {
+    m_subscriptions.clear(); // No append may race the unmap
+    close();
+}
+
+bool PHHistory::open() {
+    uint64_t capacity[RESOLUTIONS] = {
+        static_cast<uint64_t>(m_config.rawRecords),
+        static_cast<uint64_t>(m_config.minuteDays) * 1440,
+        static_cast<uint64_t>(m_config.hourDays) * 24,
+        static_cast<uint64_t>(m_config.dayDays)
+    };
+    size_t size = HEADER_BYTES;
+    for (size_t r = 0; r < RESOLUTIONS; ++r) {
+        m_offsets[r] = size;
+        size += capacity[r] * (r == 0 ? sizeof(RawRecord) : sizeof(RollupRecord));
+    }
+
+    m_fd = ::open(m_config.path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (m_fd < 0) {
+        std::cerr << "Cannot open pH history " << m_config.path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct stat st;
+    bool fresh = fstat(m_fd, &st) != 0 || static_cast<size_t>(st.st_size) != size;
+    if (fresh) {
+        // Allocated up front, appends never change the file's size or extents
+        if (ftruncate(m_fd, 0) != 0 || posix_fallocate(m_fd, 0, size) != 0) {
+            if (ftruncate(m_fd, size) != 0) {
+                std::cerr << "Cannot size pH history " << m_config.path << std::endl;
+                ::close(m_fd);
+                m_fd = -1;
+                return false;
+            }
+        }
+    }
+
+    void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (base == MAP_FAILED) {
+        std::cerr << "Cannot map pH history: " << strerror(errno) << std::endl;
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    m_base = static_cast<unsigned char*>(base);
+    m_size = size;
+    m_header = reinterpret_cast<FileHeader*>(m_base);
+
+    if (!fresh && (m_header->magic != FILE_MAGIC || m_header->version != FILE_VERSION ||
+                   !std::equal(capacity, capacity + RESOLUTIONS, m_header->capacity))) {
+        std::cerr << "pH history layout changed, starting a new history" << std::endl;
+        fresh = true;
+    }
+    if (fresh) {
+        std::memset(m_header, 0, sizeof(FileHeader));
+        m_header->magic = FILE_MAGIC;
+        m_header->version = FILE_VERSION;
+        std::copy(capacity, capacity + RESOLUTIONS, m_header->capacity);
+        msync(m_base, HEADER_BYTES, MS_SYNC);
+    }
+
+    std::cout << "pH history " << m_config.path << ": " << count(Resolution::Raw) << " readings, "
+              << size / 1024 << " KiB" << std::endl;
+    return true;
+}
+
+void PHHistory::close() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_base) {
+        msync(m_base, m_size, MS_SYNC);
+        munmap(m_base, m_size);
+        m_base = nullptr;
+        m_header = nullptr;
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+void PHHistory::append(int64_t timeMs, const PHSensor::Sample& sample) {
+    bool syncDue;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_base) {
+            return;
+        }
+        RawRecord* ring = reinterpret_cast<RawRecord*>(m_base + m_offsets[0]);
+        RawRecord& record = ring[m_header->written[0] % m_header->capacity[0]];
+        record = RawRecord();
+        record.timeMs = timeMs;
+        record.pH = sample.pH;
+        record.voltage = sample.voltage;
+        record.adcValue = sample.adcValue;
+        m_header->written[0]++;
+
+        int64_t time = bucketStart(timeMs, 1000) / 1000;
+        bool ordered = true;
+        for (Resolution resolution : { Resolution::Minute, Resolution::Hour, Resolution::Day }) {
+            ordered = roll(resolution, time, sample.pH) && ordered;
+        }
+        m_outOfOrder += ordered ? 0 : 1;
+        m_appended++;
+
+        int64_t now = nowNs();
+        syncDue = now - m_lastSyncNs >= m_config.syncIntervalMs * NS_PER_MS;
+        if (syncDue) {
+            m_lastSyncNs = now;
+        }
+    }
+    if (syncDue) {
+        writeBack();
+    }
+}
+
+bool PHHistory::roll(Resolution resolution, int64_t time, float pH) {
+    size_t r = static_cast<size_t>(resolution);
+    RollupRecord* ring = reinterpret_cast<RollupRecord*>(m_base + m_offsets[r]);
+    uint64_t capacity = m_header->capacity[r];
+    uint64_t& written = m_header->written[r];
+    int64_t start = bucketStart(time, BUCKET_SECONDS[r]);
+
+    if (written > 0) {
+        RollupRecord& newest = ring[(written - 1) % capacity];
+        if (newest.start == start) {
+            newest.count++;
+            newest.min = std::min(newest.min, pH);
+            newest.max = std::max(newest.max, pH);
+            newest.sum += pH;
+            return true;
+        }
+        if (start < newest.start) {
+            return false; // Clock stepped back, that bucket is closed
+        }
+    }
+
+    RollupRecord& record = ring[written % capacity];
+    record = RollupRecord();
+    record.start = start;
+    record.count = 1;
+    record.min = pH;
+    record.max = pH;
+    record.sum = pH;
+    written++;
+    return true;
+}
+
+std::vector<PHHistory::Point> PHHistory::query(Resolution resolution, int64_t from, int64_t to) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<Point> points;
+    if (!m_base || to < from) {
+        return points;
+    }
+    m_queries++;
+
+    // A rollup bucket that started before from still covers it
+    size_t n = count(resolution);
+    size_t index = lowerBound(resolution, bucketStart(from, BUCKET_SECONDS[static_cast<size_t>(resolution)]));
+    size_t end = lowerBound(resolution, to + 1);
+    points.reserve(end - index);
+    for (; index < end && index < n; ++index) {
+        points.push_back(pointAt(resolution, index));
+    }
+    return points;
+}
+
+PHHistory::Resolution PHHistory::resolutionFor(int64_t from, int64_t to, size_t maxPoints) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_base) {
+        return Resolution::Day;
+    }
+    for (Resolution resolution : { Resolution::Raw, Resolution::Minute, Resolution::Hour }) {
+        size_t r = static_cast<size_t>(resolution);
+        // A ring that never wrapped holds everything since the file was made
+        bool covers = m_header->written[r] <= m_header->capacity[r] ||
+                      (count(resolution) > 0 && timeAt(resolution, 0) <= from);
+        uint64_t points = resolution == Resolution::Raw ?
+            lowerBound(resolution, to + 1) - lowerBound(resolution, from) :
+            static_cast<uint64_t>(std::max<int64_t>(0, to - from)) / BUCKET_SECONDS[r] + 1;
+        if (covers && points <= maxPoints) {
+            return resolution;
+        }
+    }
+    return Resolution::Day;
+}
+
+void PHHistory::writeBack() {
+    // Outside m_mutex: m_fd outlives the subscription that appends. The pages
+    // are queued for writing and the bus thread goes on without waiting.
+    if (sync_file_range(m_fd, 0, m_size, SYNC_FILE_RANGE_WRITE) == 0) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_syncs++;
+    }
+}
+
+void PHHistory::sync() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_base) {
+        // Only dirty pages go out, the tail of each ring and the header
+        msync(m_base, m_size, MS_SYNC);
+        m_syncs++;
+    }
+}
+
+PHHistory::Stats PHHistory::stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats stats;
+    stats.open = m_base != nullptr;
+    stats.appended = m_appended;
+    stats.outOfOrder = m_outOfOrder;
+    stats.syncs = m_syncs;
+    stats.queries = m_queries;
+    stats.fileBytes = m_base ? m_size : 0;
+    for (size_t r = 0; r < RESOLUTIONS; ++r) {
+        stats.records[r] = m_base ? count(static_cast<Resolution>(r)) : 0;
+    }
+    return stats;
+}
+
+const char* PHHistory::resolutionName(Resolution resolution) {
+    switch (resolution) {
+    case Resolution::Raw:
+        return "raw";
+    case Resolution::Minute:
+        return "1m";
+    case Resolution::Hour:
+        return "1h";
+    case Resolution::Day:
+        return "1d";
+    }
+    return "unknown";
+}
+
+bool PHHistory::parseResolution(const std::string& name, Resolution& resolution) {
+    for (size_t r = 0; r < RESOLUTIONS; ++r) {
+        if (name == resolutionName(static_cast<Resolution>(r))) {
+            resolution = static_cast<Resolution>(r);
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t PHHistory::count(Resolution resolution) const {
+    size_t r = static_cast<size_t>(resolution);
+    return static_cast<size_t>(std::min(m_header->written[r], m_header->capacity[r]));
+}
+
+int64_t PHHistory::timeAt(Resolution resolution, size_t index) const {
+    size_t r = static_cast<size_t>(resolution);
+    uint64_t slot = (m_header->written[r] - count(resolution) + index) % m_header->capacity[r];
+    if (resolution == Resolution::Raw) {
+        return bucketStart(reinterpret_cast<const RawRecord*>(m_base + m_offsets[r])[slot].timeMs, 1000) / 1000;
+    }
+    return reinterpret_cast<const RollupRecord*>(m_base + m_offsets[r])[slot].start;
+}
+
+PHHistory::Point PHHistory::pointAt(Resolution resolution, size_t index) const {
+    size_t r = static_cast<size_t>(resolution);
+    uint64_t slot = (m_header->written[r] - count(resolution) + index) % m_header->capacity[r];
+    Point point;
+    if (resolution == Resolution::Raw) {
+        const RawRecord& record = reinterpret_cast<const RawRecord*>(m_base + m_offsets[r])[slot];
+        point.time = bucketStart(record.timeMs, 1000) / 1000;
+        point.min = record.pH;
+        point.max = record.pH;
+        point.mean = record.pH;
+        point.count = 1;
+    } else {
+        const RollupRecord& record = reinterpret_cast<const RollupRecord*>(m_base + m_offsets[r])[slot];
+        point.time = record.start;
+        point.min = record.min;
+        point.max = record.max;
+        point.mean = record.count ? static_cast<float>(record.sum / record.count) : 0.0f;
+        point.count = record.count;
+    }
+    return point;
+}
+
+size_t PHHistory::lowerBound(Resolution resolution, int64_t time) const {
+    // Records are in time order from the oldest, except raw ones after a clock step
+    size_t low = 0;
+    size_t high = count(resolution);
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (timeAt(resolution, middle) < time) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
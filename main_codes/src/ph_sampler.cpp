@@ -0,0 +1,332 @@
+#include "ph_sampler.h"
+#include <jsoncpp/json/json.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+static const int64_t NS_PER_MS = 1000000LL;
+
+// Scales the median absolute deviation to a standard deviation for Gaussian noise
+static const double MAD_SCALE = 1.4826;
+
+// A change between readings within this many of their combined standard errors is noise
+static const double CHANGE_SIGMAS = 3.0;
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static float median(std::vector<float> values) {
+    size_t middle = values.size() / 2;
+    std::nth_element(values.begin(), values.begin() + middle, values.end());
+    float upper = values[middle];
+    if (values.size() % 2 != 0) {
+        return upper;
+    }
+    float lower = *std::max_element(values.begin(), values.begin() + middle);
+    return (lower + upper) / 2.0f;
+}
+
+bool PHSamplerConfig::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Cannot open pH sampler config " << path << std::endl;
+        return false;
+    }
+
+    Json::Value root;
+    Json::CharReaderBuilder builder;
+    JSONCPP_STRING err;
+    if (!Json::parseFromStream(builder, file, &root, &err)) {
+        std::cerr << "Error parsing pH sampler config: " << err << std::endl;
+        return false;
+    }
+
+    intervalMs = std::max(100, root.get("interval_ms", intervalMs).asInt());
+    burst = std::max(1, root.get("burst", burst).asInt());
+    hampelK = std::max(1.0, root.get("hampel_k", hampelK).asDouble());
+    maxAgeMs = std::max(0, root.get("max_age_ms", maxAgeMs).asInt());
+    adaptive = root.get("adaptive", adaptive).asBool();
+    minIntervalMs = std::max(100, root.get("min_interval_ms", minIntervalMs).asInt());
+    maxIntervalMs = std::max(minIntervalMs, root.get("max_interval_ms", maxIntervalMs).asInt());
+    backoff = std::max(1.0, root.get("backoff", backoff).asDouble());
+    changePH = std::max(0.0, root.get("change_ph", changePH).asDouble());
+    feedBoostMs = std::max(0, root.get("feed_boost_ms", feedBoostMs).asInt());
+    return true;
+}
+
+PHSampler::PHSampler(EventLoop& loop, WorkerPool& pool, PHSensor& sensor, EventBus& bus,
+                     const PHSamplerConfig& config)
+    : m_loop(loop),
+      m_pool(pool),
+      m_sensor(sensor),
+      m_sampleTopic(bus.topic<PHSensor::Sample>("ph")),
+      m_config(config),
+      m_timer(-1),
+      m_latest(Reading()),
+      m_busy(false),
+      m_running(false),
+      m_stats(),
+      m_totalBurstNs(0),
+      m_reads(0),
+      m_startNs(0),
+      m_intervalMs(config.adaptive ? std::max(config.minIntervalMs, std::min(config.maxIntervalMs, config.intervalMs))
+                                   : config.intervalMs),
+      m_boostUntilNs(0),
+      m_freshMs(config.adaptive ? std::max(config.maxAgeMs, m_intervalMs) : config.maxAgeMs) {
+    m_subscriptions.add(bus.topic<FeederBank::FeedEvent>("feed"), "ph_sampler", Delivery::Inline,
+                        [this](const FeederBank::FeedEvent& event) { fed(event); });
+}
+
+PHSampler::~PHSampler() {
+    stop();
+}
+
+void PHSampler::start() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_running) {
+            return;
+        }
+        m_running = true;
+        m_startNs = nowNs();
+    }
+    int timer = m_loop.addTimer([this]() { scheduled(); });
+    {
+        // Bursts rearm the timer from the pool, the id only changes under the lock
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_timer = timer;
+        if (m_config.adaptive) {
+            rearm();
+        } else {
+            m_loop.armTimer(m_timer, m_config.intervalMs * NS_PER_MS, m_config.intervalMs * NS_PER_MS);
+        }
+    }
+    scheduled();
+}
+
+void PHSampler::stop() {
+    int timer;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+        timer = m_timer;
+        m_timer = -1;
+    }
+    if (timer >= 0) {
+        m_loop.removeTimer(timer);
+    }
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this]() { return !m_busy; });
+}
+
+bool PHSampler::isFresh(const Reading& reading) const {
+    return reading.valid && nowNs() - reading.timestampNs <= m_freshMs * NS_PER_MS;
+}
+
+void PHSampler::read(Callback done) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    Reading reading = latest();
+    if (isFresh(reading) || !m_running) {
+        if (isFresh(reading)) {
+            m_stats.cached++;
+        }
+        lock.unlock();
+        if (done) {
+            done(reading);
+        }
+        return;
+    }
+    if (m_busy) {
+        // The running burst finishes after this request, its reading is fresh enough
+        m_stats.collapsed++;
+        if (done) {
+            m_waiters.push_back(std::move(done));
+        }
+        return;
+    }
+
+    m_stats.refreshes++;
+    if (done) {
+        m_waiters.push_back(std::move(done));
+    }
+    m_busy = m_pool.submit([this]() { burst(); }, WorkerPool::Lane::Analytics);
+    if (!m_busy) {
+        std::vector<Callback> waiters;
+        waiters.swap(m_waiters);
+        lock.unlock();
+        for (auto& waiter : waiters) {
+            waiter(reading);
+        }
+    }
+}
+
+void PHSampler::refresh() {
+    read(nullptr);
+}
+
+PHSampler::Stats PHSampler::stats() const {
+    Reading reading = latest();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats stats = m_stats;
+    stats.avgBurstMs = stats.bursts ? m_totalBurstNs / 1e6 / stats.bursts : 0.0;
+    stats.ageMs = reading.valid ? (nowNs() - reading.timestampNs) / 1e6 : -1.0;
+    stats.intervalMs = m_intervalMs;
+    int64_t now = nowNs();
+    stats.boosted = now < m_boostUntilNs;
+    int64_t elapsedNs = m_startNs ? now - m_startNs : 0;
+    stats.dutyPercent = elapsedNs > 0 ? 100.0 * m_totalBurstNs / elapsedNs : 0.0;
+    uint64_t fastReads = static_cast<uint64_t>(elapsedNs / (m_config.minIntervalMs * NS_PER_MS) + 1) * m_config.burst;
+    stats.samplesSaved = m_config.adaptive && fastReads > m_reads ? fastReads - m_reads : 0;
+    return stats;
+}
+
+void PHSampler::scheduled() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_running && !m_busy) {
+        m_busy = m_pool.submit([this]() { burst(); }, WorkerPool::Lane::Analytics);
+    }
+}
+
+void PHSampler::burst() {
+    int64_t startNs = nowNs();
+    std::vector<PHSensor::Sample> samples;
+    samples.reserve(m_config.burst);
+    for (int i = 0; i < m_config.burst; ++i) {
+        PHSensor::Sample sample;
+        if (m_sensor.read(sample)) {
+            samples.push_back(sample);
+        }
+    }
+
+    // Temperature and other probes on the same ADC, between pH bursts
+    m_sensor.scanChannels();
+
+    Reading previous = latest();
+    Reading reading;
+    bool ok = filter(samples, reading);
+    if (ok) {
+        m_latest.store(reading);
+        m_sampleTopic.publish({ reading.pH, reading.voltage, reading.adcValue });
+    } else {
+        std::cerr << "pH burst failed, no sensor reads" << std::endl;
+        reading = latest();
+    }
+
+    std::vector<Callback> waiters;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_config.adaptive) {
+            if (ok) {
+                adapt(previous, reading);
+            }
+            // Counted from the end of this burst, on-demand ones included
+            rearm();
+        }
+        m_reads += m_config.burst;
+        m_stats.bursts++;
+        m_stats.failures += ok ? 0 : 1;
+        m_stats.samples += ok ? reading.samples : 0;
+        m_stats.outliers += ok ? reading.outliers : 0;
+        m_totalBurstNs += nowNs() - startNs;
+        waiters.swap(m_waiters);
+        m_busy = false;
+        m_idle.notify_all();
+    }
+    for (auto& waiter : waiters) {
+        waiter(reading);
+    }
+}
+
+bool PHSampler::filter(const std::vector<PHSensor::Sample>& samples, Reading& reading) const {
+    if (samples.empty()) {
+        return false;
+    }
+
+    std::vector<float> values;
+    values.reserve(samples.size());
+    for (const auto& sample : samples) {
+        values.push_back(sample.pH);
+    }
+    float center = median(values);
+    std::vector<float> deviations;
+    deviations.reserve(values.size());
+    for (float value : values) {
+        deviations.push_back(std::fabs(value - center));
+    }
+    double limit = m_config.hampelK * MAD_SCALE * median(deviations);
+
+    // Average what is left, at least half the burst with k >= 1
+    double pH = 0.0;
+    double voltage = 0.0;
+    double adcValue = 0.0;
+    uint32_t kept = 0;
+    for (const auto& sample : samples) {
+        if (std::fabs(sample.pH - center) <= limit) {
+            pH += sample.pH;
+            voltage += sample.voltage;
+            adcValue += sample.adcValue;
+            kept++;
+        }
+    }
+
+    reading.valid = true;
+    reading.pH = static_cast<float>(pH / kept);
+    reading.voltage = static_cast<float>(voltage / kept);
+    reading.adcValue = static_cast<int16_t>(std::lround(adcValue / kept));
+    reading.timestampNs = nowNs();
+    reading.time = std::time(nullptr);
+    reading.samples = kept;
+    reading.outliers = static_cast<uint32_t>(samples.size()) - kept;
+
+    double mean = pH / kept;
+    double squares = 0.0;
+    for (const auto& sample : samples) {
+        if (std::fabs(sample.pH - center) <= limit) {
+            squares += (sample.pH - mean) * (sample.pH - mean);
+        }
+    }
+    reading.noise = kept > 1 ? static_cast<float>(std::sqrt(squares / (kept - 1) / kept)) : 0.0f;
+    return true;
+}
+
+void PHSampler::fed(const FeederBank::FeedEvent& event) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // The dip follows the food, counted from when the motors stop
+    if (!m_config.adaptive || !m_running || event.running) {
+        return;
+    }
+    m_boostUntilNs = static_cast<int64_t>(event.timestampNs) + m_config.feedBoostMs * NS_PER_MS;
+    m_stats.boosts++;
+    if (m_intervalMs > m_config.minIntervalMs) {
+        m_intervalMs = m_config.minIntervalMs;
+        m_freshMs = std::max(m_config.maxAgeMs, m_intervalMs);
+        // A running burst rearms when it finishes
+        if (!m_busy) {
+            rearm();
+        }
+    }
+}
+
+void PHSampler::adapt(const Reading& previous, const Reading& reading) {
+    double noise = CHANGE_SIGMAS * std::hypot(previous.noise, reading.noise);
+    bool changed = previous.valid && std::fabs(reading.pH - previous.pH) > std::max(m_config.changePH, noise);
+    if (changed) {
+        m_stats.changes++;
+    }
+    if (changed || nowNs() < m_boostUntilNs) {
+        m_intervalMs = m_config.minIntervalMs;
+    } else {
+        m_intervalMs = static_cast<int>(std::min<double>(m_config.maxIntervalMs, m_intervalMs * m_config.backoff));
+    }
+    m_freshMs = std::max(m_config.maxAgeMs, m_intervalMs);
+}
+
+void PHSampler::rearm() {
+    if (m_running && m_timer >= 0) {
+        m_loop.armTimer(m_timer, m_intervalMs * NS_PER_MS);
+    }
+}
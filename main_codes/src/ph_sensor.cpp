@@ -1,156 +1,585 @@
 #include "ph_sensor.h"
+#include "realtime.h"
+#include <jsoncpp/json/json.h>
 #include <iostream>
-#include <fcntl.h>
-#include <unistd.h>
-#include <sys/ioctl.h>
-#include <linux/i2c-dev.h>
-#include <i2c/smbus.h>
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <fstream>
 #include <thread>
 
 // ADS1115 settings
-static const char *I2C_DEVICE = "/dev/i2c-1";
 static const uint8_t I2C_ADDR = 0x48;
-#define CONFIG_REG 0x01
 #define CONVERSION_REG 0x00
+#define CONFIG_REG 0x01
+#define LO_THRESH_REG 0x02
+#define HI_THRESH_REG 0x03
+
+// Config register fields
+static const uint16_t CONFIG_OS_START = 1 << 15;        // Start a single-shot conversion
+static const uint16_t CONFIG_MUX_SINGLE = 4 << 12;      // AINn against GND (MUX = 1nn)
+static const uint16_t CONFIG_MUX_A0 = CONFIG_MUX_SINGLE | 0 << 12; // pH probe on A0 (MUX = 100)
+static const uint16_t CONFIG_PGA_2V048 = 2 << 9;        // ±2.048V gain (PGA = 010)
+static const uint16_t CONFIG_MODE_SINGLE = 1 << 8;      // Single-shot, powered down in between
+static const uint16_t CONFIG_COMP_DISABLE = 3;          // Comparator off, ALERT/RDY high-impedance
+static const uint16_t CONFIG_COMP_ONE_CONVERSION = 0;   // ALERT/RDY pulses after every conversion
+static const uint16_t CONFIG_COMP_WINDOW = 1 << 4;      // Assert outside Lo_thresh..Hi_thresh
+
+// Hi_thresh MSB set and Lo_thresh MSB clear turn ALERT/RDY into a ready signal
+static const uint16_t READY_HI_THRESH = 0x8000;
+static const uint16_t READY_LO_THRESH = 0x0000;
+
+static const int DATA_RATES[] = { 8, 16, 32, 64, 128, 250, 475, 860 };
+
+// No ready edge for this long means the line isn't wired
+static const int64_t READY_TIMEOUT_NS = 1000000000LL;
+
+// read() waits this long for the next average
+static const int AVERAGE_TIMEOUT_MS = 1000;
+
+static const size_t EVENT_BUFFER_SIZE = 64;
 
 // Updated calibration constants
 static const float V_REF = 2.048; // PGA ±2.048V
 static const float SLOPE = -12.5; //  slope
 static const float OFFSET = 12.5; //  offset
 
-PHSensor::PHSensor() : m_fd(-1) {
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
-PHSensor::~PHSensor() {
-    cleanup();
+bool PHSensorConfig::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Cannot open pH config " << path << std::endl;
+        return false;
+    }
+
+    Json::Value root;
+    Json::CharReaderBuilder builder;
+    JSONCPP_STRING err;
+    if (!Json::parseFromStream(builder, file, &root, &err)) {
+        std::cerr << "Error parsing pH config: " << err << std::endl;
+        return false;
+    }
+
+    mode = root.get("mode", mode).asString();
+    chipNumber = root.get("chip", chipNumber).asInt();
+    readyPin = root.get("ready_pin", readyPin).asInt();
+    int rate = root.get("data_rate", dataRate).asInt();
+    if (std::find(std::begin(DATA_RATES), std::end(DATA_RATES), rate) != std::end(DATA_RATES)) {
+        dataRate = rate;
+    } else {
+        std::cerr << "Unsupported ADS1115 data rate " << rate << ", using " << dataRate << std::endl;
+    }
+    oversample = std::max(1, root.get("oversample", oversample).asInt());
+    alarmEnabled = root.get("alarm_enabled", alarmEnabled).asBool();
+    alarmLow = root.get("alarm_low", alarmLow).asFloat();
+    alarmHigh = root.get("alarm_high", alarmHigh).asFloat();
+    if (alarmLow >= alarmHigh) {
+        std::cerr << "pH alarm band " << alarmLow << " to " << alarmHigh << " is empty, alarm disabled" << std::endl;
+        alarmEnabled = false;
+    }
+    rate = root.get("alarm_data_rate", alarmDataRate).asInt();
+    if (std::find(std::begin(DATA_RATES), std::end(DATA_RATES), rate) != std::end(DATA_RATES)) {
+        alarmDataRate = rate;
+    } else {
+        std::cerr << "Unsupported ADS1115 data rate " << rate << ", using " << alarmDataRate << std::endl;
+    }
+    int conversions = root.get("alarm_conversions", alarmConversions).asInt();
+    alarmConversions = conversions >= 4 ? 4 : (conversions >= 2 ? 2 : 1);
+    if (root.isMember("channels")) {
+        channels.clear();
+        for (const auto& entry : root["channels"]) {
+            int channel = entry.get("channel", 0).asInt();
+            if (channel < 1 || channel > 3) {
+                std::cerr << "ADS1115 channel " << channel << " ignored, extra probes go on A1 to A3" << std::endl;
+                continue;
+            }
+            channels.push_back({ entry.get("name", "a" + std::to_string(channel)).asString(), channel });
+        }
+    }
+    return true;
+}
+
+PHSensor::PHSensor(EventBus& bus, I2cBus& i2c, const PHSensorConfig& config)
+    : m_alarmTopic(bus.topic<AlarmEvent>("ph_alarm")),
+      m_config(config),
+      m_i2c(i2c),
+      m_initialized(false),
+      m_request(nullptr),
+      m_eventBuffer(nullptr),
+      m_sampling(false),
+      m_alarmMode(false),
+      m_latestAdc(0.0f),
+      m_latestSequence(0),
+      m_readSequence(0),
+      m_samplerStartNs(0),
+      m_conversions(0),
+      m_missed(0),
+      m_i2cErrors(0),
+      m_readings(0),
+      m_skip(0),
+      m_alarmEnabled(config.alarmEnabled),
+      m_alarmLow(config.alarmLow),
+      m_alarmHigh(config.alarmHigh),
+      m_alarmActive(false),
+      m_alarmChanges(0),
+      m_alarmChangedAt(0) {
+    for (const auto& channel : m_config.channels) {
+        m_channels.push_back({ channel.name, channel.channel, false, 0.0f });
+    }
 }
 
-void PHSensor::registerCallback(PHSensorCallbackInterface* callback) {
-    m_callbackInterfaces.push_back(callback);
+PHSensor::~PHSensor() {
+    cleanup();
 }
 
 bool PHSensor::initialize() {
-    // Close previous descriptor if open
-    if (m_fd >= 0) {
-        close(m_fd);
-        m_fd = -1;
-    }
-    
-    m_fd = open(I2C_DEVICE, O_RDWR);
-    if (m_fd < 0) {
-        std::cerr << "Failed to open I2C device" << std::endl;
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    stopContinuous();
+    m_initialized = false;
+    if (!m_i2c.open()) {
         return false;
     }
-    
-    if (ioctl(m_fd, I2C_SLAVE, I2C_ADDR) < 0) {
-        std::cerr << "Failed to set I2C address" << std::endl;
-        close(m_fd);
-        m_fd = -1;
+
+    // The bus is shared, make sure the ADC answers at its address
+    uint16_t config;
+    if (!m_i2c.readRegister(I2C_ADDR, CONFIG_REG, config)) {
+        std::cerr << "ADS1115 not responding at 0x48" << std::endl;
         return false;
     }
-    
+    m_initialized = true;
+
+    if (m_config.mode == "continuous" && !startContinuous()) {
+        std::cerr << "pH sensor continuous mode unavailable, using single-shot reads" << std::endl;
+    } else if (m_config.mode == "alarm" && !startAlarm()) {
+        std::cerr << "pH alarm mode unavailable, using single-shot reads" << std::endl;
+    }
+
     std::cout << "pH Sensor initialized successfully" << std::endl;
     return true;
 }
 
 void PHSensor::cleanup() {
-    if (m_fd >= 0) {
-        close(m_fd);
-        m_fd = -1;
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    stopContinuous();
+    if (m_initialized) {
+        m_initialized = false;
         std::cout << "pH Sensor resources cleaned up" << std::endl;
     }
 }
 
-float PHSensor::readPH() {
+bool PHSensor::read(Sample& sample) {
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
     // Making sure the sensor is initialized
     if (!isInitialized()) {
         std::cout << "Sensor not initialized, initializing now..." << std::endl;
         if (!initialize()) {
             std::cerr << "Cannot read pH: Sensor initialization failed" << std::endl;
-            return -1.0f;
-        }
-    }
-    
-    // Read raw ADC value 
-    int16_t adcValue = readADC();
-    if (adcValue < 0) {
-        std::cerr << "Failed to read ADC" << std::endl;
-        return -1.0f;
-    }
-    
-    // Convert to voltage
-    float voltage = adcToVoltage(adcValue);
-    
-    // Convert to pH
-    float pH = voltageToPH(voltage);
-    
-    // Notify callbacks
-    notifyCallbacks(pH, voltage, adcValue);
-    
-    // Print the same output 
-    std::cout << "Raw ADC: " << adcValue << " | Voltage: " << voltage
-              << "V | pH: " << pH << std::endl;
-    
-    return pH;
-}
-
-int16_t PHSensor::readADC() {
-    uint16_t config = (1 << 15) | // Start conversion
-                      (0 << 12) | // A0 single-ended (MUX = 000)
-                      (2 << 9)  | // ±2.048V gain (PGA = 010)
-                      (0 << 8)  | // Single-shot
-                      (4 << 5)  | // 128 SPS
-                      (0 << 4)  | // Comparator off
-                      (3);        // Disable comparator
-    
-    uint8_t config_bytes[3] = {
-        CONFIG_REG,
-        static_cast<uint8_t>((config >> 8) & 0xFF),
-        static_cast<uint8_t>(config & 0xFF)
-    };
-    
-    if (write(m_fd, config_bytes, 3) != 3) {
+            return false;
+        }
+    }
+
+    // Averaged raw ADC value, from the sampler or a single-shot read
+    float adcValue;
+    if (m_sampling) {
+        std::unique_lock<std::mutex> latest(m_latestMutex);
+        if (!m_latestCondition.wait_for(latest, std::chrono::milliseconds(AVERAGE_TIMEOUT_MS), [this]() {
+                return m_latestSequence != m_readSequence || !m_sampling;
+            }) || m_latestSequence == m_readSequence) {
+            std::cerr << "No pH conversion ready" << std::endl;
+            return false;
+        }
+        adcValue = m_latestAdc;
+        m_readSequence = m_latestSequence;
+    } else if (m_alarmMode) {
+        // Converting all the time for the comparator, wait for the next result
+        std::this_thread::sleep_for(std::chrono::microseconds(1100000 / m_config.alarmDataRate));
+        int16_t raw;
+        if (!readConversion(raw)) {
+            std::cerr << "Failed to read conversion" << std::endl;
+            m_i2cErrors++;
+            return false;
+        }
+        adcValue = raw;
+    } else {
+        int16_t raw;
+        if (!readADC(CONFIG_MUX_A0, raw)) {
+            std::cerr << "Failed to read ADC" << std::endl;
+            return false;
+        }
+        adcValue = raw;
+    }
+
+    // Convert to voltage, then pH
+    sample.voltage = adcToVoltage(adcValue);
+    sample.pH = voltageToPH(sample.voltage);
+    sample.adcValue = static_cast<int16_t>(std::lround(adcValue));
+    m_readings++;
+
+    if (!m_alarmMode) {
+        bool enabled;
+        bool outside;
+        {
+            std::lock_guard<std::mutex> latest(m_latestMutex);
+            enabled = m_alarmEnabled;
+            outside = sample.pH < m_alarmLow || sample.pH > m_alarmHigh;
+        }
+        if (enabled) {
+            setAlarmState(outside, sample.pH, false);
+        }
+    }
+    return true;
+}
+
+bool PHSensor::readChannel(int channel, float& voltage) {
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    if (!m_initialized || m_alarmMode || channel < 1 || channel > 3) {
+        return false;
+    }
+
+    // A single-shot conversion replaces the continuous one for a moment,
+    // the sampler drops the next result in case it was this one
+    m_skip = m_sampling ? 1 : 0;
+    int16_t raw;
+    bool ok = readADC(CONFIG_MUX_SINGLE | static_cast<uint16_t>(channel << 12), raw);
+    if (m_sampling && !writeRegister(CONFIG_REG, continuousConfig())) {
+        std::cerr << "Failed to resume continuous pH sampling" << std::endl;
+        m_i2cErrors++;
+    }
+    if (ok) {
+        voltage = adcToVoltage(raw);
+    }
+    return ok;
+}
+
+void PHSensor::scanChannels() {
+    for (size_t i = 0; i < m_config.channels.size(); ++i) {
+        float voltage = 0.0f;
+        bool ok = readChannel(m_config.channels[i].channel, voltage);
+        std::lock_guard<std::mutex> latest(m_latestMutex);
+        m_channels[i].valid = ok;
+        m_channels[i].voltage = ok ? voltage : 0.0f;
+    }
+}
+
+bool PHSensor::setAlarm(float low, float high) {
+    if (!(low < high)) {
+        std::cerr << "pH alarm band " << low << " to " << high << " is empty" << std::endl;
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> latest(m_latestMutex);
+        m_alarmEnabled = true;
+        m_alarmLow = low;
+        m_alarmHigh = high;
+    }
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    if (m_alarmMode && !writeThresholds()) {
+        std::cerr << "Failed to program the pH alarm thresholds" << std::endl;
+        m_i2cErrors++;
+        return false;
+    }
+    std::cout << "pH alarm band set to " << low << " - " << high << std::endl;
+    return true;
+}
+
+PHSensor::AlarmState PHSensor::alarm() const {
+    std::lock_guard<std::mutex> latest(m_latestMutex);
+    AlarmState state;
+    state.enabled = m_alarmEnabled;
+    state.hardware = m_alarmMode;
+    state.active = m_alarmActive;
+    state.low = m_alarmLow;
+    state.high = m_alarmHigh;
+    state.changes = m_alarmChanges;
+    state.lastChange = m_alarmChangedAt;
+    return state;
+}
+
+PHSensor::Stats PHSensor::stats() const {
+    Stats stats;
+    stats.continuous = m_sampling;
+    stats.conversions = m_conversions;
+    stats.missed = m_missed;
+    stats.i2cErrors = m_i2cErrors;
+    stats.readings = m_readings;
+    int64_t startNs;
+    {
+        std::lock_guard<std::mutex> latest(m_latestMutex);
+        startNs = m_samplerStartNs;
+    }
+    double elapsed = startNs ? (nowNs() - startNs) / 1e9 : 0.0;
+    stats.conversionsPerSecond = (stats.continuous && elapsed > 0) ? stats.conversions / elapsed : 0.0;
+    {
+        std::lock_guard<std::mutex> latest(m_latestMutex);
+        stats.channels = m_channels;
+    }
+    return stats;
+}
+
+bool PHSensor::startContinuous() {
+    gpio::LineSettings settings;
+    settings.fallingEdge = true; // ALERT/RDY is active low
+    settings.eventBufferSize = EVENT_BUFFER_SIZE;
+    m_request = gpio::requestLines(gpio::chipPath(m_config.chipNumber),
+                                   { static_cast<unsigned int>(m_config.readyPin) }, settings, "ph_sensor");
+    if (!m_request) {
+        std::cerr << "Failed to request ALERT/RDY line " << m_config.readyPin << std::endl;
+        return false;
+    }
+    m_eventBuffer = gpiod_edge_event_buffer_new(EVENT_BUFFER_SIZE);
+
+    if (!m_eventBuffer ||
+        !writeRegister(LO_THRESH_REG, READY_LO_THRESH) ||
+        !writeRegister(HI_THRESH_REG, READY_HI_THRESH) ||
+        !writeRegister(CONFIG_REG, continuousConfig())) {
+        std::cerr << "Failed to configure ADS1115 continuous mode" << std::endl;
+        stopContinuous();
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> latest(m_latestMutex);
+        m_readSequence = m_latestSequence;
+        m_samplerStartNs = nowNs();
+    }
+    m_conversions = 0;
+    m_missed = 0;
+    m_sampling = true;
+    m_sampler = std::thread(&PHSensor::sampler, this);
+    std::cout << "pH sensor sampling continuously at " << m_config.dataRate << " SPS, averaging "
+              << m_config.oversample << " conversions" << std::endl;
+    return true;
+}
+
+bool PHSensor::startAlarm() {
+    if (!m_alarmEnabled) {
+        std::cerr << "pH alarm disabled, nothing to watch" << std::endl;
+        return false;
+    }
+    gpio::LineSettings settings;
+    settings.bothEdges = true; // Falling when pH leaves the band, rising when it's back
+    settings.eventBufferSize = EVENT_BUFFER_SIZE;
+    m_request = gpio::requestLines(gpio::chipPath(m_config.chipNumber),
+                                   { static_cast<unsigned int>(m_config.readyPin) }, settings, "ph_alarm");
+    if (!m_request) {
+        std::cerr << "Failed to request ALERT/RDY line " << m_config.readyPin << std::endl;
+        return false;
+    }
+    m_eventBuffer = gpiod_edge_event_buffer_new(EVENT_BUFFER_SIZE);
+
+    if (!m_eventBuffer || !writeThresholds() || !writeRegister(CONFIG_REG, alarmConfig())) {
+        std::cerr << "Failed to configure the ADS1115 window comparator" << std::endl;
+        stopContinuous();
+        return false;
+    }
+
+    m_alarmMode = true;
+    m_sampler = std::thread(&PHSensor::alarmWatcher, this);
+    std::cout << "pH alarm watching " << m_alarmLow << " - " << m_alarmHigh << " on ALERT/RDY" << std::endl;
+    return true;
+}
+
+void PHSensor::stopContinuous() {
+    if (m_sampler.joinable()) {
+        m_sampling = false;
+        m_alarmMode = false;
+        m_wakeup.signal();
+        m_sampler.join();
+        m_wakeup.clear();
+    }
+    m_sampling = false;
+    m_alarmMode = false;
+    m_latestCondition.notify_all();
+
+    if (m_request) {
+        // Back to single-shot, which also stops the ready pulses
+        writeRegister(CONFIG_REG, CONFIG_MUX_A0 | CONFIG_PGA_2V048 | CONFIG_MODE_SINGLE |
+                                  dataRateBits(m_config.dataRate) | CONFIG_COMP_DISABLE);
+        gpiod_line_request_release(m_request);
+        m_request = nullptr;
+    }
+    if (m_eventBuffer) {
+        gpiod_edge_event_buffer_free(m_eventBuffer);
+        m_eventBuffer = nullptr;
+    }
+}
+
+void PHSensor::sampler() {
+    realtime::applyThreadPolicy(realtime::ThreadRole::Main);
+    int64_t sum = 0;
+    int count = 0;
+    while (m_sampling) {
+        int r = gpio::waitEdgeEvents(m_request, m_wakeup, READY_TIMEOUT_NS);
+        if (r < 0) {
+            std::cerr << "Error waiting for ALERT/RDY, pH sampling stopped" << std::endl;
+            break;
+        }
+        if (r == 0) {
+            if (m_sampling) {
+                std::cerr << "No ALERT/RDY edges on pin " << m_config.readyPin
+                          << ", falling back to single-shot pH reads" << std::endl;
+            }
+            break;
+        }
+
+        int edges = gpiod_line_request_read_edge_events(m_request, m_eventBuffer, EVENT_BUFFER_SIZE);
+        if (edges <= 0) {
+            continue;
+        }
+        if (edges > 1) {
+            m_missed += edges - 1; // Overwritten before we got to them
+        }
+
+        int16_t value;
+        if (!readConversion(value)) {
+            m_i2cErrors++;
+            continue;
+        }
+        if (m_skip.exchange(0)) {
+            continue; // May be another channel's result
+        }
+        m_conversions++;
+        sum += value;
+        if (++count >= m_config.oversample) {
+            {
+                std::lock_guard<std::mutex> latest(m_latestMutex);
+                m_latestAdc = static_cast<float>(sum) / count;
+                m_latestSequence++;
+            }
+            m_latestCondition.notify_all();
+            sum = 0;
+            count = 0;
+        }
+    }
+    m_sampling = false;
+    m_latestCondition.notify_all();
+}
+
+void PHSensor::alarmWatcher() {
+    realtime::applyThreadPolicy(realtime::ThreadRole::Main);
+    while (m_alarmMode) {
+        // No timeout, the thread sleeps until the comparator or stop wakes it
+        int r = gpio::waitEdgeEvents(m_request, m_wakeup, -1);
+        if (r < 0) {
+            std::cerr << "Error waiting for ALERT/RDY, pH alarm stopped" << std::endl;
+            break;
+        }
+        if (r == 0) {
+            continue;
+        }
+
+        int edges = gpiod_line_request_read_edge_events(m_request, m_eventBuffer, EVENT_BUFFER_SIZE);
+        if (edges <= 0) {
+            continue;
+        }
+        // Only the latest level matters, ALERT/RDY is active low
+        gpiod_edge_event* last = gpiod_edge_event_buffer_get_event(m_eventBuffer, edges - 1);
+        bool active = gpiod_edge_event_get_event_type(last) == GPIOD_EDGE_EVENT_FALLING_EDGE;
+
+        float pH = std::nanf("");
+        int16_t raw;
+        if (readConversion(raw)) {
+            pH = voltageToPH(adcToVoltage(raw));
+        } else {
+            m_i2cErrors++;
+        }
+        setAlarmState(active, pH, true);
+    }
+    m_alarmMode = false;
+}
+
+bool PHSensor::writeThresholds() {
+    float low;
+    float high;
+    {
+        std::lock_guard<std::mutex> latest(m_latestMutex);
+        low = m_alarmLow;
+        high = m_alarmHigh;
+    }
+    // The slope is negative, the low pH limit is the high voltage one
+    int16_t a = pHToAdc(low);
+    int16_t b = pHToAdc(high);
+    return writeRegister(LO_THRESH_REG, static_cast<uint16_t>(std::min(a, b))) &&
+           writeRegister(HI_THRESH_REG, static_cast<uint16_t>(std::max(a, b)));
+}
+
+void PHSensor::setAlarmState(bool active, float pH, bool hardware) {
+    AlarmEvent event;
+    {
+        std::lock_guard<std::mutex> latest(m_latestMutex);
+        if (m_alarmActive == active) {
+            return;
+        }
+        m_alarmActive = active;
+        m_alarmChanges++;
+        m_alarmChangedAt = std::time(nullptr);
+        event = { static_cast<uint64_t>(nowNs()), active, pH, m_alarmLow, m_alarmHigh, hardware };
+    }
+    m_alarmTopic.publish(event);
+}
+
+int16_t PHSensor::pHToAdc(float pH) const {
+    // Inverse of voltageToPH() and adcToVoltage()
+    double voltage = (pH - OFFSET) / SLOPE;
+    double code = std::round(voltage * 32767.0 / V_REF);
+    return static_cast<int16_t>(std::max(-32768.0, std::min(32767.0, code)));
+}
+
+bool PHSensor::readADC(uint16_t mux, int16_t& value) {
+    uint16_t config = CONFIG_OS_START | mux | CONFIG_PGA_2V048 | CONFIG_MODE_SINGLE |
+                      dataRateBits(m_config.dataRate) | CONFIG_COMP_DISABLE;
+    if (!writeRegister(CONFIG_REG, config)) {
         std::cerr << "Failed to write config" << std::endl;
-        return -1;
-    }
-    
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    
-    // Read back config 
-    uint8_t reg = CONFIG_REG;
-    if (write(m_fd, &reg, 1) != 1) {
-        std::cerr << "Failed to set config register for read" << std::endl;
-        return -1;
-    }
-    
-    uint8_t config_read[2];
-    if (read(m_fd, config_read, 2) != 2) {
-        std::cerr << "Failed to read config" << std::endl;
-        return -1;
-    }
-    
-    uint16_t config_check = (config_read[0] << 8) | config_read[1];
-    std::cout << "Config Register: 0x" << std::hex << config_check << std::dec << std::endl;
-    
-    // Read conversion register
-    reg = CONVERSION_REG;
-    if (write(m_fd, &reg, 1) != 1) {
-        std::cerr << "Failed to set conversion register" << std::endl;
-        return -1;
-    }
-    
-    uint8_t data[2];
-    if (read(m_fd, data, 2) != 2) {
+        m_i2cErrors++;
+        return false;
+    }
+
+    // One conversion period at the configured rate, plus the oscillator's 10% tolerance
+    std::this_thread::sleep_for(std::chrono::microseconds(1100000 / m_config.dataRate + 100));
+
+    if (!readConversion(value)) {
         std::cerr << "Failed to read conversion" << std::endl;
-        return -1;
+        m_i2cErrors++;
+        return false;
     }
-    
-    // Combine 16-bit result (big-endian)
-    return (data[0] << 8) | data[1];
+    return true;
+}
+
+bool PHSensor::writeRegister(uint8_t reg, uint16_t value) {
+    return m_i2c.writeRegister(I2C_ADDR, reg, value);
+}
+
+bool PHSensor::readConversion(int16_t& value) {
+    // Pointer write and read in one transaction, no other caller can move the pointer between
+    uint16_t raw;
+    if (!m_i2c.readRegister(I2C_ADDR, CONVERSION_REG, raw)) {
+        return false;
+    }
+    value = static_cast<int16_t>(raw);
+    return true;
 }
 
-float PHSensor::adcToVoltage(int16_t adcValue) {
+uint16_t PHSensor::continuousConfig() const {
+    return CONFIG_MUX_A0 | CONFIG_PGA_2V048 | dataRateBits(m_config.dataRate) | CONFIG_COMP_ONE_CONVERSION;
+}
+
+uint16_t PHSensor::alarmConfig() const {
+    // COMP_QUE 00, 01 and 10 assert after one, two and four conversions out of band
+    uint16_t queue = m_config.alarmConversions >= 4 ? 2 : static_cast<uint16_t>(m_config.alarmConversions - 1);
+    return CONFIG_MUX_A0 | CONFIG_PGA_2V048 | dataRateBits(m_config.alarmDataRate) | CONFIG_COMP_WINDOW | queue;
+}
+
+uint16_t PHSensor::dataRateBits(int rate) const {
+    auto match = std::find(std::begin(DATA_RATES), std::end(DATA_RATES), rate);
+    uint16_t index = match != std::end(DATA_RATES) ? static_cast<uint16_t>(match - std::begin(DATA_RATES)) : 7;
+    return index << 5;
+}
+
+float PHSensor::adcToVoltage(float adcValue) {
     // Using the updated calculation with 2.048V reference
     return (adcValue * V_REF) / 32767.0; // 0-32767 maps to 0-2.048V
 }
@@ -158,9 +587,3 @@ float PHSensor::adcToVoltage(int16_t adcValue) {
 float PHSensor::voltageToPH(float voltage) {
     return SLOPE * voltage + OFFSET;
 }
-
-void PHSensor::notifyCallbacks(float pH, float voltage, int16_t adcValue) {
-    for (auto& callback : m_callbackInterfaces) {
-        callback->onPHSample(pH, voltage, adcValue);
-    }
-}
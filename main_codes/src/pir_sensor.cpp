@@ -1,96 +1,225 @@
 #include "pir_sensor.h"
+#include <jsoncpp/json/json.h>
+#include <algorithm>
+#include <fstream>
 #include <iostream>
 #include <stdexcept>
+#include <sys/epoll.h>
+#include <string>
 
-PirSensor::PirSensor(int chipNumber, int pinNumber) 
-    : m_chipNumber(chipNumber), 
-      m_pinNumber(pinNumber), 
-      m_running(false) {
-    
-    // Initialize GPIO
-    m_chip = gpiod_chip_open_by_number(m_chipNumber);
-    if (!m_chip) {
-        throw std::runtime_error("Failed to open GPIO chip");
+bool PirSensorConfig::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Cannot open PIR config " << path << std::endl;
+        return false;
     }
+
+    Json::Value root;
+    Json::CharReaderBuilder builder;
+    JSONCPP_STRING err;
+    if (!Json::parseFromStream(builder, file, &root, &err)) {
+        std::cerr << "Error parsing PIR config: " << err << std::endl;
+        return false;
+    }
+
+    chipNumber = root.get("chip", chipNumber).asInt();
+    pinNumber = root.get("pin", pinNumber).asInt();
+    debounceMs = std::max(0, root.get("debounce_ms", debounceMs).asInt());
+    holdOffMs = std::max(0, root.get("hold_off_ms", holdOffMs).asInt());
+    kernelDebounce = root.get("kernel_debounce", kernelDebounce).asBool();
+    return true;
+}
+
+PirSensor::PirSensor(EventLoop& loop, EventBus& bus, const PirSensorConfig& config) 
+    : m_loop(loop),
+      m_config(config), 
+      m_running(false),
+      m_motionTopic(bus.topic<MotionEvent>("motion")),
+      m_request(nullptr),
+      m_eventBuffer(nullptr),
+      m_debounceTimer(-1),
+      m_stopped(false),
+      m_pendingRise(false),
+      m_pendingEvent(),
+      m_lastMotionNs(-1),
+      m_stats() {
     
-    m_line = gpiod_chip_get_line(m_chip, m_pinNumber);
-    if (!m_line) {
-        gpiod_chip_close(m_chip);
-        throw std::runtime_error("Failed to get GPIO line");
+    // Initialize GPIO
+    requestLine();
+
+    // Many edges can be drained with one read
+    m_eventBuffer = gpiod_edge_event_buffer_new(EVENT_BUFFER_SIZE);
+    if (!m_eventBuffer) {
+        gpiod_line_request_release(m_request);
+        throw std::runtime_error("Failed to allocate GPIO event buffer");
     }
 
-    // Configure line for both edges (rising/falling detection)
-    if (gpiod_line_request_both_edges_events(m_line, "pir_sensor") != 0) {
-        gpiod_chip_close(m_chip);
-        throw std::runtime_error("Failed to request line events");
+    // Userspace debounce waits for the line to stay high, without blocking the loop
+    if (!m_stats.kernelDebounce && m_config.debounceMs > 0) {
+        m_debounceTimer = m_loop.addTimer([this]() { pendingTimeout(); });
     }
 }
 
 PirSensor::~PirSensor() {
     stop();
-    if (m_line) {
-        gpiod_line_release(m_line);
+    m_loop.removeTimer(m_debounceTimer);
+    if (m_eventBuffer) {
+        gpiod_edge_event_buffer_free(m_eventBuffer);
+    }
+    if (m_request) {
+        gpiod_line_request_release(m_request);
     }
-    if (m_chip) {
-        gpiod_chip_close(m_chip);
+}
+
+void PirSensor::requestLine() {
+    // Configure line for both edges (rising/falling detection)
+    gpio::LineSettings settings;
+    settings.bothEdges = true;
+    settings.eventBufferSize = EVENT_BUFFER_SIZE;
+    std::string chip = gpio::chipPath(m_config.chipNumber);
+    std::vector<unsigned int> offsets = { static_cast<unsigned int>(m_config.pinNumber) };
+
+    // Best first: kernel debounce with hardware timestamps, then each dropped in turn
+    struct Attempt {
+        bool debounce;
+        gpiod_line_clock clock;
+    };
+    const Attempt attempts[] = {
+        { true, GPIOD_LINE_CLOCK_HTE },
+        { true, GPIOD_LINE_CLOCK_MONOTONIC },
+        { false, GPIOD_LINE_CLOCK_MONOTONIC },
+    };
+    for (const auto& attempt : attempts) {
+        if (attempt.debounce && (m_config.debounceMs <= 0 || !m_config.kernelDebounce)) {
+            continue;
+        }
+        settings.debounceUs = attempt.debounce ? m_config.debounceMs * 1000UL : 0;
+        settings.eventClock = attempt.clock;
+        m_request = gpio::requestLines(chip, offsets, settings, "pir_sensor");
+        if (m_request) {
+            m_stats.kernelDebounce = attempt.debounce;
+            m_stats.hardwareTimestamps = attempt.clock == GPIOD_LINE_CLOCK_HTE;
+            std::cout << "PIR sensor on GPIO pin " << m_config.pinNumber
+                      << (attempt.debounce ? ", kernel debounce" : ", userspace debounce")
+                      << (m_stats.hardwareTimestamps ? ", hardware timestamps" : "") << std::endl;
+            return;
+        }
     }
+    throw std::runtime_error("Failed to request line events");
 }
 
 void PirSensor::start() {
-    m_running = true;
-    m_thread = std::thread(&PirSensor::worker, this);
+    if (m_running.exchange(true)) {
+        return;
+    }
+    // The line stays requested while stopped, what it queued meanwhile is stale
+    while (gpiod_line_request_wait_edge_events(m_request, 0) > 0 &&
+           gpiod_line_request_read_edge_events(m_request, m_eventBuffer, EVENT_BUFFER_SIZE) > 0) {
+    }
+    m_loop.add(gpiod_line_request_get_fd(m_request), EPOLLIN, [this](uint32_t) { readEvents(); });
+    std::cout << "PIR sensor watching for motion events..." << std::endl;
 }
 
 void PirSensor::stop() {
-    m_running = false;
-    if (m_thread.joinable()) {
-        m_thread.join();
+    if (!m_running.exchange(false)) {
+        return;
+    }
+    m_stopped = true;
+    m_loop.remove(gpiod_line_request_get_fd(m_request));
+    if (m_debounceTimer >= 0) {
+        m_loop.armTimer(m_debounceTimer, 0);
     }
+    std::cout << "PIR sensor stopped." << std::endl;
 }
 
-void PirSensor::registerCallback(MotionCallbackInterface* callback) {
-    m_callbacks.push_back(callback);
+PirSensor::Stats PirSensor::stats() const {
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    return m_stats;
 }
 
-void PirSensor::worker() {
-    try {
-        std::cout << "PIR sensor thread started. Waiting for motion events..." << std::endl;
-
-        while (m_running) {
-            // Wait for motion event with timeout
-            const timespec ts = { 5, 0 }; // 5 second timeout
-            int r = gpiod_line_event_wait(m_line, &ts);
-
-            if (r == -1) {
-                throw std::runtime_error("Error while waiting for GPIO event");
-            }
-
-            // Check if it really has been an event
-            if (r == 1) {
-                gpiod_line_event event;
-                if (gpiod_line_event_read(m_line, &event) == -1) {
-                    throw std::runtime_error("Failed to read GPIO event");
-                }
-
-                // Call our event handler
-                gpioEvent(event);
-            }
+void PirSensor::readEvents() {
+    dropStaleState();
+    // Drain every queued event in one read
+    int count = gpiod_line_request_read_edge_events(m_request, m_eventBuffer, EVENT_BUFFER_SIZE);
+    if (count < 0) {
+        std::cerr << "Failed to read GPIO events" << std::endl;
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        m_stats.reads++;
+    }
+    for (int i = 0; i < count; ++i) {
+        // Call our event handler
+        gpioEvent(gpiod_edge_event_buffer_get_event(m_eventBuffer, i));
+    }
+}
+
+void PirSensor::pendingTimeout() {
+    dropStaleState();
+    // No falling edge within the debounce period, the rise is real
+    if (m_pendingRise) {
+        m_pendingRise = false;
+        stableRise(m_pendingEvent);
+    }
+}
+
+void PirSensor::dropStaleState() {
+    if (!m_stopped.exchange(false)) {
+        return;
+    }
+    // A rise from before the stop would be proved stable, or debounced, by
+    // edges long after it
+    m_pendingRise = false;
+    m_pendingEvent = MotionEvent();
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_lastMotionNs = -1;
+}
+
+void PirSensor::gpioEvent(gpiod_edge_event* edge) {
+    bool rising = gpiod_edge_event_get_event_type(edge) == GPIOD_EDGE_EVENT_RISING_EDGE;
+    MotionEvent event = { gpiod_edge_event_get_timestamp_ns(edge), gpiod_edge_event_get_line_offset(edge),
+                          gpiod_edge_event_get_global_seqno(edge) };
+    {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        m_stats.edges++;
+        if (rising) {
+            m_stats.risingEdges++;
+        } else if (m_pendingRise &&
+                   event.timestampNs - m_pendingEvent.timestampNs < m_config.debounceMs * 1000000ULL) {
+            // Pulse shorter than the debounce period
+            m_stats.glitches++;
+            m_pendingRise = false;
         }
+    }
 
-        std::cout << "PIR sensor thread stopped." << std::endl;
-    } catch (const std::exception& e) {
-        std::cerr << "Exception in PIR sensor worker thread: " << e.what() << std::endl;
-        m_running = false;
+    // A falling edge read in the same batch can already prove a pending rise stable
+    if (!rising) {
+        pendingTimeout();
+        return;
+    }
+    if (m_debounceTimer < 0) {
+        stableRise(event);
+    } else if (!m_pendingRise) {
+        m_pendingRise = true;
+        m_pendingEvent = event;
+        m_loop.armTimer(m_debounceTimer, m_config.debounceMs * 1000000LL);
     }
 }
 
-void PirSensor::gpioEvent(gpiod_line_event& event) {
-    // Only process rising edge (motion detected)
-    if (event.event_type == GPIOD_LINE_EVENT_RISING_EDGE) {
-        std::cout << "Motion detected!" << std::endl;
-        // Notify all registered callbacks
-        for (auto& callback : m_callbacks) {
-            callback->motionDetected(event);
+void PirSensor::stableRise(const MotionEvent& event) {
+    int64_t now = static_cast<int64_t>(event.timestampNs);
+    {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        // Part of the current burst, the camera is already on it
+        if (m_lastMotionNs >= 0 && now - m_lastMotionNs < m_config.holdOffMs * 1000000LL) {
+            m_stats.coalesced++;
+            return;
         }
+        m_lastMotionNs = now;
+        m_stats.motions++;
     }
+
+    std::cout << "Motion detected!" << std::endl;
+    m_motionTopic.publish(event);
 }
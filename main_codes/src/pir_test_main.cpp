@@ -0,0 +1,205 @@
+#include "event_bus.h"
+#include "event_loop.h"
+#include "pir_sensor.h"
+#include "worker_pool.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * PIR sensor test
+ *
+ * Drives the real PirSensor from a gpio-sim line: a simulated chip is set
+ * up through configfs and its line pulled up and down through sysfs, so the
+ * edges go through the kernel like the sensor's would. Checks that a held
+ * rise is reported once, a short pulse is dropped as a glitch, and that after
+ * stop() and start() neither a rise pending at the stop nor edges queued
+ * while stopped make it into a motion event. Runs with kernel and userspace
+ * debounce. Needs root and the gpio-sim module; exits 77 if it can't set up
+ * the chip.
+ */
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const int DEBOUNCE_MS = 50;
+const int HOLD_OFF_MS = 100;
+const unsigned int LINE = 0;
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void sleepMs(int ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+bool writeFile(const fs::path& path, const std::string& value) {
+    std::ofstream file(path);
+    file << value;
+    file.close();
+    return static_cast<bool>(file);
+}
+
+std::string readFile(const fs::path& path) {
+    std::ifstream file(path);
+    std::string value;
+    std::getline(file, value);
+    return value;
+}
+
+// One gpio-sim chip with a single bank, removed again on destruction
+class SimChip {
+public:
+    SimChip()
+        : m_dir("/sys/kernel/config/gpio-sim/pir_test_" + std::to_string(getpid())),
+          m_live(false),
+          m_number(-1) {}
+
+    ~SimChip() {
+        if (m_live) {
+            writeFile(m_dir / "live", "0");
+        }
+        std::error_code ignored;
+        fs::remove(m_dir / "bank0", ignored);
+        fs::remove(m_dir, ignored);
+    }
+
+    bool setUp() {
+        std::error_code error;
+        if (!fs::create_directory(m_dir, error) || !fs::create_directory(m_dir / "bank0", error) ||
+            !writeFile(m_dir / "bank0" / "num_lines", "1") || !writeFile(m_dir / "live", "1")) {
+            return false;
+        }
+        m_live = true;
+        std::string chip = readFile(m_dir / "bank0" / "chip_name"); // e.g. gpiochip5
+        m_pull = fs::path("/sys/devices/platform") / readFile(m_dir / "dev_name") / chip /
+                 ("sim_gpio" + std::to_string(LINE)) / "pull";
+        m_number = chip.size() > 8 ? std::stoi(chip.substr(8)) : -1;
+        return m_number >= 0 && set(false);
+    }
+
+    bool set(bool high) { return writeFile(m_pull, high ? "pull-up" : "pull-down"); }
+    int number() const { return m_number; }
+
+private:
+    fs::path m_dir;
+    fs::path m_pull;
+    bool m_live;
+    int m_number;
+};
+
+struct Motions {
+    std::mutex mutex;
+    std::vector<uint64_t> timestamps;
+
+    size_t count() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return timestamps.size();
+    }
+    uint64_t last() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return timestamps.empty() ? 0 : timestamps.back();
+    }
+};
+
+bool check(const std::string& name, bool ok) {
+    std::cout << (ok ? "ok   " : "FAIL ") << name << std::endl;
+    return ok;
+}
+
+bool run(SimChip& chip, bool kernelDebounce) {
+    std::cout << (kernelDebounce ? "Kernel" : "Userspace") << " debounce" << std::endl;
+    EventLoop loop;
+    std::thread loopThread([&loop]() { loop.run(); });
+    WorkerPool pool(2);
+    EventBus bus(pool);
+
+    PirSensorConfig config;
+    config.chipNumber = chip.number();
+    config.pinNumber = LINE;
+    config.debounceMs = DEBOUNCE_MS;
+    config.holdOffMs = HOLD_OFF_MS;
+    config.kernelDebounce = kernelDebounce;
+
+    bool ok = true;
+    {
+        PirSensor sensor(loop, bus, config);
+        Motions motions;
+        Subscriptions subscriptions;
+        subscriptions.add(bus.topic<PirSensor::MotionEvent>("motion"), "test", Delivery::Inline,
+                          [&motions](const PirSensor::MotionEvent& event) {
+                              std::lock_guard<std::mutex> lock(motions.mutex);
+                              motions.timestamps.push_back(event.timestampNs);
+                          });
+        sensor.start();
+        const int settle = DEBOUNCE_MS + HOLD_OFF_MS;
+
+        // A rise held past the debounce is one motion
+        chip.set(true);
+        sleepMs(settle);
+        chip.set(false);
+        sleepMs(settle);
+        ok = check("held rise", motions.count() == 1) && ok;
+
+        // A pulse shorter than the debounce is a glitch
+        uint64_t glitches = sensor.stats().glitches;
+        chip.set(true);
+        sleepMs(DEBOUNCE_MS / 5);
+        chip.set(false);
+        sleepMs(settle);
+        // The kernel swallows it without counting, only the userspace debounce counts it
+        bool counted = kernelDebounce || sensor.stats().glitches > glitches;
+        ok = check("short pulse", motions.count() == 1 && counted) && ok;
+
+        // Stopped with a rise pending, the fall comes in while stopped
+        chip.set(true);
+        sleepMs(DEBOUNCE_MS / 5);
+        sensor.stop();
+        sleepMs(settle);
+        chip.set(false);
+        sleepMs(settle);
+        int64_t restartNs = nowNs();
+        sensor.start();
+        sleepMs(settle);
+        ok = check("nothing from before the stop", motions.count() == 1) && ok;
+
+        // The first rise after the restart is reported, stamped after it
+        chip.set(true);
+        sleepMs(settle);
+        chip.set(false);
+        sleepMs(settle);
+        ok = check("rise after restart", motions.count() == 2 &&
+                   motions.last() >= static_cast<uint64_t>(restartNs)) && ok;
+
+        subscriptions.clear();
+        sensor.stop();
+    }
+    pool.stop();
+    bus.stop();
+    loop.stop();
+    loopThread.join();
+    return ok;
+}
+
+} // namespace
+
+int main() {
+    SimChip chip;
+    if (!chip.setUp()) {
+        std::cerr << "Cannot set up a gpio-sim chip (needs root and the gpio-sim module), skipped" << std::endl;
+        return 77;
+    }
+    bool ok = run(chip, false);
+    ok = run(chip, true) && ok;
+    std::cout << (ok ? "PIR sensor behaved" : "PIR sensor misbehaved") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,205 @@
+#include "realtime.h"
+#include <cerrno>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <pthread.h>
+#include <sstream>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace realtime {
+
+namespace {
+
+Config g_config;
+int g_rtCore = -1;
+bool g_rtCoreIsolated = false;
+cpu_set_t g_rtCpus;
+cpu_set_t g_otherCpus;
+std::string g_memoryStatus = "not locked";
+
+std::mutex g_mutex;
+std::map<ThreadRole, std::string> g_applied;
+
+const char* roleName(ThreadRole role) {
+    switch (role) {
+        case ThreadRole::Main:      return "Main";
+        case ThreadRole::Pir:       return "PIR worker";
+        case ThreadRole::Motor:     return "Motor playback";
+        case ThreadRole::Camera:    return "Camera worker";
+        case ThreadRole::Detection: return "Detection";
+        case ThreadRole::Api:       return "API/FastCGI";
+    }
+    return "Unknown";
+}
+
+bool isRealtimeRole(ThreadRole role) {
+    return role == ThreadRole::Pir || role == ThreadRole::Motor;
+}
+
+int priorityFor(ThreadRole role) {
+    return role == ThreadRole::Pir ? g_config.pirPriority : g_config.motorPriority;
+}
+
+// First core listed in the kernel isolcpus set, -1 if none
+int firstIsolatedCore() {
+    std::ifstream file("/sys/devices/system/cpu/isolated");
+    int core = -1;
+    if (file >> core) {
+        return core;
+    }
+    return -1;
+}
+
+std::string cpusToString(const cpu_set_t& cpus) {
+    std::stringstream ss;
+    bool first = true;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &cpus)) {
+            ss << (first ? "" : ",") << cpu;
+            first = false;
+        }
+    }
+    return ss.str();
+}
+
+std::string describe(ThreadRole role) {
+    std::stringstream ss;
+    if (isRealtimeRole(role)) {
+        ss << "SCHED_FIFO " << priorityFor(role) << " on CPU " << cpusToString(g_rtCpus);
+    } else {
+        ss << "SCHED_OTHER on CPUs " << cpusToString(g_otherCpus);
+    }
+    return ss.str();
+}
+
+} // namespace
+
+bool configure(const Config& config) {
+    g_config = config;
+    if (!g_config.enabled) {
+        return true;
+    }
+
+    int cpuCount = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+    if (cpuCount < 2) {
+        std::cerr << "Real-time mode needs at least two cores, disabled" << std::endl;
+        g_config.enabled = false;
+        return false;
+    }
+
+    g_rtCore = config.rtCore;
+    if (g_rtCore < 0) {
+        g_rtCore = firstIsolatedCore();
+        g_rtCoreIsolated = g_rtCore >= 0;
+    }
+    if (g_rtCore < 0) {
+        g_rtCore = cpuCount - 1;
+    }
+    if (g_rtCore >= cpuCount) {
+        std::cerr << "Real-time core " << g_rtCore << " does not exist, disabled" << std::endl;
+        g_config.enabled = false;
+        return false;
+    }
+
+    CPU_ZERO(&g_rtCpus);
+    CPU_ZERO(&g_otherCpus);
+    for (int cpu = 0; cpu < cpuCount; ++cpu) {
+        CPU_SET(cpu, cpu == g_rtCore ? &g_rtCpus : &g_otherCpus);
+    }
+
+    if (g_config.lockMemory) {
+        // Page faults in the PIR or motor path would defeat the FIFO priority
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0) {
+            g_memoryStatus = "locked (mlockall)";
+        } else {
+            g_memoryStatus = std::string("mlockall failed: ") + strerror(errno);
+            std::cerr << "Real-time mode: " << g_memoryStatus << std::endl;
+        }
+    }
+    return true;
+}
+
+bool isEnabled() {
+    return g_config.enabled;
+}
+
+bool applyThreadPolicy(ThreadRole role) {
+    if (!g_config.enabled) {
+        return true;
+    }
+
+    const cpu_set_t& cpus = isRealtimeRole(role) ? g_rtCpus : g_otherCpus;
+    int affinityErr = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus);
+
+    sched_param param{};
+    int policy = SCHED_OTHER;
+    if (isRealtimeRole(role)) {
+        policy = SCHED_FIFO;
+        param.sched_priority = priorityFor(role);
+    }
+    int schedErr = pthread_setschedparam(pthread_self(), policy, &param);
+
+    std::string status = describe(role);
+    if (affinityErr != 0) {
+        status += std::string(" (affinity failed: ") + strerror(affinityErr) + ")";
+    }
+    if (schedErr != 0) {
+        status += std::string(" (scheduler failed: ") + strerror(schedErr) + ")";
+    }
+    if (affinityErr != 0 || schedErr != 0) {
+        std::cerr << "Real-time policy for " << roleName(role) << ": " << status << std::endl;
+    }
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_applied[role] = status;
+    return affinityErr == 0 && schedErr == 0;
+}
+
+std::string report() {
+    std::stringstream ss;
+    if (!g_config.enabled) {
+        ss << "Real-time mode: disabled (all threads SCHED_OTHER)";
+        return ss.str();
+    }
+
+    ss << "Real-time mode: enabled" << std::endl;
+    ss << "  RT core: " << g_rtCore << (g_rtCoreIsolated ? " (isolated)" : " (not isolated)")
+       << ", other cores: " << cpusToString(g_otherCpus) << std::endl;
+    ss << "  Memory: " << g_memoryStatus;
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    for (ThreadRole role : {ThreadRole::Main, ThreadRole::Pir, ThreadRole::Motor,
+                            ThreadRole::Camera, ThreadRole::Detection, ThreadRole::Api}) {
+        auto it = g_applied.find(role);
+        ss << std::endl << "  " << roleName(role) << ": ";
+        if (it != g_applied.end()) {
+            ss << it->second;
+        } else {
+            ss << describe(role) << " (applied when the thread starts)";
+        }
+    }
+    return ss.str();
+}
+
+ScopedThreadPolicy::ScopedThreadPolicy(ThreadRole role) : m_active(false), m_policy(SCHED_OTHER), m_param{} {
+    if (!g_config.enabled) {
+        return;
+    }
+    pthread_getschedparam(pthread_self(), &m_policy, &m_param);
+    pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &m_cpus);
+    m_active = true;
+    applyThreadPolicy(role);
+}
+
+ScopedThreadPolicy::~ScopedThreadPolicy() {
+    if (m_active) {
+        pthread_setschedparam(pthread_self(), m_policy, &m_param);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &m_cpus);
+    }
+}
+
+} // namespace realtime
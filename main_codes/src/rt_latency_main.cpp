@@ -0,0 +1,168 @@
+#include "realtime.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * Real-time latency test
+ *
+ * Measures the wakeup latency of a periodic absolute-deadline loop (the way
+ * Motor::play waits for edges) while busy threads load every core. Runs once
+ * with default CFS scheduling, then with the real-time policy the fish monitor
+ * uses: measuring thread SCHED_FIFO on the RT core, load confined elsewhere.
+ */
+
+namespace {
+
+const int64_t NS_PER_SEC = 1000000000;
+
+struct Options {
+    int loops = 10000;
+    int intervalUs = 1000;
+    int loadThreads = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+    int rtCore = -1;
+};
+
+struct Stats {
+    double minUs;
+    double avgUs;
+    double p50Us;
+    double p99Us;
+    double maxUs;
+};
+
+int64_t nowNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * NS_PER_SEC + ts.tv_nsec;
+}
+
+// Synthetic detection-like load: arithmetic plus memory traffic
+void loadWorker(std::atomic<bool>& running, bool confine) {
+    if (confine) {
+        realtime::applyThreadPolicy(realtime::ThreadRole::Detection);
+    }
+    std::vector<unsigned> buffer(1 << 20);
+    unsigned x = 1;
+    while (running) {
+        for (size_t i = 0; i < buffer.size(); i += 16) {
+            x = x * 1664525u + 1013904223u;
+            buffer[i] += x;
+        }
+    }
+}
+
+Stats measure(const Options& options, bool rt) {
+    std::vector<int64_t> latencies;
+    latencies.reserve(options.loops);
+
+    std::thread measurer([&]() {
+        if (rt) {
+            realtime::applyThreadPolicy(realtime::ThreadRole::Motor);
+        }
+        int64_t next = nowNs() + options.intervalUs * 1000LL;
+        for (int i = 0; i < options.loops; ++i) {
+            timespec deadline = { static_cast<time_t>(next / NS_PER_SEC),
+                                  static_cast<long>(next % NS_PER_SEC) };
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr);
+            latencies.push_back(nowNs() - next);
+            next += options.intervalUs * 1000LL;
+        }
+    });
+    measurer.join();
+
+    std::sort(latencies.begin(), latencies.end());
+    double sum = 0.0;
+    for (int64_t l : latencies) {
+        sum += l;
+    }
+    Stats stats;
+    stats.minUs = latencies.front() / 1000.0;
+    stats.avgUs = sum / latencies.size() / 1000.0;
+    stats.p50Us = latencies[latencies.size() / 2] / 1000.0;
+    stats.p99Us = latencies[latencies.size() * 99 / 100] / 1000.0;
+    stats.maxUs = latencies.back() / 1000.0;
+    return stats;
+}
+
+Stats runPhase(const Options& options, bool rt) {
+    std::atomic<bool> running{true};
+    std::vector<std::thread> load;
+    for (int i = 0; i < options.loadThreads; ++i) {
+        load.emplace_back(loadWorker, std::ref(running), rt);
+    }
+    // Let the load settle on the cores before measuring
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    Stats stats = measure(options, rt);
+    running = false;
+    for (auto& t : load) {
+        t.join();
+    }
+    return stats;
+}
+
+void printStats(const char* name, const Stats& s) {
+    std::cout << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(10) << s.minUs << std::setw(10) << s.avgUs << std::setw(10) << s.p50Us
+              << std::setw(10) << s.p99Us << std::setw(10) << s.maxUs << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--loops" && i + 1 < argc) {
+            options.loops = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--interval-us" && i + 1 < argc) {
+            options.intervalUs = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--load-threads" && i + 1 < argc) {
+            options.loadThreads = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--rt-core" && i + 1 < argc) {
+            options.rtCore = std::atoi(argv[++i]);
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--loops N] [--interval-us US] [--load-threads N] [--rt-core N]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "Real-time latency test: " << options.loops << " wakeups every "
+              << options.intervalUs << "us, " << options.loadThreads << " load threads" << std::endl;
+
+    Stats cfs = runPhase(options, false);
+
+    realtime::Config config;
+    config.enabled = true;
+    config.rtCore = options.rtCore;
+    if (!realtime::configure(config)) {
+        std::cerr << "Cannot enable real-time mode on this machine" << std::endl;
+        return 1;
+    }
+    Stats rt = runPhase(options, true);
+
+    std::cout << std::endl << realtime::report() << std::endl << std::endl;
+    std::cout << "Wakeup latency (us)" << std::endl;
+    std::cout << std::left << std::setw(10) << "mode" << std::right << std::setw(10) << "min"
+              << std::setw(10) << "avg" << std::setw(10) << "p50" << std::setw(10) << "p99"
+              << std::setw(10) << "max" << std::endl;
+    printStats("cfs", cfs);
+    printStats("realtime", rt);
+
+    if (rt.p99Us < cfs.p99Us && rt.maxUs < cfs.maxUs) {
+        std::cout << "PASS: real-time mode lowers p99 and worst-case latency" << std::endl;
+        return 0;
+    }
+    std::cout << "FAIL: no improvement (missing CAP_SYS_NICE, or the RT core is busy?)" << std::endl;
+    return 2;
+}
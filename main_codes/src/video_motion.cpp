@@ -0,0 +1,208 @@
+#include "video_motion.h"
+#include "realtime.h"
+#include <jsoncpp/json/json.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+static const int64_t NS_PER_MS = 1000000LL;
+
+// Wait before reopening a preview stream that failed
+static const int RETRY_MS = 1000;
+
+// Frames dropped after the preview opens, while exposure and white balance settle
+static const int WARMUP_FRAMES = 4;
+
+// Weight of each still frame in the noise estimate
+static const double NOISE_RATE = 0.05;
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool VideoMotionConfig::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Cannot open video motion config " << path << std::endl;
+        return false;
+    }
+
+    Json::Value root;
+    Json::CharReaderBuilder builder;
+    JSONCPP_STRING err;
+    if (!Json::parseFromStream(builder, file, &root, &err)) {
+        std::cerr << "Error parsing video motion config: " << err << std::endl;
+        return false;
+    }
+
+    width = std::max(16, root.get("width", width).asInt());
+    height = std::max(16, root.get("height", height).asInt());
+    fps = std::max(1, root.get("fps", fps).asInt());
+    backgroundRate = std::clamp(root.get("background_rate", backgroundRate).asDouble(), 0.001, 1.0);
+    noiseFactor = std::max(1.0, root.get("noise_factor", noiseFactor).asDouble());
+    minThreshold = std::max(1, root.get("min_threshold", minThreshold).asInt());
+    minAreaPercent = std::max(0.0, root.get("min_area_percent", minAreaPercent).asDouble());
+    holdOffMs = std::max(0, root.get("hold_off_ms", holdOffMs).asInt());
+    return true;
+}
+
+VideoMotionDetector::VideoMotionDetector(Camera& camera, EventBus& bus, const VideoMotionConfig& config)
+    : m_camera(camera),
+      m_config(config),
+      m_motionTopic(bus.topic<MotionEvent>("video_motion")),
+      m_running(false),
+      m_lastMotionNs(0),
+      m_stats(),
+      m_busyNs(0),
+      m_runNs(0) {
+    m_stats.noise = -1.0; // Not measured yet
+}
+
+VideoMotionDetector::~VideoMotionDetector() {
+    stop();
+}
+
+void VideoMotionDetector::start() {
+    std::lock_guard<std::mutex> lock(m_startMutex);
+    if (m_running) {
+        return;
+    }
+    m_camera.setPreview(m_config.width, m_config.height, m_config.fps);
+    m_background.release(); // The scene may have changed while stopped
+    m_running = true;
+    m_thread = std::thread(&VideoMotionDetector::run, this);
+    std::cout << "Video motion detector started (" << m_config.width << "x" << m_config.height
+              << " at " << m_config.fps << " fps)" << std::endl;
+}
+
+void VideoMotionDetector::stop() {
+    std::lock_guard<std::mutex> lock(m_startMutex);
+    if (!m_running) {
+        return;
+    }
+    m_running = false;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    m_camera.closePreview();
+    std::cout << "Video motion detector stopped" << std::endl;
+}
+
+VideoMotionDetector::Stats VideoMotionDetector::stats() const {
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    Stats stats = m_stats;
+    stats.running = m_running;
+    stats.avgFrameMs = stats.frames ? m_busyNs / 1e6 / stats.frames : 0.0;
+    stats.cpuPercent = m_runNs > 0 ? 100.0 * m_busyNs / m_runNs : 0.0;
+    return stats;
+}
+
+void VideoMotionDetector::run() {
+    realtime::applyThreadPolicy(realtime::ThreadRole::Camera);
+    int64_t last = nowNs();
+    cv::Mat frame;
+    int warmup = 0;
+    while (m_running) {
+        // Blocks for the next frame, or while a still capture holds the camera
+        bool opened = false;
+        if (!m_camera.readPreview(frame, opened)) {
+            {
+                std::lock_guard<std::mutex> lock(m_statsMutex);
+                m_stats.readFailures++;
+            }
+            for (int waited = 0; waited < RETRY_MS && m_running; waited += 100) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+            last = nowNs();
+            continue;
+        }
+        if (opened) {
+            // A still capture closed the stream, the scene and exposure may
+            // have moved on since, so learn the background afresh
+            m_background.release();
+            warmup = WARMUP_FRAMES;
+        }
+        if (warmup > 0) {
+            warmup--;
+            last = nowNs();
+            continue;
+        }
+
+        int64_t start = nowNs();
+        double changedPercent = 0.0;
+        bool motion = process(frame, changedPercent);
+        int64_t end = nowNs();
+
+        bool report = motion && (m_lastMotionNs == 0 || end - m_lastMotionNs >= m_config.holdOffMs * NS_PER_MS);
+        {
+            std::lock_guard<std::mutex> lock(m_statsMutex);
+            m_stats.frames++;
+            m_busyNs += end - start;
+            m_runNs += end - last;
+            if (report) {
+                m_stats.motions++;
+            } else if (motion) {
+                m_stats.coalesced++;
+            }
+        }
+        last = end;
+
+        if (report) {
+            m_lastMotionNs = end;
+            std::cout << "Video motion: " << changedPercent << "% of the frame changed" << std::endl;
+            m_motionTopic.publish({ static_cast<uint64_t>(end), changedPercent });
+        }
+    }
+}
+
+bool VideoMotionDetector::process(const cv::Mat& frame, double& changedPercent) {
+    cv::Mat grey = frame;
+    if (grey.channels() == 3) {
+        cv::cvtColor(frame, grey, cv::COLOR_BGR2GRAY);
+    }
+    if (grey.size().width != m_config.width || grey.size().height != m_config.height) {
+        cv::resize(grey, grey, cv::Size(m_config.width, m_config.height), 0, 0, cv::INTER_AREA);
+    }
+    cv::GaussianBlur(grey, grey, cv::Size(5, 5), 0);
+
+    if (m_background.empty()) {
+        grey.convertTo(m_background, CV_32F);
+        return false;
+    }
+
+    cv::Mat background;
+    cv::Mat diff;
+    m_background.convertTo(background, CV_8U);
+    cv::absdiff(grey, background, diff);
+    double meanDiff = cv::mean(diff)[0];
+
+    double noise;
+    {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        if (m_stats.noise < 0) {
+            m_stats.noise = meanDiff;
+        }
+        noise = m_stats.noise;
+    }
+    double threshold = std::max<double>(m_config.minThreshold, m_config.noiseFactor * noise);
+
+    cv::Mat mask;
+    cv::threshold(diff, mask, threshold, 255, cv::THRESH_BINARY);
+    size_t total = mask.total();
+    changedPercent = total ? 100.0 * cv::countNonZero(mask) / total : 0.0;
+    bool motion = changedPercent >= m_config.minAreaPercent;
+
+    // Learn the noise from still frames only, and absorb a fish that stays
+    // put more slowly than a change in light
+    {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        if (!motion) {
+            m_stats.noise += NOISE_RATE * (meanDiff - m_stats.noise);
+        }
+        m_stats.threshold = threshold;
+    }
+    cv::accumulateWeighted(grey, m_background, motion ? m_config.backgroundRate / 4 : m_config.backgroundRate);
+    return motion;
+}
@@ -0,0 +1,201 @@
+#include "worker_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <iostream>
+
+namespace {
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Set on worker threads, lets submit() find the caller's own deque
+thread_local const WorkerPool* t_pool = nullptr;
+thread_local size_t t_index = 0;
+thread_local WorkerPool::Lane t_lane = WorkerPool::Lane::Feeding;
+
+} // namespace
+
+WorkerPool::WorkerPool(size_t threads, realtime::ThreadRole role)
+    : m_role(role),
+      m_nextWorker(0),
+      m_startNs(nowNs()),
+      m_running(true),
+      m_sleeping(0),
+      m_pending(0) {
+    threads = std::max<size_t>(threads, 1);
+    for (size_t i = 0; i < threads; ++i) {
+        m_workers.push_back(std::make_unique<Worker>());
+    }
+    // Start after every deque exists, workers steal from all of them
+    for (size_t i = 0; i < threads; ++i) {
+        m_workers[i]->thread = std::thread(&WorkerPool::worker, this, i);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    stop();
+}
+
+size_t WorkerPool::defaultSize() {
+    size_t cores = std::thread::hardware_concurrency();
+    return std::max<size_t>(cores > 1 ? cores - 1 : 1, 2);
+}
+
+const char* WorkerPool::laneName(Lane lane) {
+    switch (lane) {
+    case Lane::Feeding:
+        return "feeding";
+    case Lane::Archiving:
+        return "archiving";
+    case Lane::Analytics:
+        return "analytics";
+    }
+    return "unknown";
+}
+
+bool WorkerPool::submit(std::function<void()> job, Lane lane) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running) {
+            return false;
+        }
+        m_pending++;
+    }
+
+    size_t owner = (t_pool == this) ? t_index : m_nextWorker++ % m_workers.size();
+    size_t l = static_cast<size_t>(lane);
+    m_lanes[l].submitted++;
+    m_lanes[l].queued++;
+    {
+        std::lock_guard<std::mutex> lock(m_workers[owner]->mutex);
+        m_workers[owner]->jobs[l].push_back({std::move(job), nowNs(), owner});
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_sleeping > 0) {
+        m_condition.notify_one();
+    }
+    return true;
+}
+
+void WorkerPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_condition.notify_all();
+    for (auto& worker : m_workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+}
+
+uint64_t WorkerPool::completed() const {
+    uint64_t total = 0;
+    for (const auto& lane : m_lanes) {
+        total += lane.completed;
+    }
+    return total;
+}
+
+std::vector<WorkerPool::LaneStats> WorkerPool::laneStats() const {
+    double capacityNs = static_cast<double>(nowNs() - m_startNs) * m_workers.size();
+    std::vector<LaneStats> stats;
+    for (size_t l = 0; l < LANES; ++l) {
+        const LaneCounters& counters = m_lanes[l];
+        LaneStats lane;
+        lane.lane = static_cast<Lane>(l);
+        lane.submitted = counters.submitted;
+        lane.completed = counters.completed;
+        lane.stolen = counters.stolen;
+        lane.queued = counters.queued;
+        lane.busySeconds = counters.busyNs / 1e9;
+        lane.utilisation = capacityNs > 0 ? counters.busyNs / capacityNs : 0.0;
+        lane.avgWaitMs = lane.completed ? counters.waitNs / 1e6 / lane.completed : 0.0;
+        stats.push_back(lane);
+    }
+    return stats;
+}
+
+int WorkerPool::currentWorker() const {
+    return t_pool == this ? static_cast<int>(t_index) : -1;
+}
+
+WorkerPool::Lane WorkerPool::currentLane() {
+    return t_lane;
+}
+
+bool WorkerPool::take(size_t index, Job& job, size_t& lane) {
+    const size_t count = m_workers.size();
+    for (lane = 0; lane < LANES; ++lane) {
+        // Own deque, newest first while it is still warm in cache
+        {
+            Worker& own = *m_workers[index];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.jobs[lane].empty()) {
+                job = std::move(own.jobs[lane].back());
+                own.jobs[lane].pop_back();
+                return true;
+            }
+        }
+        // Then the oldest job of the others
+        for (size_t i = 1; i < count; ++i) {
+            Worker& victim = *m_workers[(index + i) % count];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.jobs[lane].empty()) {
+                job = std::move(victim.jobs[lane].front());
+                victim.jobs[lane].pop_front();
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void WorkerPool::run(size_t index, Job& job, size_t lane) {
+    LaneCounters& counters = m_lanes[lane];
+    counters.queued--;
+    m_pending--;
+    if (job.owner != index) {
+        counters.stolen++;
+    }
+
+    int64_t start = nowNs();
+    counters.waitNs += start - job.queuedNs;
+    t_lane = static_cast<Lane>(lane);
+    try {
+        job.run();
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in worker pool job: " << e.what() << std::endl;
+    }
+    t_lane = Lane::Feeding;
+    counters.busyNs += nowNs() - start;
+    counters.completed++;
+}
+
+void WorkerPool::worker(size_t index) {
+    realtime::applyThreadPolicy(m_role);
+    t_pool = this;
+    t_index = index;
+    while (true) {
+        Job job;
+        size_t lane;
+        if (take(index, job, lane)) {
+            run(index, job, lane);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!m_running && m_pending == 0) {
+            break; // Stopped and drained
+        }
+        // A reserved job may not be pushed yet, pending stays non-zero until it runs
+        m_sleeping++;
+        m_condition.wait(lock, [this]() { return !m_running || m_pending > 0; });
+        m_sleeping--;
+    }
+}
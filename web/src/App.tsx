@@ -1,4 +1,4 @@
-import React, { useState, useEffect } from 'react';
+import React, { useState, useEffect, useRef } from 'react';
 import { Power, Droplets, Camera, Fish, WifiOff, AlertCircle, Wifi, Settings } from 'lucide-react';
 import { LineChart, Line, XAxis, YAxis, CartesianGrid, Tooltip, Legend, ResponsiveContainer } from 'recharts';
 
@@ -38,6 +38,8 @@ function App() {
     retryCount: 0
   });
   const [phHistory, setPhHistory] = useState<PhHistoryItem[]>([]);
+  // Last full status, stream deltas are merged into it
+  const statusRef = useRef<any>({});
 
   const MAX_RETRIES = 3;
   const RETRY_DELAY = 2000;
@@ -61,7 +63,7 @@ function App() {
       const data = await response.json();
       if (!data.success) throw new Error(data.message || 'Motor control failed');
       
-      await fetchSensorData();
+      // Queued, the feed's progress and outcome arrive as command events
       setConnectionStatus(prev => ({ ...prev, isConnected: true, retryCount: 0 }));
     } catch (error) {
       console.error('Error toggling motor:', error);
@@ -102,21 +104,41 @@ function App() {
     fetchSensorData();
   };
 
+  const applyStatus = (backendData: any, recordPh: boolean) => {
+    statusRef.current = backendData;
+    const newPhValue = backendData.current_ph || 7.0;
+    if (recordPh) {
+      const newEntry = {
+        time: new Date(),
+        value: newPhValue
+      };
+      setPhHistory(prev => [...prev.slice(-19), newEntry]); // Keep last 20 entries
+    }
+    
+    // setSensorData({
+    const newSensorData = {
+      ph: newPhValue,
+      fishDetected: backendData.fish_detected || false,
+      motorStatus: backendData.motor_initialized || false,
+      current_ph_voltage: backendData.current_ph_voltage,
+      feed_count: backendData.feed_count,
+      auto_feed_count: backendData.auto_feed_count,
+      last_feed_time: backendData.last_feed_time === "Never" ? undefined : backendData.last_feed_time,
+      auto_last_feed_time: backendData.auto_last_feed_time === "Never" ? undefined : backendData.auto_last_feed_time,
+      ph_sensor_initialized: backendData.ph_sensor_initialized
+    };
+
+
+    setSensorData(newSensorData);
+    // Sync isAutoMode with fishDetected (overrides manual toggle)
+    // setIsAutoMode(newSensorData.fishDetected);
+  };
+
   const fetchSensorData = async () => {
     try {
       setConnectionError(null);
   
-      // Update pH sensor
-      await fetch('/api', {
-        method: 'POST',
-        headers: {
-          'Content-Type': 'application/json'
-        },
-        body: JSON.stringify({ command: "read_ph" })
-      });
-  
-      await new Promise(resolve => setTimeout(resolve, 1000));
-  
+      // The backend samples pH on its own, the status always has the latest reading
       const response = await fetch('/api', {
         headers: {
           'Accept': 'application/json'
@@ -128,33 +150,7 @@ function App() {
       const data = await response.json();
       if (!data.success) throw new Error('Backend reported failure');
   
-      const backendData = data.data;
-      const newPhValue = backendData.current_ph || 7.0;
-      const newEntry = {
-        time: new Date(),
-        value: newPhValue
-      };
-      
-      setPhHistory(prev => [...prev.slice(-19), newEntry]); // Keep last 20 entries
-      
-      // setSensorData({
-      const newSensorData = {
-        ph: newPhValue,
-        fishDetected: backendData.fish_detected || false,
-        motorStatus: backendData.motor_initialized || false,
-        current_ph_voltage: backendData.current_ph_voltage,
-        feed_count: backendData.feed_count,
-        auto_feed_count: backendData.auto_feed_count,
-        last_feed_time: backendData.last_feed_time === "Never" ? undefined : backendData.last_feed_time,
-	auto_last_feed_time: backendData.auto_last_feed_time === "Never" ? undefined : backendData.auto_last_feed_time,
-        ph_sensor_initialized: backendData.ph_sensor_initialized
-      };
-  
-
-      setSensorData(newSensorData);
-      // Sync isAutoMode with fishDetected (overrides manual toggle)
-      // setIsAutoMode(newSensorData.fishDetected);
-
+      applyStatus(data.data, true);
 
       setConnectionStatus(prev => ({
         ...prev,
@@ -178,9 +174,51 @@ function App() {
   };
 
   useEffect(() => {
-    fetchSensorData();
-    const intervalId = setInterval(fetchSensorData, 5000);
-    return () => clearInterval(intervalId);
+    if (typeof EventSource === 'undefined') {
+      fetchSensorData();
+      const intervalId = setInterval(fetchSensorData, 5000);
+      return () => clearInterval(intervalId);
+    }
+
+    // Pushed as it happens: the full status on connect, then only what changed
+    const events = new EventSource('/api/events');
+    events.onopen = () => {
+      setConnectionError(null);
+      setConnectionStatus(prev => ({
+        ...prev,
+        isConnected: true,
+        retryCount: 0,
+        lastAttempt: new Date()
+      }));
+    };
+    events.onerror = () => {
+      // EventSource reconnects by itself
+      setConnectionError('Connection lost, reconnecting');
+      setConnectionStatus(prev => ({
+        ...prev,
+        isConnected: false,
+        lastAttempt: new Date()
+      }));
+    };
+    events.addEventListener('status', (event) => {
+      const data = JSON.parse((event as MessageEvent).data);
+      if (data.data) {
+        applyStatus(data.data, true);
+      } else if (data.changed) {
+        applyStatus({ ...statusRef.current, ...data.changed }, false);
+      }
+    });
+    events.addEventListener('command', (event) => {
+      const data = JSON.parse((event as MessageEvent).data);
+      if (data.state === 'failed') {
+        setConnectionError(`${data.command} failed: ${data.error}`);
+      }
+    });
+    events.addEventListener('ph', (event) => {
+      const data = JSON.parse((event as MessageEvent).data);
+      setPhHistory(prev => [...prev.slice(-19), { time: new Date(data.time * 1000), value: data.ph }]);
+    });
+    return () => events.close();
   }, []);
 
   // Format time for chart display